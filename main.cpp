@@ -17,6 +17,7 @@
 #include <chrono>   // for time measurement
 #include <cstdio>   // for printf
 #include <cinttypes>
+#include <cstring>  // for strcmp
 #include <iostream>
 
 // incldue stbmaster
@@ -25,11 +26,20 @@
 // include ray tracing
 #include "rt_app.h"
 
-int main()
+int main(int argc, char** argv)
 {
     using namespace std::chrono;
 
-    RT_Application app;
+    // the recursive backend is the default, "--wavefront" traces the rays bounce by bounce with ray queues
+    rt::RenderBackend backend = rt::RT_BACKEND_RECURSIVE;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--wavefront") == 0)         backend = rt::RT_BACKEND_WAVEFRONT;
+        else if(strcmp(argv[i], "--recursive") == 0)    backend = rt::RT_BACKEND_RECURSIVE;
+        else printf("Unknown argument: %s\n", argv[i]);
+    }
+
+    RT_Application app(backend);
 
     time_point<high_resolution_clock> t0_render = high_resolution_clock::now();     // time before rendering
     app.app_run();
@@ -37,10 +47,12 @@ int main()
     int64_t t_render = duration_cast<milliseconds>(t1_render - t0_render).count();  // get time duration of image rendering operation
     printf("Rendering time: %" PRId64 "ms\n", t_render);
 
-    if(app.fetch_pixels() != nullptr)
+    const uint8_t* pixels = app.fetch_pixels();     // tonemapped image
+    if(pixels != nullptr)
     {
         time_point<high_resolution_clock> t0_out = high_resolution_clock::now();    // time before writing
-        stbi_write_png("rt_output.png", RT_Application::SCR_WIDTH, RT_Application::SCR_HEIGHT, 3, app.fetch_pixels(), RT_Application::SCR_WIDTH * 3 * sizeof(uint8_t));   // print image
+        stbi_write_png("rt_output.png", RT_Application::SCR_WIDTH, RT_Application::SCR_HEIGHT, 3, pixels, RT_Application::SCR_WIDTH * 3 * sizeof(uint8_t));   // print image
+        rt::ImageWriter::write_pfm(app.fetch_framebuffer(), "rt_output.pfm");                                                       // print lossless hdr image
         time_point<high_resolution_clock> t1_out = high_resolution_clock::now();    // time after writing
         int64_t t_out = duration_cast<milliseconds>(t1_out - t0_out).count();       // get time duration of image writing operation
         printf("Writing time: %" PRId64 "\n", t_out);
@@ -13,74 +13,172 @@
 
 using namespace rt;
 
-ImageError TextureLoader::load_cube(Cubemap<uint8_t, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
+namespace
+{
+/**
+*   @brief Paths of a cubemap that are owned by an asynchronous load, the paths of the
+*   create info may be gone before the cubemap is loaded.
+*/
+struct cubemap_paths_t
+{
+    std::string paths[6];
+
+    explicit cubemap_paths_t(const CubemapCreateInfo& cci)
+    {
+        const char* const* const _paths = (const char* const*)&cci;
+        for (uint32_t i = 0; i < 6; i++)
+            this->paths[i] = (_paths[i] != nullptr) ? _paths[i] : "";
+    }
+
+    CubemapCreateInfo create_info(void) const noexcept
+    {
+        CubemapCreateInfo cci;
+        const char** _paths = (const char**)&cci;
+        for (uint32_t i = 0; i < 6; i++)
+            _paths[i] = this->paths[i].c_str();
+        return cci;
+    }
+};
+}
+
+template<typename T_texel>
+ImageError TextureLoader::load_cube(Cubemap<uint8_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
 {
     const char* const* const paths = (const char* const*)&cci;
 
-    uint8_t* data;
-    int w, h, c;
-    ImageCreateInfo image_ci = {};
-    ImageError error;
+    // the faces are decoded in parallel, decoding takes most of the time
+    uint8_t* data[6];
+    int w[6], h[6], c[6];
+    #pragma omp parallel for
+    for (int32_t i = 0; i < 6; i++)
+        data[i] = stbi_load(paths[i], &w[i], &h[i], &c[i], force_channels);
 
+    // the borders and mip levels are built once, after the last face is loaded
+    ImageCreateInfo image_ci = {};
+    ImageError error = RT_IMAGE_ERROR_NONE;
+    cubemap.free();
     for (uint32_t i = 0; i < 6; i++)
     {
-        data = stbi_load(paths[i], &w, &h, &c, force_channels);
-
-        image_ci.width = (uint32_t)w;
-        image_ci.height = (uint32_t)h;
+        image_ci.width = (uint32_t)w[i];
+        image_ci.height = (uint32_t)h[i];
         image_ci.depth = 1;
-        image_ci.channels = (force_channels == 0) ? (uint32_t)c : force_channels;
+        image_ci.channels = (force_channels == 0) ? (uint32_t)c[i] : force_channels;
 
-        error = cubemap.load(image_ci, static_cast<CubemapFace>(i), data);
-        if (error != RT_IMAGE_ERROR_NONE) return error;
+        if (error == RT_IMAGE_ERROR_NONE)
+            error = cubemap.load(image_ci, static_cast<CubemapFace>(i), data[i]);
+        stbi_image_free(data[i]);   // the cubemap has copied the face
     }
-    return RT_IMAGE_ERROR_NONE;
+    return error;
 }
 
-ImageError TextureLoader::load_cube16(Cubemap<uint16_t, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
+template<typename T_texel>
+ImageError TextureLoader::load_cube16(Cubemap<uint16_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
 {
     const char* const* const paths = (const char* const*)&cci;
 
-    uint16_t* data;
-    int w, h, c;
-    ImageCreateInfo image_ci = {};
-    ImageError error;
+    // the faces are decoded in parallel, decoding takes most of the time
+    uint16_t* data[6];
+    int w[6], h[6], c[6];
+    #pragma omp parallel for
+    for (int32_t i = 0; i < 6; i++)
+        data[i] = stbi_load_16(paths[i], &w[i], &h[i], &c[i], force_channels);
 
+    // the borders and mip levels are built once, after the last face is loaded
+    ImageCreateInfo image_ci = {};
+    ImageError error = RT_IMAGE_ERROR_NONE;
+    cubemap.free();
     for (uint32_t i = 0; i < 6; i++)
     {
-        data = stbi_load_16(paths[i], &w, &h, &c, force_channels);
-
-        image_ci.width = (uint32_t)w;
-        image_ci.height = (uint32_t)h;
+        image_ci.width = (uint32_t)w[i];
+        image_ci.height = (uint32_t)h[i];
         image_ci.depth = 1;
-        image_ci.channels = (force_channels == 0) ? (uint32_t)c : force_channels;
+        image_ci.channels = (force_channels == 0) ? (uint32_t)c[i] : force_channels;
 
-        error = cubemap.load(image_ci, static_cast<CubemapFace>(i), data);
-        if (error != RT_IMAGE_ERROR_NONE) return error;
+        if (error == RT_IMAGE_ERROR_NONE)
+            error = cubemap.load(image_ci, static_cast<CubemapFace>(i), data[i]);
+        stbi_image_free(data[i]);   // the cubemap has copied the face
     }
-    return RT_IMAGE_ERROR_NONE;
+    return error;
 }
 
-ImageError TextureLoader::load_cubef(Cubemap<float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
+template<typename T_texel>
+ImageError TextureLoader::load_cubef(Cubemap<float, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
 {
     const char* const* const paths = (const char* const*)&cci;
 
-    float* data;
-    int w, h, c;
-    ImageCreateInfo image_ci = {};
-    ImageError error;
+    // the faces are decoded in parallel, decoding takes most of the time
+    float* data[6];
+    int w[6], h[6], c[6];
+    #pragma omp parallel for
+    for (int32_t i = 0; i < 6; i++)
+        data[i] = stbi_loadf(paths[i], &w[i], &h[i], &c[i], force_channels);
 
+    // the borders and mip levels are built once, after the last face is loaded
+    ImageCreateInfo image_ci = {};
+    ImageError error = RT_IMAGE_ERROR_NONE;
+    cubemap.free();
     for (uint32_t i = 0; i < 6; i++)
     {
-        data = stbi_loadf(paths[i], &w, &h, &c, force_channels);
-
-        image_ci.width = (uint32_t)w;
-        image_ci.height = (uint32_t)h;
+        image_ci.width = (uint32_t)w[i];
+        image_ci.height = (uint32_t)h[i];
         image_ci.depth = 1;
-        image_ci.channels = (force_channels == 0) ? (uint32_t)c : force_channels;
+        image_ci.channels = (force_channels == 0) ? (uint32_t)c[i] : force_channels;
 
-        error = cubemap.load(image_ci, static_cast<CubemapFace>(i), data);
-        if (error != RT_IMAGE_ERROR_NONE) return error;
+        if (error == RT_IMAGE_ERROR_NONE)
+            error = cubemap.load(image_ci, static_cast<CubemapFace>(i), data[i]);
+        stbi_image_free(data[i]);   // the cubemap has copied the face
     }
-    return RT_IMAGE_ERROR_NONE;
-}
\ No newline at end of file
+    return error;
+}
+
+template<typename T_texel>
+std::future<ImageError> TextureLoader::load_cube_async(Cubemap<uint8_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
+{
+    const cubemap_paths_t paths(cci);
+    return std::async(std::launch::async, [&cubemap, paths, force_channels]() { return TextureLoader::load_cube(cubemap, paths.create_info(), force_channels); });
+}
+
+template<typename T_texel>
+std::future<ImageError> TextureLoader::load_cube16_async(Cubemap<uint16_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
+{
+    const cubemap_paths_t paths(cci);
+    return std::async(std::launch::async, [&cubemap, paths, force_channels]() { return TextureLoader::load_cube16(cubemap, paths.create_info(), force_channels); });
+}
+
+template<typename T_texel>
+std::future<ImageError> TextureLoader::load_cubef_async(Cubemap<float, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels)
+{
+    const cubemap_paths_t paths(cci);
+    return std::async(std::launch::async, [&cubemap, paths, force_channels]() { return TextureLoader::load_cubef(cubemap, paths.create_info(), force_channels); });
+}
+
+// texel storage types the loaders are compiled for
+template ImageError TextureLoader::load_cube<float>(Cubemap<uint8_t, float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cube<uint8_t>(Cubemap<uint8_t, float, uint8_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cube<half_t>(Cubemap<uint8_t, float, half_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cube<rgb9e5_t>(Cubemap<uint8_t, float, rgb9e5_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+template ImageError TextureLoader::load_cube16<float>(Cubemap<uint16_t, float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cube16<uint8_t>(Cubemap<uint16_t, float, uint8_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cube16<half_t>(Cubemap<uint16_t, float, half_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cube16<rgb9e5_t>(Cubemap<uint16_t, float, rgb9e5_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+template ImageError TextureLoader::load_cubef<float>(Cubemap<float, float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cubef<uint8_t>(Cubemap<float, float, uint8_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cubef<half_t>(Cubemap<float, float, half_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template ImageError TextureLoader::load_cubef<rgb9e5_t>(Cubemap<float, float, rgb9e5_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+template std::future<ImageError> TextureLoader::load_cube_async<float>(Cubemap<uint8_t, float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cube_async<uint8_t>(Cubemap<uint8_t, float, uint8_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cube_async<half_t>(Cubemap<uint8_t, float, half_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cube_async<rgb9e5_t>(Cubemap<uint8_t, float, rgb9e5_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+template std::future<ImageError> TextureLoader::load_cube16_async<float>(Cubemap<uint16_t, float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cube16_async<uint8_t>(Cubemap<uint16_t, float, uint8_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cube16_async<half_t>(Cubemap<uint16_t, float, half_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cube16_async<rgb9e5_t>(Cubemap<uint16_t, float, rgb9e5_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+template std::future<ImageError> TextureLoader::load_cubef_async<float>(Cubemap<float, float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cubef_async<uint8_t>(Cubemap<float, float, uint8_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cubef_async<half_t>(Cubemap<float, float, half_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_cubef_async<rgb9e5_t>(Cubemap<float, float, rgb9e5_t>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
\ No newline at end of file
@@ -11,49 +11,496 @@
 
 #pragma once
 
-#include "texture.h"
+#include "spherical_map.h"
+#include "environment_filter.h"
+#include <algorithm>
+#include <cstring>
 #include <map>
 
 namespace rt
 {
-    template<typename T_src, typename T_dst>
+    /**
+    *   A cubemap stores its 6 faces and all their mip levels in one contiguous array. Every mip level
+    *   is an atlas of the 6 faces, which are stored one below the other in the order of rt::CubemapFace.
+    *   Every face has a border of 1 pixel that is a copy of the adjacent pixels of the neighbouring faces,
+    *   so the linear filter blends across the edges of the faces without any address mode computation.
+    *   The texels are stored in the storage type T_texel (see rt::TexelFormat) and have their centers at
+    *   (i + 0.5) / size of the face.
+    *   NOTE: The borders and mip levels are built as soon as all 6 faces are loaded.
+    *   The cubemap can be prefiltered for image based lighting (see prefilter()), it then has a second chain of
+    *   levels that are filtered with the GGX distribution of increasing roughness and the irradiance as
+    *   spherical harmonics.
+    */
+    template<typename T_src, typename T_dst, typename T_texel = T_dst>
     class Cubemap
     {
     private:
-        Texture2D<T_src, T_dst> faces[6];
+        using vec_ret = glm::vec<4, T_dst, glm::defaultp>;
+        using texel_format = TexelFormat<T_texel>;
 
-    public:
-        /** @param[in] filter: filter operation  */
-        explicit Cubemap(Filter filter = RT_FILTER_NEAREST) noexcept
+        static constexpr uint32_t ALL_FACES = 0x3F;
+
+        // a mip level of the cubemap, the atlas of the level is (size + 2) x 6 * (size + 2) pixels
+        struct level_t
+        {
+            size_t offset;      // index of the first element of the level in texels
+            uint32_t size;      // size of a face in pixels, without the border
+        };
+
+        std::vector<T_texel> texels;        // atlases of all mip levels, stored one after another
+        std::vector<level_t> levels;        // level 0 is the base level
+        Filter filter;
+        uint32_t channels;                  // number of color channels of a texel
+        uint32_t loaded_faces;              // bit i is set if the face i is loaded
+        bool mipmapped;                     // generate the mip levels when the faces are loaded
+
+        std::vector<T_texel> prefiltered_texels;    // atlases of the prefiltered levels, stored one after another
+        std::vector<level_t> prefiltered_levels;    // prefiltered level i + 1, level 0 is the base level itself
+        SHIrradiance sh_irradiance;                 // irradiance of the base level
+
+        /**
+        *   @return The axes of a face: the normal of the face followed by the directions in
+        *   which the u- and v-coordinates of the face increase, with v = 0 at the top.
+        */
+        static const glm::vec3* face_axes(uint32_t face) noexcept
+        {
+            static const glm::vec3 axes[6][3] =
+            {
+                { { 1.0f,  0.0f,  0.0f}, { 0.0f,  0.0f, -1.0f}, { 0.0f, -1.0f,  0.0f} },
+                { {-1.0f,  0.0f,  0.0f}, { 0.0f,  0.0f,  1.0f}, { 0.0f, -1.0f,  0.0f} },
+                { { 0.0f,  1.0f,  0.0f}, { 1.0f,  0.0f,  0.0f}, { 0.0f,  0.0f,  1.0f} },
+                { { 0.0f, -1.0f,  0.0f}, { 1.0f,  0.0f,  0.0f}, { 0.0f,  0.0f, -1.0f} },
+                { { 0.0f,  0.0f,  1.0f}, { 1.0f,  0.0f,  0.0f}, { 0.0f, -1.0f,  0.0f} },
+                { { 0.0f,  0.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, { 0.0f, -1.0f,  0.0f} }
+            };
+            return axes[face];
+        }
+
+        /**
+        *   @brief Converts a direction to the face and the uv-coordinate of the face.
+        *   The face is the one of the major axis, it is selected without branches.
+        *   @param[in] direction: sample direction
+        *   @param[out] face_uv: uv-coordinate within the face
+        *   @return index of the face
+        */
+        static uint32_t direction_to_face(const glm::vec3& direction, glm::vec2& face_uv) noexcept
+        {
+            // if two axes are equally long, z is preferred over y and y over x
+            const glm::vec3 abs_dir = glm::abs(direction);
+            const uint32_t axis = (abs_dir.z >= abs_dir.x && abs_dir.z >= abs_dir.y) ? 2 : ((abs_dir.y >= abs_dir.x) ? 1 : 0);
+            const uint32_t face_index = 2 * axis + static_cast<uint32_t>(direction[axis] < 0.0f);
+            const float max_axis = std::max(abs_dir[axis], std::numeric_limits<float>::min());
+
+            // the coordinates within the face have a range of -1 to +1 -> convert to 0 to +1
+            const glm::vec3* axes = face_axes(face_index);
+            face_uv.x = 0.5f * (glm::dot(direction, axes[1]) / max_axis + 1.0f);
+            face_uv.y = 0.5f * (glm::dot(direction, axes[2]) / max_axis + 1.0f);
+            return face_index;
+        }
+
+        /** @return The (not normalized) direction to the uv-coordinate @param u, @param v of the face @param face. */
+        static glm::vec3 face_to_direction(uint32_t face, float u, float v) noexcept
+        {
+            const glm::vec3* axes = face_axes(face);
+            return axes[0] + (2.0f * u - 1.0f) * axes[1] + (2.0f * v - 1.0f) * axes[2];
+        }
+
+        // clamps @param x to [@param lo, @param hi], NaN is clamped to @param lo
+        static inline float clamp(float x, float lo, float hi) noexcept
+        {
+            x = (x > lo) ? x : lo;
+            return (x < hi) ? x : hi;
+        }
+
+        // converts source-type to destination-type, the same as rt::Texture
+        static T_dst convert_type(T_src v) noexcept
+        {
+            if (std::is_floating_point<T_src>::value) return static_cast<T_dst>(v);
+            return static_cast<T_dst>(v) / static_cast<T_dst>(std::numeric_limits<T_src>::max());
+        }
+
+        /** @return Index of the first element of the texel at @param x, @param y of a face, the border is at -1 and size. */
+        inline size_t texel_index(const level_t& level, uint32_t face, int32_t x, int32_t y) const noexcept
         {
-            for (uint32_t i = 0; i < 6; i++)
+            const size_t stride = level.size + 2;
+            return level.offset + ((face * stride + static_cast<size_t>(y + 1)) * stride + static_cast<size_t>(x + 1)) * texel_format::elements(this->channels);
+        }
+
+        /**
+        *   @brief Allocates the mip levels of the cubemap, the texels are 0.
+        *   @param[in] size: Size of a face of the base level.
+        *   @param[in] channels: Number of color channels.
+        */
+        void allocate(uint32_t size, uint32_t channels)
+        {
+            this->free();
+            this->channels = channels;
+
+            size_t offset = 0;
+            for (;;)
             {
-                this->faces[i].set_filter(filter);
-                this->faces[i].set_address_mode(RT_TEXTURE_ADDRESS_MODE_REPEAT, RT_TEXTURE_ADDRESS_MODE_REPEAT, RT_TEXTURE_ADDRESS_MODE_REPEAT);
+                this->levels.push_back({ offset, size });
+                offset += 6 * static_cast<size_t>(size + 2) * (size + 2) * texel_format::elements(channels);
+                if (!this->mipmapped || size == 1) break;
+                size /= 2;
             }
+            this->texels.assign(offset, T_texel());
         }
+
+        /** @brief Copies the pixels of the neighbouring faces into the border of every face of the level @param l of @param data. */
+        void fill_border(T_texel* data, const level_t& l) noexcept
+        {
+            const int32_t s = static_cast<int32_t>(l.size);
+            const float inv_size = 1.0f / static_cast<float>(s);
+            const size_t elements = texel_format::elements(this->channels);
+
+            for (uint32_t face = 0; face < 6; face++)
+            {
+                for (int32_t y = -1; y <= s; y++)
+                {
+                    // only the first and the last column of the inner rows are border pixels
+                    const int32_t step = (y == -1 || y == s) ? 1 : s + 1;
+                    for (int32_t x = -1; x <= s; x += step)
+                    {
+                        // the center of the border pixel is projected onto the neighbouring face, whose nearest pixel is copied
+                        glm::vec2 uv;
+                        const glm::vec3 direction = face_to_direction(face, (static_cast<float>(x) + 0.5f) * inv_size, (static_cast<float>(y) + 0.5f) * inv_size);
+                        const uint32_t src_face = direction_to_face(direction, uv);
+                        const int32_t src_x = static_cast<int32_t>(clamp(uv.x * s, 0.0f, static_cast<float>(s - 1)));
+                        const int32_t src_y = static_cast<int32_t>(clamp(uv.y * s, 0.0f, static_cast<float>(s - 1)));
+                        memcpy(data + this->texel_index(l, face, x, y), data + this->texel_index(l, src_face, src_x, src_y), sizeof(T_texel) * elements);
+                    }
+                }
+            }
+        }
+
+        /** @brief Combutes the faces of a mip level with a box filter from the level above, @param level must be greater than 0. */
+        void downsample(uint32_t level) noexcept
+        {
+            const level_t& src = this->levels[level - 1];
+            const level_t& dst = this->levels[level];
+            const int32_t src_max = static_cast<int32_t>(src.size) - 1;
+
+            for (uint32_t face = 0; face < 6; face++)
+            {
+                for (int32_t y = 0; y < static_cast<int32_t>(dst.size); y++)
+                {
+                    for (int32_t x = 0; x < static_cast<int32_t>(dst.size); x++)
+                    {
+                        // the pixels at the end of odd sized faces are clamped to the edge of the face
+                        vec_ret sum(static_cast<T_dst>(0));
+                        for (int32_t j = 0; j < 2; j++)
+                        {
+                            for (int32_t i = 0; i < 2; i++)
+                            {
+                                vec_ret texel;
+                                texel_format::decode(this->texels.data() + this->texel_index(src, face, std::min(2 * x + i, src_max), std::min(2 * y + j, src_max)), this->channels, (T_dst*)&texel);
+                                sum += static_cast<T_dst>(0.25) * texel;
+                            }
+                        }
+                        texel_format::encode((const T_dst*)&sum, this->channels, this->texels.data() + this->texel_index(dst, face, x, y));
+                    }
+                }
+            }
+        }
+
+        /** @brief Builds the borders of the base level and the mip levels, after all faces have been loaded. */
+        void build_levels(void) noexcept
+        {
+            this->fill_border(this->texels.data(), this->levels[0]);
+            for (uint32_t level = 1; level < this->levels.size(); level++)
+            {
+                this->downsample(level);
+                this->fill_border(this->texels.data(), this->levels[level]);
+            }
+        }
+
+        /**
+        *   @brief Samples one level of a face.
+        *   @param[in] data: texels of the level
+        *   @param[in] l: the level
+        *   @param[in] face: index of the face
+        *   @param[in] uv: uv-coordinate within the face
+        *   @param[in] linear: True for linear filtering, otherwise the nearest pixel is sampled.
+        *   @param[out] color: Color of the sample.
+        */
+        void sample_level(const T_texel* data, const level_t& l, uint32_t face, const glm::vec2& uv, bool linear, vec_ret& color) const noexcept
+        {
+            const float s = static_cast<float>(l.size);
+
+            if (!linear)
+            {
+                const int32_t x = static_cast<int32_t>(clamp(uv.x * s, 0.0f, s - 1.0f));
+                const int32_t y = static_cast<int32_t>(clamp(uv.y * s, 0.0f, s - 1.0f));
+                texel_format::decode(data + this->texel_index(l, face, x, y), this->channels, (T_dst*)&color);
+                return;
+            }
+
+            // the footprint of 2x2 pixels is always within the face and its border
+            const float px = clamp(uv.x * s - 0.5f, -0.5f, s - 0.5f);
+            const float py = clamp(uv.y * s - 0.5f, -0.5f, s - 0.5f);
+            const float fx = std::floor(px), fy = std::floor(py);
+            const T_texel* t00 = data + this->texel_index(l, face, static_cast<int32_t>(fx), static_cast<int32_t>(fy));
+            const size_t elements = texel_format::elements(this->channels);
+            const size_t stride = (l.size + 2) * elements;
+
+            vec_ret c00, c10, c01, c11;
+            texel_format::decode(t00,                       this->channels, (T_dst*)&c00);
+            texel_format::decode(t00 + elements,            this->channels, (T_dst*)&c10);
+            texel_format::decode(t00 + stride,              this->channels, (T_dst*)&c01);
+            texel_format::decode(t00 + stride + elements,   this->channels, (T_dst*)&c11);
+
+            const T_dst tx = static_cast<T_dst>(px - fx);
+            const T_dst ty = static_cast<T_dst>(py - fy);
+            color = glm::mix(glm::mix(c00, c10, tx), glm::mix(c01, c11, tx), ty);
+        }
+
+        // samples one mip level of a face of the base chain
+        inline void sample_level(uint32_t face, const glm::vec2& uv, uint32_t level, bool linear, vec_ret& color) const noexcept
+        {
+            this->sample_level(this->texels.data(), this->levels[level], face, uv, linear, color);
+        }
+
+        /** @brief Samples the mip levels at a level of detail, always with the trilinear filter. */
+        vec_ret sample_trilinear(const glm::vec3& direction, float lod) const noexcept
+        {
+            glm::vec2 uv;
+            vec_ret color;
+            const uint32_t face_index = direction_to_face(direction, uv);
+            lod = clamp(lod, 0.0f, static_cast<float>(this->levels.size() - 1));
+            const uint32_t level = static_cast<uint32_t>(lod);
+            const float t = lod - static_cast<float>(level);
+            this->sample_level(face_index, uv, level, true, color);
+            if (t > 0.0f)
+            {
+                vec_ret color1;
+                this->sample_level(face_index, uv, level + 1, true, color1);
+                color = glm::mix(color, color1, static_cast<T_dst>(t));
+            }
+            return color;
+        }
+
+        // samples the prefiltered level @param level of a face, level 0 is the base level
+        inline void sample_prefiltered_level(uint32_t face, const glm::vec2& uv, uint32_t level, vec_ret& color) const noexcept
+        {
+            if (level == 0)
+                this->sample_level(this->texels.data(), this->levels[0], face, uv, true, color);
+            else
+                this->sample_level(this->prefiltered_texels.data(), this->prefiltered_levels[level - 1], face, uv, true, color);
+        }
+
+        /** @brief Projects the base level onto spherical harmonics. */
+        void combute_irradiance(void)
+        {
+            // every face is projected on its own and the projections are added afterwards
+            SHIrradiance face_sh[6];
+            const level_t& l = this->levels[0];
+            const float inv_size = 1.0f / static_cast<float>(l.size);
+
+            #pragma omp parallel for
+            for (int32_t face = 0; face < 6; face++)
+            {
+                for (uint32_t y = 0; y < l.size; y++)
+                {
+                    for (uint32_t x = 0; x < l.size; x++)
+                    {
+                        // solid angle of a pixel at (a, b) of a face that spans [-1, 1]^2 at a distance of 1
+                        const glm::vec3 direction = face_to_direction(face, (x + 0.5f) * inv_size, (y + 0.5f) * inv_size);
+                        const float r2 = glm::dot(direction, direction);
+                        const float solid_angle = 4.0f * inv_size * inv_size / (r2 * std::sqrt(r2));
+
+                        vec_ret radiance;
+                        texel_format::decode(this->texels.data() + this->texel_index(l, face, x, y), this->channels, (T_dst*)&radiance);
+                        face_sh[face].add(glm::normalize(direction), glm::vec3(radiance), solid_angle);
+                    }
+                }
+            }
+
+            this->sh_irradiance.clear();
+            for (uint32_t face = 0; face < 6; face++)
+                this->sh_irradiance += face_sh[face];
+        }
+
+    public:
+        /** @param[in] filter: filter operation  */
+        explicit Cubemap(Filter filter = RT_FILTER_NEAREST) noexcept
+            : filter(filter), channels(0), loaded_faces(0), mipmapped(true) {}
+
         virtual ~Cubemap(void)
         {
             this->free();
         }
 
+        /** @param[in] filter: filter operation */
+        void set_filter(Filter filter) noexcept { this->filter = filter; }
+
+        /**
+        *   @param[in] generate: True to generate the mip levels when the faces are loaded (default).
+        *   Without mip levels, sampling at a level of detail always samples the base level.
+        */
+        void set_mipmaps(bool generate) noexcept { this->mipmapped = generate; }
+
+        /** @return The size of a face of the base level in pixels, 0 if the cubemap is empty. */
+        inline uint32_t face_size(void) const noexcept
+        {
+            return this->levels.empty() ? 0 : this->levels[0].size;
+        }
+
+        /** @return Number of color channels of a texel. */
+        inline uint32_t channel_count(void) const noexcept
+        {
+            return this->channels;
+        }
+
+        /** @return The number of mip levels, including the base level. */
+        inline uint32_t mip_level_count(void) const noexcept
+        {
+            return static_cast<uint32_t>(this->levels.size());
+        }
+
         /**
         *   @brief Loads one face into the cubemap.
+        *   The faces must be square and all faces must have the same size and channel count. If a face has
+        *   another size or channel count than the faces that are already loaded, the other faces are discarded.
         *   @param[in] ci: image create info
         *   @param[in] face: cubemap face
         *   @param[in] data: pixels
         *   @return image error
         */
-        ImageError load(const ImageCreateInfo& ci, CubemapFace face, const T_src* data) noexcept
+        ImageError load(const ImageCreateInfo& ci, CubemapFace face, const T_src* data)
         {
-            return this->faces[static_cast<uint32_t>(face)].load(ci, data);
+            if (data == nullptr) return RT_IMAGE_ERROR_NULL;
+            if (ci.width == 0 || ci.height == 0) return RT_IMAGE_ERROR_ZERO_SIZE;
+            if (ci.width != ci.height || ci.channels > texel_format::MAX_CHANNELS) return RT_IMAGE_ERROR_UNSUPPORTED_FORMAT;
+
+            if (this->face_size() != ci.width || this->channels != ci.channels)
+                this->allocate(ci.width, ci.channels);
+
+            const uint32_t f = static_cast<uint32_t>(face);
+            #pragma omp parallel for
+            for (int32_t y = 0; y < static_cast<int32_t>(ci.height); y++)
+            {
+                for (uint32_t x = 0; x < ci.width; x++)
+                {
+                    const T_src* src = data + ((size_t)y * ci.width + x) * ci.channels;
+                    T_dst texel[4];
+                    for (uint32_t c = 0; c < ci.channels; c++)
+                        texel[c] = convert_type(src[c]);
+                    texel_format::encode(texel, ci.channels, this->texels.data() + this->texel_index(this->levels[0], f, x, y));
+                }
+            }
+
+            this->loaded_faces |= (1 << f);
+            if (this->loaded_faces == ALL_FACES)
+                this->build_levels();
+            return RT_IMAGE_ERROR_NONE;
+        }
+
+        /**
+        *   @brief Converts a spherical map into the cubemap, every pixel of the faces samples the map once.
+        *   If the faces have fewer pixels than the map, the map is sampled at a level of detail.
+        *   @param[in] map: The spherical map.
+        *   @param[in] size: Size of the faces in pixels, width / 4 of the map keeps the resolution at the horizon.
+        *   @return image error
+        */
+        template<typename T_map_src, typename T_map_dst, typename T_map_texel>
+        ImageError load(const SphericalMap<T_map_src, T_map_dst, T_map_texel>& map, uint32_t size)
+        {
+            if (map.map_rdonly() == nullptr) return RT_IMAGE_ERROR_NULL;
+            if (size == 0) return RT_IMAGE_ERROR_ZERO_SIZE;
+            if (map.channel_count() > texel_format::MAX_CHANNELS) return RT_IMAGE_ERROR_UNSUPPORTED_FORMAT;
+
+            this->allocate(size, map.channel_count());
+            const float inv_size = 1.0f / static_cast<float>(size);
+            const float texels_per_pixel = static_cast<float>(map.width()) * static_cast<float>(map.height()) / (6.0f * size * size);
+            const float lod = (texels_per_pixel > 1.0f) ? 0.5f * std::log2(texels_per_pixel) : 0.0f;
+
+            // the rows of all faces are converted in parallel
+            #pragma omp parallel for
+            for (int32_t row = 0; row < static_cast<int32_t>(6 * size); row++)
+            {
+                const uint32_t face = static_cast<uint32_t>(row) / size;
+                const uint32_t y = static_cast<uint32_t>(row) % size;
+                for (uint32_t x = 0; x < size; x++)
+                {
+                    const glm::vec3 direction = glm::normalize(face_to_direction(face, (x + 0.5f) * inv_size, (y + 0.5f) * inv_size));
+                    const vec_ret color(map.sample(glm::vec4(direction, 0.0f), lod));
+                    texel_format::encode((const T_dst*)&color, this->channels, this->texels.data() + this->texel_index(this->levels[0], face, x, y));
+                }
+            }
+
+            this->loaded_faces = ALL_FACES;
+            this->build_levels();
+            return RT_IMAGE_ERROR_NONE;
+        }
+
+        /**
+        *   @brief Precomputes the lighting of the cubemap for image based lighting.
+        *   The irradiance is projected onto spherical harmonics (see sample_irradiance()). The prefiltered
+        *   level i is filtered with the GGX distribution of roughness i / (levels - 1) and has the face size of
+        *   the mip level i (see sample_prefiltered()). Level 0 is the cubemap itself.
+        *   The samples read the mip levels of the cubemap, which makes a few dozen samples sufficient.
+        *   NOTE: The precomputation must be repeated if the cubemap is loaded again.
+        *   @param[in] levels: Number of prefiltered levels, including level 0.
+        *   @param[in] samples: Number of samples per pixel of the prefiltered levels.
+        *   @return RT_IMAGE_ERROR_NULL if not all faces are loaded.
+        */
+        ImageError prefilter(uint32_t levels = 6, uint32_t samples = 64)
+        {
+            if (this->loaded_faces != ALL_FACES) return RT_IMAGE_ERROR_NULL;
+            if (levels == 0 || samples == 0) return RT_IMAGE_ERROR_ZERO_SIZE;
+
+            this->combute_irradiance();
+
+            this->prefiltered_levels.clear();
+            size_t offset = 0;
+            uint32_t size = this->levels[0].size;
+            for (uint32_t i = 1; i < levels; i++)
+            {
+                size = std::max(size / 2, 1u);
+                this->prefiltered_levels.push_back({ offset, size });
+                offset += 6 * static_cast<size_t>(size + 2) * (size + 2) * texel_format::elements(this->channels);
+            }
+            this->prefiltered_texels.assign(offset, T_texel());
+
+            const float texel_solid_angle = 4.0f * 3.14159265f / (6.0f * this->levels[0].size * this->levels[0].size);
+            for (uint32_t i = 1; i < levels; i++)
+            {
+                const level_t& l = this->prefiltered_levels[i - 1];
+                const float roughness = static_cast<float>(i) / static_cast<float>(levels - 1);
+                const float inv_size = 1.0f / static_cast<float>(l.size);
+                const int32_t rows = 6 * static_cast<int32_t>(l.size);
+
+                #pragma omp parallel for
+                for (int32_t row = 0; row < rows; row++)
+                {
+                    const uint32_t face = static_cast<uint32_t>(row) / l.size;
+                    const uint32_t y = static_cast<uint32_t>(row) % l.size;
+                    for (uint32_t x = 0; x < l.size; x++)
+                    {
+                        const glm::vec3 n = glm::normalize(face_to_direction(face, (x + 0.5f) * inv_size, (y + 0.5f) * inv_size));
+                        const vec_ret color = EnvironmentFilter::ggx(n, roughness, samples, texel_solid_angle,
+                            [this](const glm::vec3& direction, float lod) { return this->sample_trilinear(direction, lod); });
+                        texel_format::encode((const T_dst*)&color, this->channels, this->prefiltered_texels.data() + this->texel_index(l, face, x, y));
+                    }
+                }
+                this->fill_border(this->prefiltered_texels.data(), l);
+            }
+            return RT_IMAGE_ERROR_NONE;
         }
 
         /** @brief Frees the allocated memory of the cubemap. */
         void free(void) noexcept
         {
-            for (uint32_t i = 0; i < 6; i++)
-                this->faces[i].free();
+            this->texels.clear();
+            this->texels.shrink_to_fit();
+            this->levels.clear();
+            this->prefiltered_texels.clear();
+            this->prefiltered_texels.shrink_to_fit();
+            this->prefiltered_levels.clear();
+            this->sh_irradiance.clear();
+            this->channels = 0;
+            this->loaded_faces = 0;
         }
 
         /**
@@ -63,88 +510,170 @@ namespace rt
         */
         virtual glm::vec4 sample(const glm::vec3& direction) const
         {
-            /* GET UV COORDINATES */
-            const glm::vec3 abs_dir = glm::abs(direction);
-            bool is_x_positive = (direction.x >= 0.0f);
-            bool is_y_positive = (direction.y >= 0.0f);
-            bool is_z_positive = (direction.z >= 0.0f);
-
-            float max_axis;
             glm::vec2 uv;
-            uint32_t face_index = 0;
+            vec_ret color;
+            const uint32_t face_index = direction_to_face(direction, uv);
+            this->sample_level(face_index, uv, 0, this->filter != RT_FILTER_NEAREST, color);
+            return glm::vec4(color);
+        }
 
-            // front face / positive X
-            if (is_x_positive && abs_dir.x >= abs_dir.y && abs_dir.x >= abs_dir.z)
-            {
-                // u (0 to 1) goes from +z to -z
-                // v (0 to 1) goes from -y to +y
-                max_axis = abs_dir.x;
-                uv.x = -direction.z;
-                uv.y = direction.y;
-                face_index = 0;
-            }
+        /**
+        *   @brief Samples the cubemap in many directions with one call, the same as sample(direction) for every direction.
+        *   The faces, the uv-coordinates and the pixel-coordinates of simd::WIDTH directions are combuted at once,
+        *   only the texels are gathered and blended one sample after another.
+        *   @param[in] directions: sample directions
+        *   @param[out] out: Colors of the samples.
+        *   @param[in] n: Number of samples.
+        */
+        virtual void sample_n(const glm::vec3* directions, glm::vec4* out, size_t n) const
+        {
+            if (n == 0) return;
 
-            // back face / negative X
-            if (!is_x_positive && abs_dir.x >= abs_dir.y && abs_dir.x >= abs_dir.z)
-            {
-                // u (0 to 1) goes from -z to +z
-                // v (0 to 1) goes from -y to +y
-                max_axis = abs_dir.x;
-                uv.x = direction.z;
-                uv.y = direction.y;
-                face_index = 1;
-            }
+            // the level and the filter are the same for every sample
+            const bool linear = (this->filter != RT_FILTER_NEAREST);
+            const level_t& l = this->levels[0];
+            const T_texel* data = this->texels.data();
+            const float s = static_cast<float>(l.size);
+            const size_t elements = texel_format::elements(this->channels);
+            const size_t stride = (l.size + 2) * elements;
 
-            // top face / postive Y
-            if (is_y_positive && abs_dir.y >= abs_dir.x && abs_dir.y >= abs_dir.z)
-            {
-                // u (0 to 1) goes from -x to +x
-                // v (0 to 1) goes from +z to -z
-                max_axis = abs_dir.y;
-                uv.x = direction.x;
-                uv.y = -direction.z;
-                face_index = 2;
-            }
+            // the same clamping as sample_level(), the linear footprint of 2x2 pixels is always within the face and its border
+            const simd::vfloat size = simd::set1(s);
+            const simd::vfloat offset = simd::set1(linear ? 0.5f : 0.0f);
+            const simd::vfloat lo = simd::set1(linear ? -0.5f : 0.0f);
+            const simd::vfloat hi = simd::set1(linear ? s - 0.5f : s - 1.0f);
+            const simd::vfloat min_axis = simd::set1(std::numeric_limits<float>::min());
+            const simd::vfloat sign = simd::set1(-0.0f);
+            const simd::vfloat half = simd::set1(0.5f);
+            const simd::vfloat one = simd::set1(1.0f);
 
-            // bottom face / negative Y
-            if (!is_y_positive && abs_dir.y >= abs_dir.x && abs_dir.y >= abs_dir.z)
+            alignas(32) float x[simd::WIDTH], y[simd::WIDTH], z[simd::WIDTH];
+            alignas(32) float face[simd::WIDTH], px[simd::WIDTH], py[simd::WIDTH], tx[simd::WIDTH], ty[simd::WIDTH];
+            for (size_t first = 0; first < n; first += simd::WIDTH)
             {
-                // u (0 to 1) goes from -x to +x
-                // v (0 to 1) goes from -z to +z
-                max_axis = abs_dir.y;
-                uv.x = direction.x;
-                uv.y = direction.z;
-                face_index = 3;
+                // the lanes after the last direction repeat the last direction
+                const size_t m = std::min<size_t>(simd::WIDTH, n - first);
+                for (size_t i = 0; i < simd::WIDTH; i++)
+                {
+                    const glm::vec3& direction = directions[first + std::min(i, m - 1)];
+                    x[i] = direction.x;
+                    y[i] = direction.y;
+                    z[i] = direction.z;
+                }
+
+                // the same face selection as direction_to_face(), if two axes are equally long z is preferred over y and y over x
+                const simd::vfloat dx = simd::load(x), dy = simd::load(y), dz = simd::load(z);
+                const simd::vfloat ax = simd::abs(dx), ay = simd::abs(dy), az = simd::abs(dz);
+                const simd::vfloat is_z = simd::bit_and(simd::cmp_ge(az, ax), simd::cmp_ge(az, ay));
+                const simd::vfloat is_y = simd::bit_andnot(is_z, simd::cmp_ge(ay, ax));
+                const simd::vfloat major = simd::select(is_z, dz, simd::select(is_y, dy, dx));
+                const simd::vfloat neg = simd::cmp_lt(major, simd::zero());
+                const simd::vfloat max_axis = simd::max(min_axis, simd::abs(major));
+                const simd::vfloat axis = simd::select(is_z, simd::set1(2.0f), simd::bit_and(is_y, one));
+                simd::store(face, simd::add(simd::add(axis, axis), simd::bit_and(neg, one)));
+
+                // the u- and v-axes of the faces (see face_axes()) pick one component of the direction and its sign
+                const simd::vfloat nx = simd::bit_xor(dx, sign), ny = simd::bit_xor(dy, sign), nz = simd::bit_xor(dz, sign);
+                const simd::vfloat su = simd::select(is_z, simd::select(neg, nx, dx), simd::select(is_y, dx, simd::select(neg, dz, nz)));
+                const simd::vfloat sv = simd::select(is_y, simd::select(neg, nz, dz), ny);
+                const simd::vfloat u = simd::mul(half, simd::add(simd::div(su, max_axis), one));
+                const simd::vfloat v = simd::mul(half, simd::add(simd::div(sv, max_axis), one));
+
+                // pixel-coordinates of the samples, NaN is clamped to the lower bound
+                const simd::vfloat pu = simd::min(simd::max(simd::sub(simd::mul(u, size), offset), lo), hi);
+                const simd::vfloat pv = simd::min(simd::max(simd::sub(simd::mul(v, size), offset), lo), hi);
+                const simd::vfloat fu = simd::floor(pu), fv = simd::floor(pv);
+                simd::store(px, fu);
+                simd::store(py, fv);
+                simd::store(tx, simd::sub(pu, fu));
+                simd::store(ty, simd::sub(pv, fv));
+
+                for (size_t i = 0; i < m; i++)
+                {
+                    const T_texel* t00 = data + this->texel_index(l, static_cast<uint32_t>(face[i]), static_cast<int32_t>(px[i]), static_cast<int32_t>(py[i]));
+                    vec_ret color;
+                    if (linear)
+                    {
+                        vec_ret c00, c10, c01, c11;
+                        texel_format::decode(t00,                       this->channels, (T_dst*)&c00);
+                        texel_format::decode(t00 + elements,            this->channels, (T_dst*)&c10);
+                        texel_format::decode(t00 + stride,              this->channels, (T_dst*)&c01);
+                        texel_format::decode(t00 + stride + elements,   this->channels, (T_dst*)&c11);
+
+                        const T_dst _tx = static_cast<T_dst>(tx[i]);
+                        const T_dst _ty = static_cast<T_dst>(ty[i]);
+                        color = glm::mix(glm::mix(c00, c10, _tx), glm::mix(c01, c11, _tx), _ty);
+                    }
+                    else
+                    {
+                        texel_format::decode(t00, this->channels, (T_dst*)&color);
+                    }
+                    out[first + i] = glm::vec4(color);
+                }
             }
+        }
 
-            // left face / postive Z
-            if (is_z_positive && abs_dir.z >= abs_dir.x && abs_dir.z >= abs_dir.y)
+        /**
+        *   @brief Samples the cubemap at a level of detail (see RT_FILTER_TRILINEAR).
+        *   @param[in] direction: sample direction
+        *   @param[in] lod: Level of detail, 0 is the base level. Gets clamped to the existing mip levels.
+        *   @return Color of the sample.
+        */
+        virtual glm::vec4 sample(const glm::vec3& direction, float lod) const
+        {
+            glm::vec2 uv;
+            vec_ret color;
+            const uint32_t face_index = direction_to_face(direction, uv);
+            lod = glm::clamp(lod, 0.0f, static_cast<float>(this->levels.size() - 1));
+            if (this->filter == RT_FILTER_TRILINEAR)
             {
-                // u (0 to 1) goes from -x to +x
-                // v (0 to 1) goes from -y to +y
-                max_axis = abs_dir.z;
-                uv.x = direction.x;
-                uv.y = direction.y;
-                face_index = 4;
+                const uint32_t level = static_cast<uint32_t>(lod);
+                const float t = lod - static_cast<float>(level);
+                this->sample_level(face_index, uv, level, true, color);
+                if (t > 0.0f)
+                {
+                    vec_ret color1;
+                    this->sample_level(face_index, uv, level + 1, true, color1);
+                    color = glm::mix(color, color1, static_cast<T_dst>(t));
+                }
+                return glm::vec4(color);
             }
+            this->sample_level(face_index, uv, static_cast<uint32_t>(lod + 0.5f), this->filter == RT_FILTER_LINEAR, color);
+            return glm::vec4(color);
+        }
 
-            // right face / negative Z
-            if (!is_z_positive && abs_dir.z >= abs_dir.x && abs_dir.z >= abs_dir.y)
+        /**
+        *   @brief Samples the glossy reflection of the environment, the two closest prefiltered levels are blended.
+        *   Without prefilter() the cubemap is sampled linear and the roughness is ignored.
+        *   @param[in] direction: Direction of the reflection.
+        *   @param[in] roughness: Perceptual roughness of the surface in [0, 1].
+        *   @return Color of the sample.
+        */
+        glm::vec4 sample_prefiltered(const glm::vec3& direction, float roughness) const
+        {
+            glm::vec2 uv;
+            vec_ret color;
+            const uint32_t face_index = direction_to_face(direction, uv);
+            const float lod = clamp(roughness, 0.0f, 1.0f) * static_cast<float>(this->prefiltered_levels.size());
+            const uint32_t level = static_cast<uint32_t>(lod);
+            const float t = lod - static_cast<float>(level);
+            this->sample_prefiltered_level(face_index, uv, level, color);
+            if (t > 0.0f)
             {
-                // u (0 to 1) goes from +x to -x
-                // v (0 to 1) goes from -y to +y
-                max_axis = abs_dir.z;
-                uv.x = -direction.x;
-                uv.y = direction.y;
-                face_index = 5;
+                vec_ret color1;
+                this->sample_prefiltered_level(face_index, uv, level + 1, color1);
+                color = glm::mix(color, color1, static_cast<T_dst>(t));
             }
+            return glm::vec4(color);
+        }
 
-            // uv coordinates have a range of -1 to +1 -> convert to 0 to +1
-            uv = 0.5f * (uv / max_axis + 1.0f);
-            uv.y = 1.0f - uv.y;
-
-            // sample face texture
-            return this->faces[face_index].sample(glm::vec4(uv.x, uv.y, 0.0f, 0.0f));
+        /**
+        *   @param[in] normal: normalized surface normal
+        *   @return The radiance a white diffuse surface reflects, 0 without prefilter().
+        */
+        inline glm::vec3 sample_irradiance(const glm::vec3& normal) const noexcept
+        {
+            return this->sh_irradiance.irradiance(normal);
         }
     };
 
@@ -153,6 +682,10 @@ namespace rt
     *   1) 8-bit (per color channel) image format
     *   2) 16-bit (per color channel) image format
     *   3) floating-point image format
+    *   The texels can be stored as float (default), uint8_t, rt::half_t or rt::rgb9e5_t.
+    *   The 6 faces are decoded in parallel. Every function has an asynchronous version, which loads
+    *   the cubemap on its own thread and returns a future of the image error.
+    *   IMPORTANT: The cubemap must not be used or destroyed until the future is ready.
     */
     namespace TextureLoader
     {
@@ -164,7 +697,8 @@ namespace rt
         *                              Leave it to 0 to not force the loader.
         *   @return image error
         */
-        ImageError load_cube(Cubemap<uint8_t, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+        template<typename T_texel>
+        ImageError load_cube(Cubemap<uint8_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
 
         /**
         *   @brief Loads 6 16-bit (per color channel) images into a cubemap object.
@@ -174,7 +708,8 @@ namespace rt
         *                              Leave it to 0 to not force the loader.
         *   @return image error
         */
-        ImageError load_cube16(Cubemap<uint16_t, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+        template<typename T_texel>
+        ImageError load_cube16(Cubemap<uint16_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
 
         /**
         *   @brief Loads 6 floating-point images into a cubemap object.
@@ -184,6 +719,19 @@ namespace rt
         *                              Leave it to 0 to not force the loader.
         *   @return image error
         */
-        ImageError load_cubef(Cubemap<float, float>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+        template<typename T_texel>
+        ImageError load_cubef(Cubemap<float, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+        /** @brief Asynchronous version of load_cube(), the paths are copied and the returned future contains the image error. */
+        template<typename T_texel>
+        std::future<ImageError> load_cube_async(Cubemap<uint8_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+        /** @brief Asynchronous version of load_cube16(), the paths are copied and the returned future contains the image error. */
+        template<typename T_texel>
+        std::future<ImageError> load_cube16_async(Cubemap<uint16_t, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
+
+        /** @brief Asynchronous version of load_cubef(), the paths are copied and the returned future contains the image error. */
+        template<typename T_texel>
+        std::future<ImageError> load_cubef_async(Cubemap<float, float, T_texel>& cubemap, const CubemapCreateInfo& cci, uint32_t force_channels);
     }
 };
\ No newline at end of file
@@ -13,14 +13,138 @@
 #pragma once
 
 #include "image.h"
+#include <glm/gtc/packing.hpp>
+#include <cstring>
 
 namespace rt
 {
+    /**
+     *  The frame-buffer stores its pixels in the format of the create info (ImageCreateInfo::format):
+     *  RT_FORMAT_R8G8B8_UNORM:         3 bytes per pixel, the colors are clamped to [0, 1].
+     *  RT_FORMAT_R16G16B16A16_SFLOAT:  4 half-floats per pixel, HDR.
+     *  RT_FORMAT_R32G32B32A32_SFLOAT:  4 floats per pixel, HDR.
+     *  Internally the pixels are stored as raw bytes, the channel count of the underlying
+     *  image is the size of a pixel in bytes. Use store() and load() to access single pixels.
+     */
     class Framebuffer : public Image2D<uint8_t>
     {
+    private:
+        // converts the create info to the create info of the underlying byte-image
+        static ImageCreateInfo byte_create_info(const ImageCreateInfo& ci) noexcept
+        {
+            ImageCreateInfo _ci = ci;
+            _ci.depth = 0;
+            _ci.channels = format_size(ci.format);
+            _ci.layout = RT_IMAGE_LAYOUT_LINEAR;   // the pixels are written to files row after row
+            return _ci;
+        }
+
     public:
         Framebuffer(void) : Image2D<uint8_t>() {}
-        explicit Framebuffer(const ImageCreateInfo& ci) noexcept : Image2D<uint8_t>(ci) {}
+        explicit Framebuffer(const ImageCreateInfo& ci) noexcept : Image2D<uint8_t>(byte_create_info(ci)) {}
         virtual ~Framebuffer(void) {}
+
+        /** @return The size of a pixel in bytes of the format @param format. */
+        static constexpr uint32_t format_size(ImageFormat format) noexcept
+        {
+            return (format == RT_FORMAT_R32G32B32A32_SFLOAT) ? 4 * sizeof(float) :
+                   (format == RT_FORMAT_R16G16B16A16_SFLOAT) ? 4 * sizeof(uint16_t) : 3 * sizeof(uint8_t);
+        }
+
+        /** @return The number of color channels of the format @param format. */
+        static constexpr uint32_t format_channels(ImageFormat format) noexcept
+        {
+            return (format == RT_FORMAT_R8G8B8_UNORM) ? 3 : 4;
+        }
+
+        /**
+        *   @brief Sets the create info for the frame-buffer.
+        *   The channel count of the create info is ignored, it is defined by the format.
+        *   @param[in] ci: ImageCreateInfo struct
+        */
+        void set_create_info(const ImageCreateInfo& ci) noexcept
+        {
+            Image2D<uint8_t>::set_create_info(byte_create_info(ci));
+        }
+
+        /** @return The pixel format of the frame-buffer. */
+        inline ImageFormat format(void) const noexcept
+        {
+            return this->create_info.format;
+        }
+
+        /** @return Number of color channels of the pixel format. */
+        inline uint32_t channel_count(void) const noexcept
+        {
+            return format_channels(this->create_info.format);
+        }
+
+        /** @return The size of a pixel in bytes. */
+        inline uint32_t pixel_size(void) const noexcept
+        {
+            return this->create_info.channels;
+        }
+
+        /**
+        *   @brief Writes a pixel and converts it to the format of the frame-buffer.
+        *   @param[in] x: X-coordinate of the pixel.
+        *   @param[in] y: Y-coordinate of the pixel.
+        *   @param[in] color: RGBA color of the pixel, the alpha channel is dropped for 3 channel formats.
+        */
+        inline void store(uint32_t x, uint32_t y, const glm::vec4& color) noexcept
+        {
+            uint8_t* pixel = this->map_rdwr() + this->combute_index({ x, y });
+            switch (this->create_info.format)
+            {
+            case RT_FORMAT_R32G32B32A32_SFLOAT:
+            {
+                const float rgba[4] = { color.r, color.g, color.b, color.a };
+                memcpy(pixel, rgba, sizeof(rgba));
+                break;
+            }
+            case RT_FORMAT_R16G16B16A16_SFLOAT:
+            {
+                const uint16_t rgba[4] = { glm::packHalf1x16(color.r), glm::packHalf1x16(color.g), glm::packHalf1x16(color.b), glm::packHalf1x16(color.a) };
+                memcpy(pixel, rgba, sizeof(rgba));
+                break;
+            }
+            default:
+            {
+                const glm::vec3 c = glm::clamp(glm::vec3(color) * 255.0f, 0.0f, 255.0f);
+                pixel[0] = (uint8_t)c.r;
+                pixel[1] = (uint8_t)c.g;
+                pixel[2] = (uint8_t)c.b;
+                break;
+            }
+            }
+        }
+
+        /**
+        *   @brief Reads a pixel and converts it to floating-point.
+        *   @param[in] x: X-coordinate of the pixel.
+        *   @param[in] y: Y-coordinate of the pixel.
+        *   @return RGBA color of the pixel, the alpha channel is 1 for 3 channel formats.
+        */
+        inline glm::vec4 load(uint32_t x, uint32_t y) const noexcept
+        {
+            const uint8_t* pixel = this->map_rdonly() + this->combute_index({ x, y });
+            switch (this->create_info.format)
+            {
+            case RT_FORMAT_R32G32B32A32_SFLOAT:
+            {
+                float rgba[4];
+                memcpy(rgba, pixel, sizeof(rgba));
+                return glm::vec4(rgba[0], rgba[1], rgba[2], rgba[3]);
+            }
+            case RT_FORMAT_R16G16B16A16_SFLOAT:
+            {
+                uint16_t rgba[4];
+                memcpy(rgba, pixel, sizeof(rgba));
+                return glm::vec4(glm::unpackHalf1x16(rgba[0]), glm::unpackHalf1x16(rgba[1]), glm::unpackHalf1x16(rgba[2]), glm::unpackHalf1x16(rgba[3]));
+            }
+            default:
+                return glm::vec4(pixel[0] / 255.0f, pixel[1] / 255.0f, pixel[2] / 255.0f, 1.0f);
+            }
+        }
     };
-}
\ No newline at end of file
+}
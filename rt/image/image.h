@@ -31,24 +31,69 @@ namespace rt
     protected:
         alignas(16) ImageCreateInfo create_info; // needs 16-byte alignment for __m1288i to work as fast as possible
 
+        static constexpr uint32_t TILE_SIZE = 4;    // edge length of a tile of the tiled layout
+
+        // number of tiles that are needed to cover @param n pixels
+        static inline uint32_t tile_count(uint32_t n)
+        {
+            return (n + TILE_SIZE - 1) / TILE_SIZE;
+        }
+
         // 1D image coordianate to array index
-        static inline size_t image2array1D(uint32_t x)
+        static inline size_t image2array1D(uint32_t x, const ImageCreateInfo& ci)
         {
-            return x;
+            return (size_t)x * ci.channels;
         }
 
         // 2D image coordinate to array index
         static inline size_t image2array2D(uint32_t x, uint32_t y, const ImageCreateInfo& ci)
         {
+            if (ci.layout == RT_IMAGE_LAYOUT_TILED)
+            {
+                // the 16 pixels of a tile are in Morton-order, so that a 2x2 footprint is within 4 consecutive pixels
+                const size_t tile = (size_t)(y / TILE_SIZE) * tile_count(ci.width) + (x / TILE_SIZE);
+                const uint32_t pixel = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2);
+                return (tile * TILE_SIZE * TILE_SIZE + pixel) * ci.channels;
+            }
             return (y * ci.width + x) * ci.channels;
         }
 
         // 3D image coordinate to array index
         static inline size_t image2array3D(uint32_t x, uint32_t y, uint32_t z, const ImageCreateInfo& ci)
         {
+            if (ci.layout == RT_IMAGE_LAYOUT_TILED)
+            {
+                // the 64 pixels of a tile are in Morton-order
+                const size_t tile = ((size_t)(z / TILE_SIZE) * tile_count(ci.height) + (y / TILE_SIZE)) * tile_count(ci.width) + (x / TILE_SIZE);
+                const uint32_t pixel = (x & 1) | ((y & 1) << 1) | ((z & 1) << 2) | ((x & 2) << 2) | ((y & 2) << 3) | ((z & 2) << 4);
+                return (tile * TILE_SIZE * TILE_SIZE * TILE_SIZE + pixel) * ci.channels;
+            }
             return (z * ci.width * ci.height + y * ci.width + x) * ci.channels;
         }
 
+        // number of elements of the array of an image, the tiled layout is padded to whole tiles
+        static inline size_t storage_count(const ImageCreateInfo& ci)
+        {
+            if (dimmensions == 1)
+                return (size_t)ci.width * ci.channels;
+            if (ci.layout == RT_IMAGE_LAYOUT_TILED)
+            {
+                size_t n = (size_t)tile_count(ci.width) * tile_count(ci.height) * TILE_SIZE * TILE_SIZE * ci.channels;
+                return (dimmensions == 3) ? n * tile_count(ci.depth) * TILE_SIZE : n;
+            }
+            size_t n = (size_t)ci.width * ci.height * ci.channels;
+            return (dimmensions == 3) ? n * ci.depth : n;
+        }
+
+        // replaces RT_IMAGE_LAYOUT_AUTO by the layout that is used, plain images are linear unless the tiled layout is requested
+        static inline ImageCreateInfo resolve_layout(const ImageCreateInfo& ci)
+        {
+            ImageCreateInfo _ci = ci;
+            if (_ci.layout == RT_IMAGE_LAYOUT_AUTO || dimmensions == 1)
+                _ci.layout = RT_IMAGE_LAYOUT_LINEAR;    // 1D images gain nothing from tiles
+            return _ci;
+        }
+
     public:
 
         /**
@@ -66,7 +111,7 @@ namespace rt
         */
         explicit Image(const ImageCreateInfo& ci) noexcept
         {
-            this->create_info = ci;
+            this->create_info = resolve_layout(ci);
             this->data = nullptr;
         }
 
@@ -80,11 +125,12 @@ namespace rt
 
         /**
         *   @brief Sets the create info for the image.
+        *   RT_IMAGE_LAYOUT_AUTO is replaced by RT_IMAGE_LAYOUT_LINEAR, only textures choose the tiled layout automatically.
         *   @param[in] ci: ImageCreateInfo struct
         */
         void set_create_info(const ImageCreateInfo& ci) noexcept
         {
-            this->create_info = ci;
+            this->create_info = resolve_layout(ci);
         }
 
         /**
@@ -95,18 +141,7 @@ namespace rt
         {
             if (this->data == nullptr)
             {
-                switch (dimmensions)
-                {
-                case 1:
-                    this->data = (T*)malloc(sizeof(T) * this->create_info.channels * this->create_info.width);
-                    break;
-                case 2:
-                    this->data = (T*)malloc(sizeof(T) * this->create_info.channels * this->create_info.width * this->create_info.height);
-                    break;
-                case 3:
-                    this->data = (T*)malloc(sizeof(T) * this->create_info.channels * this->create_info.width * this->create_info.height * this->create_info.depth);
-                    break;
-                }
+                this->data = (T*)malloc(sizeof(T) * storage_count(this->create_info));
                 if (this->data == nullptr)
                     return RT_IMAGE_ERROR_OUT_OF_MEMORY;
             }
@@ -137,7 +172,7 @@ namespace rt
                 return RT_IMAGE_ERROR_NULL;
 
             size_t idx = this->combute_index(pos);
-            if (idx >= this->max_index())
+            if (idx >= storage_count(this->create_info))
                 return RT_IMAGE_ERROR_OUT_OF_RANGE;
 
             memcpy(this->data + idx, data, sizeof(T) * this->create_info.channels);
@@ -150,21 +185,21 @@ namespace rt
         *   @param[out] data: Pointer where the pixel data should be stored.
         *   @return Image error (RT_IMAGE_ERROR_NULL, RT_IMAGE_ERROR_OUT_OF_RANGE, RT_IMAGE_ERROR_NONE)
         */
-        void read_pixel(const glm::vec<dimmensions, uint32_t, glm::defaultp>& pos, T* data) const noexcept
+        ImageError read_pixel(const glm::vec<dimmensions, uint32_t, glm::defaultp>& pos, T* data) const noexcept
         {
             if (data == nullptr)
                 return RT_IMAGE_ERROR_NULL;
 
             size_t idx = this->combute_index(pos);
-            if (idx >= this->max_index(pos))
+            if (idx >= storage_count(this->create_info))
                 return RT_IMAGE_ERROR_OUT_OF_RANGE;
 
-            memcpy(data, this->data + this->combute_index(pos), sizeof(T) * this->create_info.channels);
+            memcpy(data, this->data + idx, sizeof(T) * this->create_info.channels);
             return RT_IMAGE_ERROR_NONE;
         }
 
         /**
-        *   @brief Converts a XYZ-position to an array index.
+        *   @brief Converts a XYZ-position to an array index, depending on the layout of the image.
         *   @param img_pos: Image XYZ-position.
         *   @return Array index.
         */
@@ -173,7 +208,7 @@ namespace rt
             uint32_t* p = (uint32_t*)&img_pos;
             switch (dimmensions)
             {
-            case 1: return image2array1D(p[0]);
+            case 1: return image2array1D(p[0], this->create_info);
             case 2: return image2array2D(p[0], p[1], this->create_info);
             case 3: return image2array3D(p[0], p[1], p[2], this->create_info);
             }
@@ -211,11 +246,11 @@ namespace rt
         }
 
         /**
-        *   @return The size in bytes of the image.
+        *   @return The size in bytes of the image, including the padding of the tiled layout.
         */
         inline size_t size(void) const noexcept
         {
-            return sizeof(T) * this->create_info.channels * this->count();
+            return sizeof(T) * storage_count(this->create_info);
         }
 
         /**
@@ -249,6 +284,14 @@ namespace rt
         {
             return this->create_info.channels;
         }
+
+        /**
+        *   @return The order of the pixels in memory, RT_IMAGE_LAYOUT_LINEAR or RT_IMAGE_LAYOUT_TILED.
+        */
+        inline ImageLayout layout(void) const noexcept
+        {
+            return this->create_info.layout;
+        }
     };
 
     template<typename T> using Image1D = Image<T, 1>;
@@ -0,0 +1,67 @@
+/**
+* @file     image_writer.cpp
+* @brief    Implementation of the image writer.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "image_writer.h"
+#include <fstream>
+#include <vector>
+
+using namespace rt;
+
+ImageError ImageWriter::write_pfm(const Framebuffer& fbo, const std::string& path)
+{
+    if (fbo.map_rdonly() == nullptr)
+        return RT_IMAGE_ERROR_NULL;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return RT_IMAGE_ERROR_WRITE;
+
+    // a negative scale marks little-endian data
+    file << "PF\n" << fbo.width() << " " << fbo.height() << "\n-1.0\n";
+
+    // rows are stored from the bottom to the top
+    std::vector<float> row(3 * fbo.width());
+    for (uint32_t y = fbo.height(); y-- > 0;)
+    {
+        for (uint32_t x = 0; x < fbo.width(); x++)
+        {
+            const glm::vec4 color = fbo.load(x, y);
+            row[3 * x + 0] = color.r;
+            row[3 * x + 1] = color.g;
+            row[3 * x + 2] = color.b;
+        }
+        file.write((const char*)row.data(), row.size() * sizeof(float));
+    }
+    return file.good() ? RT_IMAGE_ERROR_NONE : RT_IMAGE_ERROR_WRITE;
+}
+
+ImageError ImageWriter::tonemap(const Framebuffer& fbo, float exposure, uint8_t* dst)
+{
+    if (fbo.map_rdonly() == nullptr || dst == nullptr)
+        return RT_IMAGE_ERROR_NULL;
+
+    const int32_t height = (int32_t)fbo.height();
+    #pragma omp parallel for
+    for (int32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < fbo.width(); x++)
+        {
+            const glm::vec3 hdr = glm::vec3(fbo.load(x, (uint32_t)y)) * exposure;
+            const glm::vec3 ldr = glm::clamp(hdr / (hdr + glm::vec3(1.0f)) * 255.0f, 0.0f, 255.0f);
+
+            uint8_t* pixel = dst + 3 * ((size_t)y * fbo.width() + x);
+            pixel[0] = (uint8_t)ldr.r;
+            pixel[1] = (uint8_t)ldr.g;
+            pixel[2] = (uint8_t)ldr.b;
+        }
+    }
+    return RT_IMAGE_ERROR_NONE;
+}
@@ -0,0 +1,41 @@
+/**
+* @file     image_writer.h
+* @brief    Writes the frame-buffer to disk and converts HDR frame-buffers to displayable images.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "framebuffer.h"
+#include <string>
+
+namespace rt
+{
+    namespace ImageWriter
+    {
+        /**
+        *   @brief Writes the frame-buffer into a portable float map (.pfm) without any loss of the HDR data.
+        *   The image is streamed row by row, no copy of the whole image is made.
+        *   The alpha channel is dropped, the file stores RGB.
+        *   @param[in] fbo: The frame-buffer to write.
+        *   @param[in] path: Path of the output file.
+        *   @return Image error (RT_IMAGE_ERROR_NULL, RT_IMAGE_ERROR_WRITE, RT_IMAGE_ERROR_NONE)
+        */
+        ImageError write_pfm(const Framebuffer& fbo, const std::string& path);
+
+        /**
+        *   @brief Tonemaps the frame-buffer with the Reinhard operator into a 8-bit RGB image.
+        *   The frame-buffer stays untouched, so the image can be re-exposed without tracing it again.
+        *   @param[in] fbo: The (HDR) frame-buffer.
+        *   @param[in] exposure: The colors are multiplied by the exposure before tonemapping.
+        *   @param[out] dst: RGB pixels, must be able to hold 3 * width * height bytes.
+        *   @return Image error (RT_IMAGE_ERROR_NULL, RT_IMAGE_ERROR_NONE)
+        */
+        ImageError tonemap(const Framebuffer& fbo, float exposure, uint8_t* dst);
+    }
+}
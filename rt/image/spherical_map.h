@@ -12,28 +12,498 @@
 #pragma once
 
 #include "texture.h"
+#include "environment_filter.h"
+#include <algorithm>
 
 namespace rt
 {
-    template<typename T_src, typename T_dst>
-    class SphericalMap : public Texture2D<T_src, T_dst>
+    template<typename T_src, typename T_dst, typename T_texel = T_dst>
+    class SphericalMap : public Texture2D<T_src, T_dst, T_texel>
     {
     private:
         using vec_ret = typename SphericalMap::vec_ret;
+
+        using texel_format = TexelFormat<T_texel>;
+
+        // a prefiltered level, its pixels are stored row after row
+        struct prefiltered_level_t
+        {
+            size_t offset;      // index of the first element of the level in prefiltered_texels
+            uint32_t width;
+            uint32_t height;
+        };
+
+        bool fast_math;     // approximate atan2 and asin with polynomials
+
+        std::vector<T_texel> prefiltered_texels;                // prefiltered levels, stored one after another
+        std::vector<prefiltered_level_t> prefiltered_levels;    // prefiltered level i + 1, level 0 is the map itself
+        SHIrradiance sh_irradiance;                             // irradiance of the map
+
+        std::vector<float> pixel_weights;       // luminance * sin(theta) of every pixel, stored row after row
+        std::vector<float> conditional_cdf;     // cdf of the pixels of every row, width + 1 values per row
+        std::vector<float> marginal_cdf;        // cdf of the rows, height + 1 values
+        float weight_sum;                       // sum of all pixel weights, 0 without a distribution
+        uint32_t distribution_width;
+        uint32_t distribution_height;
+
+        // fast approximation of atan2, the same polynomial as simd::atan2_fast()
+        static float atan2_fast(float y, float x) noexcept
+        {
+            const float ax = std::fabs(x), ay = std::fabs(y);
+            const float a = std::min(ax, ay) / std::max(std::max(ax, ay), 1e-30f);
+            const float z = a * a;
+            float p = a * ((((0.0208351f * z - 0.0851330f) * z + 0.1801410f) * z - 0.3302995f) * z + 0.9998660f);
+            if (ax < ay)    p = 1.57079633f - p;
+            if (x < 0.0f)   p = 3.14159265f - p;
+            return (y < 0.0f) ? -p : p;
+        }
+
+        // fast approximation of asin, the same polynomial as simd::asin_fast()
+        static float asin_fast(float x) noexcept
+        {
+            const float a = std::min(std::fabs(x), 1.0f);
+            const float p = 1.57079633f - std::sqrt(1.0f - a) * (((-0.0187293f * a + 0.0742610f) * a - 0.2121144f) * a + 1.5707288f);
+            return (x < 0.0f) ? -p : p;
+        }
+
+        // converts a direction to the uv-coordinate of the spherical map
+        glm::vec4 direction_to_uv(const glm::vec4& direction) const noexcept
+        {
+            constexpr static glm::vec2 inv_atan(0.1591f, 0.3183);
+            glm::vec2 uv;
+            if (this->fast_math)
+                uv = glm::vec2(atan2_fast(direction.x, direction.z), asin_fast(direction.y));
+            else
+                uv = glm::vec2(atan2(direction.x, direction.z), asin(direction.y));
+            uv = uv * inv_atan + 0.5f;
+            uv.y = 1.0f - uv.y;
+            return glm::vec4(uv.x, uv.y, 0.0f, 0.0f);
+        }
+
+        // converts simd::WIDTH directions to uv-coordinates at once, matches direction_to_uv() within float rounding
+        // (the precise mode uses the float polynomials of simd::atan2() / simd::asin() instead of std::atan2() / std::asin())
+        void direction_to_uv_simd(const float* x, const float* y, const float* z, float* u, float* v) const noexcept
+        {
+            const simd::vfloat _x = simd::load(x), _y = simd::load(y), _z = simd::load(z);
+            const simd::vfloat phi = this->fast_math ? simd::atan2_fast(_x, _z) : simd::atan2(_x, _z);
+            const simd::vfloat theta = this->fast_math ? simd::asin_fast(_y) : simd::asin(_y);
+            simd::store(u, simd::fmadd(phi, simd::set1(0.1591f), simd::set1(0.5f)));
+            simd::store(v, simd::sub(simd::set1(1.0f), simd::fmadd(theta, simd::set1(0.3183f), simd::set1(0.5f))));
+        }
+
+        // converts a uv-coordinate to the direction, the inverse of direction_to_uv()
+        static glm::vec3 uv_to_direction(float u, float v) noexcept
+        {
+            const float phi = (u - 0.5f) / 0.1591f;
+            const float theta = (0.5f - v) / 0.3183f;
+            return glm::vec3(std::cos(theta) * std::sin(phi), std::sin(theta), std::cos(theta) * std::cos(phi));
+        }
+
+        /**
+        *   @brief Moves a uv-coordinate by half a pixel of a mip level, so that the linear filter has the pixel centers at (i + 0.5) / size.
+        *   rt::Texture filters linear with the pixels at i / size, which shifts the coarse mip levels by large angles.
+        *   Every sample of the spherical map uses the centers at (i + 0.5) / size, the same as the prefiltered levels,
+        *   the nearest filter already selects the pixel that contains the uv-coordinate.
+        */
+        inline glm::vec4 center_uv(const glm::vec4& uv, uint32_t level) const noexcept
+        {
+            const ImageCreateInfo& ci = this->level_info(level);
+            return uv - glm::vec4(0.5f / ci.width, 0.5f / ci.height, 0.0f, 0.0f);
+        }
+
+        // samples a mip level linear with the pixel centers at (i + 0.5) / size
+        inline void sample_centered(const glm::vec4& uv, uint32_t level, vec_ret& color) const noexcept
+        {
+            this->_sample_level(this->center_uv(uv, level), level, true, color);
+        }
+
+        // samples a mip level with the filter of the map, linear filters have the pixel centers at (i + 0.5) / size
+        inline void sample_filtered(const glm::vec4& uv, uint32_t level, vec_ret& color) const noexcept
+        {
+            if (this->filter == RT_FILTER_NEAREST)
+                this->_sample_level(uv, level, false, color);
+            else
+                this->sample_centered(uv, level, color);
+        }
+
+        /** @brief Samples the mip levels at a level of detail, always with the trilinear filter. */
+        vec_ret sample_trilinear(const glm::vec3& direction, float lod) const noexcept
+        {
+            const glm::vec4 uv = this->direction_to_uv(glm::vec4(direction, 0.0f));
+            lod = glm::clamp(lod, 0.0f, static_cast<float>(this->mip_level_count() - 1));
+            const uint32_t level = static_cast<uint32_t>(lod);
+            const float t = lod - static_cast<float>(level);
+
+            vec_ret color;
+            this->sample_centered(uv, level, color);
+            if (t > 0.0f)
+            {
+                vec_ret color1;
+                this->sample_centered(uv, level + 1, color1);
+                color = glm::mix(color, color1, static_cast<T_dst>(t));
+            }
+            return color;
+        }
+
+        /**
+        *   @brief Samples a prefiltered level linear with the pixel centers at (i + 0.5) / size, level 0 is the map itself.
+        *   The prefiltered levels repeat in u-direction and are clamped to the edge in v-direction.
+        */
+        void sample_prefiltered_level(const glm::vec4& uv, uint32_t level, vec_ret& color) const noexcept
+        {
+            if (level == 0)
+            {
+                this->sample_centered(uv, 0, color);
+                return;
+            }
+
+            const prefiltered_level_t& l = this->prefiltered_levels[level - 1];
+            const float px = uv.x * static_cast<float>(l.width) - 0.5f;
+            const float py = uv.y * static_cast<float>(l.height) - 0.5f;
+            const float fx = std::floor(px), fy = std::floor(py);
+            const int32_t w = static_cast<int32_t>(l.width), h = static_cast<int32_t>(l.height);
+
+            int32_t x0 = static_cast<int32_t>(fx) % w;
+            if (x0 < 0) x0 += w;
+            const int32_t x1 = (x0 + 1 == w) ? 0 : x0 + 1;
+            const int32_t y0 = glm::clamp(static_cast<int32_t>(fy), 0, h - 1);
+            const int32_t y1 = glm::clamp(static_cast<int32_t>(fy) + 1, 0, h - 1);
+
+            const size_t elements = texel_format::elements(this->channel_count());
+            const T_texel* data = this->prefiltered_texels.data() + l.offset;
+            vec_ret c00, c10, c01, c11;
+            texel_format::decode(data + ((size_t)y0 * l.width + x0) * elements, this->channel_count(), (T_dst*)&c00);
+            texel_format::decode(data + ((size_t)y0 * l.width + x1) * elements, this->channel_count(), (T_dst*)&c10);
+            texel_format::decode(data + ((size_t)y1 * l.width + x0) * elements, this->channel_count(), (T_dst*)&c01);
+            texel_format::decode(data + ((size_t)y1 * l.width + x1) * elements, this->channel_count(), (T_dst*)&c11);
+
+            const T_dst tx = static_cast<T_dst>(px - fx);
+            const T_dst ty = static_cast<T_dst>(py - fy);
+            color = glm::mix(glm::mix(c00, c10, tx), glm::mix(c01, c11, tx), ty);
+        }
+
+        /** @brief Projects the base level onto spherical harmonics. */
+        void combute_irradiance(void)
+        {
+            // every row is projected on its own and the projections are added afterwards
+            const uint32_t w = this->width(), h = this->height();
+            std::vector<SHIrradiance> row_sh(h);
+            const float du = 1.0f / static_cast<float>(w), dv = 1.0f / static_cast<float>(h);
+
+            #pragma omp parallel for
+            for (int32_t y = 0; y < static_cast<int32_t>(h); y++)
+            {
+                const float v = (y + 0.5f) * dv;
+                const float cos_theta = std::cos((0.5f - v) / 0.3183f);
+                const float solid_angle = (du / 0.1591f) * (dv / 0.3183f) * cos_theta;
+                for (uint32_t x = 0; x < w; x++)
+                {
+                    // the nearest pixel of the center of a pixel is the pixel itself
+                    const float u = (x + 0.5f) * du;
+                    vec_ret radiance;
+                    this->_sample_level(glm::vec4(u, v, 0.0f, 0.0f), 0, false, radiance);
+                    row_sh[y].add(uv_to_direction(u, v), glm::vec3(radiance), solid_angle);
+                }
+            }
+
+            this->sh_irradiance.clear();
+            for (uint32_t y = 0; y < h; y++)
+                this->sh_irradiance += row_sh[y];
+        }
+
+        /**
+        *   @brief Normalizes a discrete cdf to [0, 1], a cdf without weight becomes uniform.
+        *   @param[in, out] cdf: n + 1 running sums, starting with 0
+        *   @param[in] n: Number of cells.
+        */
+        static void normalize_cdf(float* cdf, uint32_t n) noexcept
+        {
+            const float sum = cdf[n];
+            for (uint32_t i = 1; i < n; i++)
+                cdf[i] = (sum > 0.0f) ? cdf[i] / sum : static_cast<float>(i) / static_cast<float>(n);
+            cdf[n] = 1.0f;
+        }
+
+        /**
+        *   @brief Inverts a discrete cdf with a binary search.
+        *   @param[in] cdf: n + 1 increasing values from 0 to 1
+        *   @param[in] n: Number of cells.
+        *   @param[in] u: uniform random number in [0, 1)
+        *   @param[out] t: Position of @param u within the cell in [0, 1].
+        *   @return Index of the cell that contains @param u.
+        */
+        static uint32_t invert_cdf(const float* cdf, uint32_t n, float u, float& t) noexcept
+        {
+            const uint32_t i = static_cast<uint32_t>(std::upper_bound(cdf, cdf + n + 1, u) - cdf);
+            const uint32_t cell = glm::clamp(i, 1u, n) - 1;
+            const float width = cdf[cell + 1] - cdf[cell];
+            t = (width > 0.0f) ? glm::clamp((u - cdf[cell]) / width, 0.0f, 1.0f) : 0.0f;
+            return cell;
+        }
+
+        /**
+        *   @brief The pdf of a direction of the pixel (x, y) with respect to the solid angle.
+        *   It is the pdf in the uv-space divided by the area of a pixel on the sphere, which shrinks with sin(theta).
+        *   @param[in] v: v-coordinate of the direction
+        */
+        float pixel_pdf(uint32_t x, uint32_t y, float v) const noexcept
+        {
+            const float sin_theta = std::cos((0.5f - v) / 0.3183f);
+            if (sin_theta <= 0.0f) return 0.0f;
+            const float pixels = static_cast<float>(this->distribution_width) * static_cast<float>(this->distribution_height);
+            const float pdf_uv = this->pixel_weights[(size_t)y * this->distribution_width + x] * pixels / this->weight_sum;
+            return pdf_uv * (0.1591f * 0.3183f) / sin_theta;
+        }
+
     public:
         explicit SphericalMap(Filter filter = RT_FILTER_NEAREST, const vec_ret& border_color = vec_ret(0.0)) noexcept
-        : Texture2D<T_src, T_dst>(filter, border_color) {}
+        : Texture2D<T_src, T_dst, T_texel>(filter, border_color), fast_math(false), weight_sum(0.0f), distribution_width(0), distribution_height(0) {}
         virtual ~SphericalMap(void) {}
 
+        /**
+        *   @param[in] fast_math: True to approximate the conversion of directions to uv-coordinates with polynomials
+        *   instead of atan2 and asin (default false). The uv-coordinates are off by at most 2.5e-5, which is a
+        *   fraction of a pixel for maps up to 8192 x 4096 pixels.
+        */
+        void set_fast_math(bool fast_math) noexcept { this->fast_math = fast_math; }
+
+        /** @return True if the directions are converted with polynomial approximations. */
+        inline bool is_fast_math(void) const noexcept { return this->fast_math; }
+
+        /**
+        *   @brief Precomputes the lighting of the spherical map for image based lighting.
+        *   The irradiance is projected onto spherical harmonics (see sample_irradiance()). The prefiltered
+        *   level i is filtered with the GGX distribution of roughness i / (levels - 1) and has the size of
+        *   the mip level i (see sample_prefiltered()). Level 0 is the map itself.
+        *   The samples read the mip levels of the map, which makes a few dozen samples sufficient.
+        *   NOTE: The precomputation must be repeated if the map is loaded again.
+        *   @param[in] levels: Number of prefiltered levels, including level 0.
+        *   @param[in] samples: Number of samples per pixel of the prefiltered levels.
+        *   @return RT_IMAGE_ERROR_NULL if the map is not loaded.
+        */
+        ImageError prefilter(uint32_t levels = 6, uint32_t samples = 64)
+        {
+            if (this->map_rdonly() == nullptr) return RT_IMAGE_ERROR_NULL;
+            if (levels == 0 || samples == 0) return RT_IMAGE_ERROR_ZERO_SIZE;
+
+            this->combute_irradiance();
+
+            this->prefiltered_levels.clear();
+            const size_t elements = texel_format::elements(this->channel_count());
+            size_t offset = 0;
+            uint32_t w = this->width(), h = this->height();
+            for (uint32_t i = 1; i < levels; i++)
+            {
+                w = std::max(w / 2, 1u);
+                h = std::max(h / 2, 1u);
+                this->prefiltered_levels.push_back({ offset, w, h });
+                offset += (size_t)w * h * elements;
+            }
+            this->prefiltered_texels.assign(offset, T_texel());
+
+            const float texel_solid_angle = 4.0f * 3.14159265f / (static_cast<float>(this->width()) * static_cast<float>(this->height()));
+            for (uint32_t i = 1; i < levels; i++)
+            {
+                const prefiltered_level_t& l = this->prefiltered_levels[i - 1];
+                const float roughness = static_cast<float>(i) / static_cast<float>(levels - 1);
+
+                #pragma omp parallel for
+                for (int32_t y = 0; y < static_cast<int32_t>(l.height); y++)
+                {
+                    for (uint32_t x = 0; x < l.width; x++)
+                    {
+                        const glm::vec3 n = uv_to_direction((x + 0.5f) / l.width, (y + 0.5f) / l.height);
+                        const vec_ret color = EnvironmentFilter::ggx(n, roughness, samples, texel_solid_angle,
+                            [this](const glm::vec3& direction, float lod) { return this->sample_trilinear(direction, lod); });
+                        texel_format::encode((const T_dst*)&color, this->channel_count(), this->prefiltered_texels.data() + l.offset + ((size_t)y * l.width + x) * elements);
+                    }
+                }
+            }
+            return RT_IMAGE_ERROR_NONE;
+        }
+
+        /**
+        *   @brief Samples the glossy reflection of the environment, the two closest prefiltered levels are blended.
+        *   Without prefilter() the map is sampled linear and the roughness is ignored.
+        *   @param[in] direction: Direction of the reflection.
+        *   @param[in] roughness: Perceptual roughness of the surface in [0, 1].
+        *   @return Color of the sample.
+        */
+        vec_ret sample_prefiltered(const glm::vec4& direction, float roughness) const
+        {
+            const glm::vec4 uv = this->direction_to_uv(direction);
+            roughness = (roughness > 0.0f) ? glm::min(roughness, 1.0f) : 0.0f;
+            const float lod = roughness * static_cast<float>(this->prefiltered_levels.size());
+            const uint32_t level = static_cast<uint32_t>(lod);
+            const float t = lod - static_cast<float>(level);
+
+            vec_ret color;
+            this->sample_prefiltered_level(uv, level, color);
+            if (t > 0.0f)
+            {
+                vec_ret color1;
+                this->sample_prefiltered_level(uv, level + 1, color1);
+                color = glm::mix(color, color1, static_cast<T_dst>(t));
+            }
+            return color;
+        }
+
+        /**
+        *   @param[in] normal: normalized surface normal
+        *   @return The radiance a white diffuse surface reflects, 0 without prefilter().
+        */
+        inline glm::vec3 sample_irradiance(const glm::vec3& normal) const noexcept
+        {
+            return this->sh_irradiance.irradiance(normal);
+        }
+
+        /**
+        *   @brief Builds the distribution to importance sample the map (see sample_direction()).
+        *   Every pixel is weighted with its luminance and with sin(theta), the solid angle it covers on the sphere.
+        *   A direction is drawn by selecting a row with the marginal cdf of the rows and a pixel of that
+        *   row with the conditional cdf of its pixels, both are inverted with a binary search.
+        *   NOTE: The distribution must be built again if the map is loaded again.
+        *   @return RT_IMAGE_ERROR_NULL if the map is not loaded.
+        */
+        ImageError build_distribution(void)
+        {
+            if (this->map_rdonly() == nullptr) return RT_IMAGE_ERROR_NULL;
+
+            const uint32_t w = this->width(), h = this->height();
+            this->pixel_weights.resize((size_t)w * h);
+            this->conditional_cdf.resize((size_t)(w + 1) * h);
+            this->marginal_cdf.resize(h + 1);
+
+            #pragma omp parallel for
+            for (int32_t y = 0; y < static_cast<int32_t>(h); y++)
+            {
+                const float v = (y + 0.5f) / static_cast<float>(h);
+                const float sin_theta = std::max(std::cos((0.5f - v) / 0.3183f), 0.0f);
+                float* weights = this->pixel_weights.data() + (size_t)y * w;
+                float* cdf = this->conditional_cdf.data() + (size_t)y * (w + 1);
+
+                cdf[0] = 0.0f;
+                for (uint32_t x = 0; x < w; x++)
+                {
+                    vec_ret color;
+                    this->_sample_level(glm::vec4((x + 0.5f) / static_cast<float>(w), v, 0.0f, 0.0f), 0, false, color);
+                    const float luminance = (this->channel_count() >= 3)
+                        ? 0.2126f * static_cast<float>(color.r) + 0.7152f * static_cast<float>(color.g) + 0.0722f * static_cast<float>(color.b)
+                        : static_cast<float>(color.r);
+                    weights[x] = std::max(luminance, 0.0f) * sin_theta;
+                    cdf[x + 1] = cdf[x] + weights[x];
+                }
+            }
+
+            // the weight of a row is the last value of its cdf, which is needed before the rows are normalized
+            this->marginal_cdf[0] = 0.0f;
+            for (uint32_t y = 0; y < h; y++)
+                this->marginal_cdf[y + 1] = this->marginal_cdf[y] + this->conditional_cdf[(size_t)y * (w + 1) + w];
+            for (uint32_t y = 0; y < h; y++)
+                normalize_cdf(this->conditional_cdf.data() + (size_t)y * (w + 1), w);
+
+            this->weight_sum = this->marginal_cdf[h];
+            normalize_cdf(this->marginal_cdf.data(), h);
+            this->distribution_width = w;
+            this->distribution_height = h;
+            return RT_IMAGE_ERROR_NONE;
+        }
+
+        /**
+        *   @brief Draws a direction with a probability proportional to the radiance of the map.
+        *   Without build_distribution() or for a black map the directions are uniform on the sphere.
+        *   @param[in] u1, u2: uniform random numbers in [0, 1)
+        *   @param[out] out_pdf: The pdf of the direction with respect to the solid angle, the same as pdf(direction).
+        *   @return normalized direction
+        */
+        glm::vec4 sample_direction(float u1, float u2, float* out_pdf) const noexcept
+        {
+            if (this->weight_sum <= 0.0f)
+            {
+                const float y = 1.0f - 2.0f * u1;
+                const float r = std::sqrt(std::max(1.0f - y * y, 0.0f));
+                const float phi = 6.28318531f * u2;
+                if (out_pdf != nullptr) *out_pdf = 1.0f / (4.0f * 3.14159265f);
+                return glm::vec4(r * std::sin(phi), y, r * std::cos(phi), 0.0f);
+            }
+
+            float tu, tv;
+            const uint32_t y = invert_cdf(this->marginal_cdf.data(), this->distribution_height, u1, tv);
+            const uint32_t x = invert_cdf(this->conditional_cdf.data() + (size_t)y * (this->distribution_width + 1), this->distribution_width, u2, tu);
+            const float u = (x + tu) / static_cast<float>(this->distribution_width);
+            const float v = (y + tv) / static_cast<float>(this->distribution_height);
+
+            if (out_pdf != nullptr) *out_pdf = this->pixel_pdf(x, y, v);
+            return glm::vec4(uv_to_direction(u, v), 0.0f);
+        }
+
+        /**
+        *   @param[in] direction: normalized direction
+        *   @return The pdf of sample_direction() to draw @param direction, with respect to the solid angle.
+        */
+        float pdf(const glm::vec4& direction) const noexcept
+        {
+            if (this->weight_sum <= 0.0f) return 1.0f / (4.0f * 3.14159265f);
+
+            const glm::vec4 uv = this->direction_to_uv(direction);
+            const int32_t x = glm::clamp(static_cast<int32_t>(uv.x * this->distribution_width), 0, static_cast<int32_t>(this->distribution_width) - 1);
+            const int32_t y = glm::clamp(static_cast<int32_t>(uv.y * this->distribution_height), 0, static_cast<int32_t>(this->distribution_height) - 1);
+            return this->pixel_pdf(x, y, uv.y);
+        }
+
         virtual vec_ret sample(const glm::vec4& direction) const
         {
-            constexpr static glm::vec2 inv_atan(0.1591f, 0.3183);
-            glm::vec2 uv(atan2(direction.x, direction.z), asin(direction.y));
-            uv = uv * inv_atan + 0.5f;
-            uv.y = 1.0f - uv.y;
+            vec_ret color;
+            this->sample_filtered(direction_to_uv(direction), 0, color);
+            return color;
+        }
+
+        /**
+        *   @brief Samples the spherical map in many directions with one call, matches sample(direction) for every direction
+        *   within float rounding of the uv-coordinates (about 2 ulp of the angles, see direction_to_uv_simd()).
+        *   The directions are converted to uv-coordinates simd::WIDTH at once and sampled with the batched
+        *   texture kernel (see rt::Texture::sample_n()).
+        *   @param[in] directions: sample directions
+        *   @param[out] out: Colors of the samples.
+        *   @param[in] n: Number of samples.
+        */
+        virtual void sample_n(const glm::vec4* directions, vec_ret* out, size_t n) const
+        {
+            alignas(32) float x[simd::WIDTH], y[simd::WIDTH], z[simd::WIDTH], u[simd::WIDTH], v[simd::WIDTH];
+            glm::vec4 uv[simd::WIDTH];
+            const glm::vec4 center = (this->filter == RT_FILTER_NEAREST) ? glm::vec4(0.0f) : this->center_uv(glm::vec4(0.0f), 0);
+            for (size_t first = 0; first < n; first += simd::WIDTH)
+            {
+                // the lanes after the last direction repeat the last direction
+                const size_t m = std::min<size_t>(simd::WIDTH, n - first);
+                for (size_t i = 0; i < simd::WIDTH; i++)
+                {
+                    const glm::vec4& direction = directions[first + std::min(i, m - 1)];
+                    x[i] = direction.x;
+                    y[i] = direction.y;
+                    z[i] = direction.z;
+                }
+                direction_to_uv_simd(x, y, z, u, v);
+                for (size_t i = 0; i < m; i++)
+                    uv[i] = glm::vec4(u[i], v[i], 0.0f, 0.0f) + center;     // the same pixel centers as sample()
+                this->_sample_n(uv, out + first, m);
+            }
+        }
+
+        /**
+        *   @brief Samples the spherical map at a level of detail (e.g. for glossy reflections).
+        *   @param[in] direction: sample direction
+        *   @param[in] lod: Level of detail, 0 is the base level.
+        *   @return Color of the sample.
+        */
+        virtual vec_ret sample(const glm::vec4& direction, float lod) const
+        {
+            if (this->filter == RT_FILTER_TRILINEAR)
+                return this->sample_trilinear(glm::vec3(direction), lod);
 
             vec_ret color;
-            this->_sample(glm::vec4(uv.x, uv.y, 0.0f, 0.0f), color);
+            lod = glm::clamp(lod, 0.0f, static_cast<float>(this->mip_level_count() - 1));
+            this->sample_filtered(direction_to_uv(direction), static_cast<uint32_t>(lod + 0.5f), color);
             return color;
         }
     };
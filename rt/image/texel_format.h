@@ -0,0 +1,189 @@
+/**
+* @file     texel_format.h
+* @brief    Storage formats of the texels of a texture.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <immintrin.h>
+
+namespace rt
+{
+    /** 16-bit floating-point number, the storage type of half-float textures. */
+    struct half_t
+    {
+        uint16_t bits;
+    };
+
+    /**
+     *  Shared exponent RGB, the storage type of compact HDR textures.
+     *  The three channels have a 9-bit mantissa each and share a 5-bit exponent, a texel needs 32 bits.
+     */
+    struct rgb9e5_t
+    {
+        uint32_t bits;
+    };
+
+    /**
+    *   Converts the texels of a texture from and to their storage type (the last template parameter of rt::Texture):
+    *   float, double:  The channels are stored as they are (default).
+    *   uint8_t:        8-bit normalized channels (UNORM8), the values are clamped to [0, 1].
+    *   rt::half_t:     16-bit floating-point channels.
+    *   rt::rgb9e5_t:   Shared exponent RGB, up to 3 channels in one 32-bit element, negative values are clamped to 0.
+    *   Every format defines:
+    *   MAX_CHANNELS:   The maximum number of color channels a texel can have.
+    *   elements():     The number of elements of the storage type that are needed for one texel.
+    *   encode():       Converts the channels of a texel to the storage type.
+    *   decode():       Converts a texel to 4 channels, the channels the texel does not have are 0.
+    */
+    template<typename T_texel>
+    struct TexelFormat
+    {
+        static_assert(std::is_floating_point<T_texel>::value, "[Ray-Tracer | TexelFormat]: Unsupported texel storage type.");
+
+        static constexpr uint32_t MAX_CHANNELS = 4;
+
+        static constexpr uint32_t elements(uint32_t channels) noexcept
+        {
+            return channels;
+        }
+
+        template<typename T_dst>
+        static void encode(const T_dst* color, uint32_t channels, T_texel* texel) noexcept
+        {
+            for (uint32_t i = 0; i < channels; i++)
+                texel[i] = static_cast<T_texel>(color[i]);
+        }
+
+        template<typename T_dst>
+        static void decode(const T_texel* texel, uint32_t channels, T_dst* color) noexcept
+        {
+            for (uint32_t i = 0; i < 4; i++)
+                color[i] = (i < channels) ? static_cast<T_dst>(texel[i]) : static_cast<T_dst>(0);
+        }
+    };
+
+    template<>
+    struct TexelFormat<uint8_t>
+    {
+        static constexpr uint32_t MAX_CHANNELS = 4;
+
+        static constexpr uint32_t elements(uint32_t channels) noexcept
+        {
+            return channels;
+        }
+
+        template<typename T_dst>
+        static void encode(const T_dst* color, uint32_t channels, uint8_t* texel) noexcept
+        {
+            for (uint32_t i = 0; i < channels; i++)
+                texel[i] = static_cast<uint8_t>(glm::clamp(color[i], static_cast<T_dst>(0), static_cast<T_dst>(1)) * static_cast<T_dst>(255) + static_cast<T_dst>(0.5));
+        }
+
+        template<typename T_dst>
+        static void decode(const uint8_t* texel, uint32_t channels, T_dst* color) noexcept
+        {
+            for (uint32_t i = 0; i < 4; i++)
+                color[i] = (i < channels) ? static_cast<T_dst>(texel[i]) / static_cast<T_dst>(255) : static_cast<T_dst>(0);
+        }
+
+        static void decode(const uint8_t* texel, uint32_t channels, float* color) noexcept
+        {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+            // the missing channels stay 0, the 4 bytes are widened to 4 integers and normalized at once
+            int32_t bytes = 0;
+            memcpy(&bytes, texel, channels);
+            const __m128 c = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+            _mm_storeu_ps(color, _mm_mul_ps(c, _mm_set1_ps(1.0f / 255.0f)));
+#else
+            decode<float>(texel, channels, color);
+#endif
+        }
+    };
+
+    template<>
+    struct TexelFormat<half_t>
+    {
+        static constexpr uint32_t MAX_CHANNELS = 4;
+
+        static constexpr uint32_t elements(uint32_t channels) noexcept
+        {
+            return channels;
+        }
+
+        template<typename T_dst>
+        static void encode(const T_dst* color, uint32_t channels, half_t* texel) noexcept
+        {
+            for (uint32_t i = 0; i < channels; i++)
+                texel[i].bits = glm::packHalf1x16(static_cast<float>(color[i]));
+        }
+
+        template<typename T_dst>
+        static void decode(const half_t* texel, uint32_t channels, T_dst* color) noexcept
+        {
+            for (uint32_t i = 0; i < 4; i++)
+                color[i] = (i < channels) ? static_cast<T_dst>(glm::unpackHalf1x16(texel[i].bits)) : static_cast<T_dst>(0);
+        }
+
+        static void decode(const half_t* texel, uint32_t channels, float* color) noexcept
+        {
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+            // the missing channels stay 0 (the half-float 0 has all bits cleared), all 4 channels are converted at once
+            uint64_t bits = 0;
+            memcpy(&bits, texel, channels * sizeof(half_t));
+            _mm_storeu_ps(color, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)&bits)));
+#else
+            decode<float>(texel, channels, color);
+#endif
+        }
+    };
+
+    template<>
+    struct TexelFormat<rgb9e5_t>
+    {
+        static constexpr uint32_t MAX_CHANNELS = 3;
+
+        static constexpr uint32_t elements(uint32_t channels) noexcept
+        {
+            return 1;
+        }
+
+        template<typename T_dst>
+        static void encode(const T_dst* color, uint32_t channels, rgb9e5_t* texel) noexcept
+        {
+            const glm::vec3 rgb(
+                static_cast<float>(color[0]),
+                (channels > 1) ? static_cast<float>(color[1]) : 0.0f,
+                (channels > 2) ? static_cast<float>(color[2]) : 0.0f
+            );
+            texel->bits = glm::packF3x9_E1x5(rgb);
+        }
+
+        template<typename T_dst>
+        static void decode(const rgb9e5_t* texel, uint32_t channels, T_dst* color) noexcept
+        {
+            // value = mantissa * 2^(exponent - 15 - 9), the scale is built directly as float:
+            // its biased exponent is (exponent - 24 + 127), which is always a normal float
+            const uint32_t bits = texel->bits;
+            const uint32_t scale_bits = ((bits >> 27) + 103) << 23;
+            float scale;
+            memcpy(&scale, &scale_bits, sizeof(float));
+
+            color[0] = static_cast<T_dst>(static_cast<float>(bits & 0x1FF) * scale);
+            color[1] = (channels > 1) ? static_cast<T_dst>(static_cast<float>((bits >> 9) & 0x1FF) * scale) : static_cast<T_dst>(0);
+            color[2] = (channels > 2) ? static_cast<T_dst>(static_cast<float>((bits >> 18) & 0x1FF) * scale) : static_cast<T_dst>(0);
+            color[3] = static_cast<T_dst>(0);
+        }
+    };
+}
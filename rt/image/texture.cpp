@@ -13,7 +13,8 @@
 
 using namespace rt;
 
-ImageError TextureLoader::load(Texture2D<uint8_t, float>& tex, const std::string& path, uint32_t force_channels)
+template<typename T_texel>
+ImageError TextureLoader::load(Texture2D<uint8_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels)
 {
     int w, h, c;
     uint8_t* data = stbi_load(path.c_str(), &w, &h, &c, force_channels);
@@ -25,13 +26,12 @@ ImageError TextureLoader::load(Texture2D<uint8_t, float>& tex, const std::string
     image_ci.channels = (force_channels == 0) ? (uint32_t)c : force_channels;
 
     ImageError error = tex.load(image_ci, data);
-    if (error != RT_IMAGE_ERROR_NONE) return error;
-
-    stbi_image_free(data);
-    return RT_IMAGE_ERROR_NONE;
+    stbi_image_free(data);  // the texture has copied the image
+    return error;
 }
 
-ImageError TextureLoader::load16(Texture2D<uint16_t, float>& tex, const std::string& path, uint32_t force_channels)
+template<typename T_texel>
+ImageError TextureLoader::load16(Texture2D<uint16_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels)
 {
     int w, h, c;
     uint16_t* data = stbi_load_16(path.c_str(), &w, &h, &c, force_channels);
@@ -43,13 +43,12 @@ ImageError TextureLoader::load16(Texture2D<uint16_t, float>& tex, const std::str
     image_ci.channels = (force_channels == 0) ? (uint32_t)c : force_channels;
 
     ImageError error = tex.load(image_ci, data);
-    if (error != RT_IMAGE_ERROR_NONE) return error;
-
-    stbi_image_free(data);
-    return RT_IMAGE_ERROR_NONE;
+    stbi_image_free(data);  // the texture has copied the image
+    return error;
 }
 
-ImageError TextureLoader::loadf(Texture2D<float, float>& tex, const std::string& path, uint32_t force_channels)
+template<typename T_texel>
+ImageError TextureLoader::loadf(Texture2D<float, float, T_texel>& tex, const std::string& path, uint32_t force_channels)
 {
     int w, h, c;
     float* data = stbi_loadf(path.c_str(), &w, &h, &c, force_channels);
@@ -61,8 +60,55 @@ ImageError TextureLoader::loadf(Texture2D<float, float>& tex, const std::string&
     image_ci.channels = (force_channels == 0) ? (uint32_t)c : force_channels;
 
     ImageError error = tex.load(image_ci, data);
-    if (error != RT_IMAGE_ERROR_NONE) return error;
+    stbi_image_free(data);  // the texture has copied the image
+    return error;
+}
+
+template<typename T_texel>
+std::future<ImageError> TextureLoader::load_async(Texture2D<uint8_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels)
+{
+    return std::async(std::launch::async, [&tex, path, force_channels]() { return TextureLoader::load(tex, path, force_channels); });
+}
+
+template<typename T_texel>
+std::future<ImageError> TextureLoader::load16_async(Texture2D<uint16_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels)
+{
+    return std::async(std::launch::async, [&tex, path, force_channels]() { return TextureLoader::load16(tex, path, force_channels); });
+}
+
+template<typename T_texel>
+std::future<ImageError> TextureLoader::loadf_async(Texture2D<float, float, T_texel>& tex, const std::string& path, uint32_t force_channels)
+{
+    return std::async(std::launch::async, [&tex, path, force_channels]() { return TextureLoader::loadf(tex, path, force_channels); });
+}
+
+// texel storage types the loaders are compiled for
+template ImageError TextureLoader::load<float>(Texture2D<uint8_t, float, float>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::load<uint8_t>(Texture2D<uint8_t, float, uint8_t>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::load<half_t>(Texture2D<uint8_t, float, half_t>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::load<rgb9e5_t>(Texture2D<uint8_t, float, rgb9e5_t>& tex, const std::string& path, uint32_t force_channels);
+
+template ImageError TextureLoader::load16<float>(Texture2D<uint16_t, float, float>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::load16<uint8_t>(Texture2D<uint16_t, float, uint8_t>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::load16<half_t>(Texture2D<uint16_t, float, half_t>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::load16<rgb9e5_t>(Texture2D<uint16_t, float, rgb9e5_t>& tex, const std::string& path, uint32_t force_channels);
+
+template ImageError TextureLoader::loadf<float>(Texture2D<float, float, float>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::loadf<uint8_t>(Texture2D<float, float, uint8_t>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::loadf<half_t>(Texture2D<float, float, half_t>& tex, const std::string& path, uint32_t force_channels);
+template ImageError TextureLoader::loadf<rgb9e5_t>(Texture2D<float, float, rgb9e5_t>& tex, const std::string& path, uint32_t force_channels);
+
+template std::future<ImageError> TextureLoader::load_async<float>(Texture2D<uint8_t, float, float>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_async<uint8_t>(Texture2D<uint8_t, float, uint8_t>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_async<half_t>(Texture2D<uint8_t, float, half_t>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load_async<rgb9e5_t>(Texture2D<uint8_t, float, rgb9e5_t>& tex, const std::string& path, uint32_t force_channels);
+
+template std::future<ImageError> TextureLoader::load16_async<float>(Texture2D<uint16_t, float, float>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load16_async<uint8_t>(Texture2D<uint16_t, float, uint8_t>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load16_async<half_t>(Texture2D<uint16_t, float, half_t>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::load16_async<rgb9e5_t>(Texture2D<uint16_t, float, rgb9e5_t>& tex, const std::string& path, uint32_t force_channels);
 
-    stbi_image_free(data);
-    return RT_IMAGE_ERROR_NONE;
-}
\ No newline at end of file
+template std::future<ImageError> TextureLoader::loadf_async<float>(Texture2D<float, float, float>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::loadf_async<uint8_t>(Texture2D<float, float, uint8_t>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::loadf_async<half_t>(Texture2D<float, float, half_t>& tex, const std::string& path, uint32_t force_channels);
+template std::future<ImageError> TextureLoader::loadf_async<rgb9e5_t>(Texture2D<float, float, rgb9e5_t>& tex, const std::string& path, uint32_t force_channels);
\ No newline at end of file
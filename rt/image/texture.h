@@ -12,7 +12,12 @@
 #pragma once
 
 #include "image.h"
+#include "texel_format.h"
+#include <cmath>
+#include <future>
+#include <string>
 #include <type_traits>
+#include <vector>
 #include <immintrin.h>
 
 #ifdef __clang__	// suppress waring "empty body" for clang for include file stb_image.h
@@ -26,8 +31,18 @@
 
 namespace rt
 {
-    template <typename T_src, typename T_dst, uint32_t dimmensions>
-    class Texture : public Image<T_dst, dimmensions>
+    template<typename T_texture, Filter filter, uint32_t channels, TextureAddressMode address_u, TextureAddressMode address_v, TextureAddressMode address_w>
+    class TextureSampler;
+
+    /**
+    *   A texture converts the source pixels to the floating-point destination-type and stores them in
+    *   the storage type T_texel, which is the destination-type by default. Compact storage types
+    *   (uint8_t, rt::half_t, rt::rgb9e5_t, see rt::TexelFormat) need less memory and cache and are
+    *   decoded to the destination-type when they are sampled.
+    *   NOTE: The channel count of the underlying image is the number of storage elements per texel.
+    */
+    template <typename T_src, typename T_dst, uint32_t dimmensions, typename T_texel = T_dst>
+    class Texture : public Image<T_texel, dimmensions>
     {
         enum type_t
         {
@@ -44,8 +59,13 @@ namespace rt
             RT_DOUBLE = 10
         };
 
+        // the sampler reads the mip levels directly
+        template<typename T_texture, Filter filter, uint32_t channels, TextureAddressMode address_u, TextureAddressMode address_v, TextureAddressMode address_w>
+        friend class TextureSampler;
+
     protected:
         using vec_ret = glm::vec<4, T_dst, glm::defaultp>;
+        using texel_format = TexelFormat<T_texel>;
 
     private:
         static constexpr type_t get_src_type(void) noexcept
@@ -97,103 +117,412 @@ namespace rt
             return static_cast<T_dst>(v) / static_cast<T_dst>(std::numeric_limits<T_src>::max());
         }
 
+        // a mip level, level 0 is the image itself and is not stored as mip level
+        struct mip_level_t
+        {
+            alignas(16) ImageCreateInfo info;   // size of the level, needs 16-byte alignment for combute_image_pos
+            size_t offset;                      // index of the first element of the level in mip_data
+        };
+
+        std::vector<mip_level_t> mip_levels;    // levels 1 to n
+        std::vector<T_texel> mip_data;          // texels of the levels 1 to n, stored one after another
+        bool mipmapped;                         // generate the mip levels when the texture is loaded
+        uint32_t channels;                      // number of color channels of a texel
+
+        /** @return Index of the first channel of the texel at @param pos of an image with the size of @param ci. */
+        static size_t texel_index(const glm::uvec4& pos, const ImageCreateInfo& ci) noexcept
+        {
+            switch (dimmensions)
+            {
+            case 1: return Texture::image2array1D(pos.x, ci);
+            case 2: return Texture::image2array2D(pos.x, pos.y, ci);
+            case 3: return Texture::image2array3D(pos.x, pos.y, pos.z, ci);
+            }
+            return 0;
+        }
+
+        /**
+        *   @brief Combutes a mip level with a box filter from the level above.
+        *   @param[in] level: The level to combute, must be greater than 0.
+        */
+        void downsample(uint32_t level) noexcept
+        {
+            const ImageCreateInfo& src_ci = this->level_info(level - 1);
+            const ImageCreateInfo& dst_ci = this->level_info(level);
+            const T_texel* src = this->level_data(level - 1);
+            T_texel* dst = this->mip_data.data() + this->mip_levels[level - 1].offset;
+
+            // every texel is the average of 2 (1D), 2x2 (2D) or 2x2x2 (3D) texels of the level above,
+            // the texels at the end of odd sized levels are clamped to the edge
+            const glm::uvec3 src_max(src_ci.width - 1, (dimmensions > 1) ? src_ci.height - 1 : 0, (dimmensions > 2) ? src_ci.depth - 1 : 0);
+            const glm::uvec3 dst_size(dst_ci.width, (dimmensions > 1) ? dst_ci.height : 1, (dimmensions > 2) ? dst_ci.depth : 1);
+            const glm::uvec3 n(2, (dimmensions > 1) ? 2 : 1, (dimmensions > 2) ? 2 : 1);
+            const T_dst weight = static_cast<T_dst>(1) / static_cast<T_dst>(n.x * n.y * n.z);
+
+            for (uint32_t z = 0; z < dst_size.z; z++)
+            {
+                for (uint32_t y = 0; y < dst_size.y; y++)
+                {
+                    for (uint32_t x = 0; x < dst_size.x; x++)
+                    {
+                        // the texels are averaged decoded and the result is encoded again
+                        vec_ret sum(static_cast<T_dst>(0));
+
+                        for (uint32_t k = 0; k < n.z; k++)
+                        {
+                            for (uint32_t j = 0; j < n.y; j++)
+                            {
+                                for (uint32_t i = 0; i < n.x; i++)
+                                {
+                                    const glm::uvec4 src_pos(glm::min(2 * x + i, src_max.x), glm::min(2 * y + j, src_max.y), glm::min(2 * z + k, src_max.z), 0);
+                                    vec_ret src_texel;
+                                    texel_format::decode(src + texel_index(src_pos, src_ci), this->channels, (T_dst*)&src_texel);
+                                    sum += weight * src_texel;
+                                }
+                            }
+                        }
+                        texel_format::encode((const T_dst*)&sum, this->channels, dst + texel_index(glm::uvec4(x, y, z, 0), dst_ci));
+                    }
+                }
+            }
+        }
+
         /**
         *   @brief Samples a single pixel from the texture without filter operations applied.
         *   @param[in] pos: pixel-coordinate
+        *   @param[in] level: mip level
         *   @param[out] color: color of the pixel
         */
-        void _sample_px(const glm::uvec4& pos, vec_ret& color) const noexcept
+        void _sample_px(const glm::ivec4& pos, uint32_t level, vec_ret& color) const noexcept
         {
+            const ImageCreateInfo& ci = this->level_info(level);
             glm::uvec4 _pos;
-            this->combute_address_mode(pos, _pos);
-            switch (dimmensions)
+            this->combute_address_mode(pos, ci, _pos);
+            if (_pos.x >= ci.width || (dimmensions > 1 && _pos.y >= ci.height) || (dimmensions > 2 && _pos.z >= ci.depth))
             {
-            case 1: if (_pos.x >= this->create_info.width) { color = this->border_color; return; }
-            case 2: if (_pos.x >= this->create_info.width || _pos.y >= this->create_info.height) { color = this->border_color; return; }
-            case 3: if (_pos.x >= this->create_info.width || _pos.y >= this->create_info.height || _pos.z >= this->create_info.depth) { color = this->border_color; return; }
+                color = this->border_color;
+                return;
             }
 
+            const T_texel* map = this->level_data(level);   // read-only accesss to the image data array of the level
+            const size_t idx = texel_index(_pos, ci);       // index to access the data array (base index of the pixel at the position @param[in] pos)
 
-            const T_dst* map = this->map_rdonly();      // read-only accesss to the image data array
-            T_dst* const c = (T_dst*)&color;            // the same, but in pointer form, because the numer of channels is not known
-            size_t idx = 0;                             // index to access the data array (base index of the pixel at the position @param[in] pos)
+            // the texel is decoded from its storage type, the channels it does not have are 0
+            texel_format::decode(map + idx, this->channels, (T_dst*)&color);
+        }
 
-            switch (dimmensions)
+        /**
+        *   @brief Combutes the address-mode for one dimmension.
+        *   @param[in] pos: x/y/z-pixel-coordinate, may be negative
+        *   @param[in] s: Size of the image in that dimmension.
+        *   @param[in] address_index: 0-indexed dimmension number
+        *   @return x/y/z-pixel-coordinate after address mode computation, @param s if the border is sampled.
+        */
+        uint32_t combute_address_mode_comp(int32_t pos, uint32_t s, size_t address_idx) const noexcept
+        {
+            const int32_t _s = static_cast<int32_t>(s);
+            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER) return (pos < 0 || pos >= _s) ? s : pos;
+            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_EDGE)   return glm::clamp(pos, 0, _s - 1);
+            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_REPEAT)
             {
-            case 1: idx = Texture::image2array1D(_pos.x); break;
-            case 2: idx = Texture::image2array2D(_pos.x, _pos.y, this->create_info); break;
-            case 3: idx = Texture::image2array3D(_pos.x, _pos.y, _pos.z, this->create_info); break;
+                const int32_t m = pos % _s;
+                return (m < 0) ? m + _s : m;
             }
+            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_MIRRORED_REPEAT)
+            {
+                // the image and its mirror image repeat with a period of 2 * s
+                int32_t m = pos % (2 * _s);
+                if (m < 0) m += 2 * _s;
+                return (m < _s) ? m : 2 * _s - 1 - m;
+            }
+            return 0;
+        }
 
-            // i is the channel index: access_index = pixel_base_index + channel_index
-            for (uint32_t i = 0; i < 4; i++)
-                c[i] = (i < this->create_info.channels) ? map[idx + i] : static_cast<T_dst>(0);
+#if defined(__AVX2__) || defined(__SSE4_1__)
+        // the linear filter kernel needs SSE4.1, without it the scalar path of _sample_level() is used
+        /** @return @param pos modulo @param s for 4 pixel-coordinates at once, the results are always positive. */
+        static inline __m128i mod_simd(__m128i pos, uint32_t s) noexcept
+        {
+            const __m128i _s = _mm_set1_epi32(static_cast<int32_t>(s));
+            if ((s & (s - 1)) == 0) return _mm_and_si128(pos, _mm_sub_epi32(_s, _mm_set1_epi32(1)));
+
+            // there is no integer division, the quotient is combuted with floats and the remainder is corrected,
+            // if the rounding of the division is off by one
+            const __m128 q = _mm_floor_ps(_mm_div_ps(_mm_cvtepi32_ps(pos), _mm_cvtepi32_ps(_s)));
+            __m128i m = _mm_sub_epi32(pos, _mm_mullo_epi32(_mm_cvttps_epi32(q), _s));
+            m = _mm_add_epi32(m, _mm_and_si128(_mm_cmplt_epi32(m, _mm_setzero_si128()), _s));
+            m = _mm_sub_epi32(m, _mm_andnot_si128(_mm_cmplt_epi32(m, _s), _s));
+            return m;
         }
 
         /**
-        *   @brief Combutes the address-mode for one dimmension.
-        *   @param[in] pos: x/y/z-pixel-coordinate
+        *   @brief Combutes the address-mode for one dimmension of 4 pixel-coordinates at once.
+        *   @param[in] pos: x/y/z-pixel-coordinates, may be negative
+        *   @param[in] s: Size of the image in that dimmension.
         *   @param[in] address_index: 0-indexed dimmension number
-        *   @return x/y/z-pixel-coordinate after address mode computation.
+        *   @param[in, out] border: The lanes that sample the border get set, their coordinate is clamped into the image.
+        *   @return x/y/z-pixel-coordinates after address mode computation.
         */
-        uint32_t combute_address_mode_comp(uint32_t pos, size_t address_idx) const noexcept
+        __m128i combute_address_mode_simd(__m128i pos, uint32_t s, size_t address_idx, __m128i& border) const noexcept
         {
-            const uint32_t* const cip = (uint32_t*)&this->create_info;
-            const uint32_t s = cip[address_idx];
+            const __m128i s_max = _mm_set1_epi32(static_cast<int32_t>(s) - 1);
+            switch (this->address_mode[address_idx])
+            {
+            case RT_TEXTURE_ADDRESS_MODE_REPEAT:
+                return mod_simd(pos, s);
+            case RT_TEXTURE_ADDRESS_MODE_MIRRORED_REPEAT:
+            {
+                const __m128i m = mod_simd(pos, 2 * s);
+                const __m128i mirrored = _mm_sub_epi32(_mm_set1_epi32(2 * static_cast<int32_t>(s) - 1), m);
+                return _mm_blendv_epi8(m, mirrored, _mm_cmpgt_epi32(m, s_max));
+            }
+            case RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER:
+                border = _mm_or_si128(border, _mm_or_si128(_mm_cmplt_epi32(pos, _mm_setzero_si128()), _mm_cmpgt_epi32(pos, s_max)));
+                return _mm_min_epi32(_mm_max_epi32(pos, _mm_setzero_si128()), s_max);
+            default:
+                return _mm_min_epi32(_mm_max_epi32(pos, _mm_setzero_si128()), s_max);
+            }
+        }
 
-            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER) return (pos >= s) ? s : pos;
-            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_EDGE)   return (pos >= s) ? s - 1 : pos;
-            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_REPEAT)          return pos % s;
-            if (this->address_mode[address_idx] == RT_TEXTURE_ADDRESS_MODE_MIRRORED_REPEAT) return (pos / s % 2 == 1) ? s - ((pos % s) + 1) : pos % s;
-            return 0;
+        /** @return Indices of the first channels of 4 texels at once, see texel_index(). */
+        static inline __m128i texel_index_simd(__m128i x, __m128i y, __m128i z, const ImageCreateInfo& ci) noexcept
+        {
+            const __m128i elements = _mm_set1_epi32(static_cast<int32_t>(ci.channels));
+            if (ci.layout == RT_IMAGE_LAYOUT_TILED)
+            {
+                const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+                __m128i tile = _mm_srli_epi32(y, 2);
+                if (dimmensions == 3)
+                    tile = _mm_add_epi32(_mm_mullo_epi32(_mm_srli_epi32(z, 2), _mm_set1_epi32(Texture::tile_count(ci.height))), tile);
+                tile = _mm_add_epi32(_mm_mullo_epi32(tile, _mm_set1_epi32(Texture::tile_count(ci.width))), _mm_srli_epi32(x, 2));
+
+                __m128i pixel;
+                if (dimmensions == 3)
+                {
+                    pixel = _mm_or_si128(_mm_or_si128(_mm_and_si128(x, one), _mm_slli_epi32(_mm_and_si128(y, one), 1)), _mm_slli_epi32(_mm_and_si128(z, one), 2));
+                    pixel = _mm_or_si128(pixel, _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, two), 2), _mm_slli_epi32(_mm_and_si128(y, two), 3)));
+                    pixel = _mm_or_si128(pixel, _mm_slli_epi32(_mm_and_si128(z, two), 4));
+                    tile = _mm_slli_epi32(tile, 6);     // 64 pixels per tile
+                }
+                else
+                {
+                    pixel = _mm_or_si128(_mm_and_si128(x, one), _mm_slli_epi32(_mm_and_si128(y, one), 1));
+                    pixel = _mm_or_si128(pixel, _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, two), 1), _mm_slli_epi32(_mm_and_si128(y, two), 2)));
+                    tile = _mm_slli_epi32(tile, 4);     // 16 pixels per tile
+                }
+                return _mm_mullo_epi32(_mm_add_epi32(tile, pixel), elements);
+            }
+
+            __m128i idx = y;
+            if (dimmensions == 3)
+                idx = _mm_add_epi32(_mm_mullo_epi32(z, _mm_set1_epi32(static_cast<int32_t>(ci.height))), y);
+            idx = _mm_add_epi32(_mm_mullo_epi32(idx, _mm_set1_epi32(static_cast<int32_t>(ci.width))), x);
+            return _mm_mullo_epi32(idx, elements);
+        }
+
+        // linear interpolation of 4 channels with the same formula as glm::mix
+        static inline __m128 mix_simd(__m128 a, __m128 b, __m128 t) noexcept
+        {
+            return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(1.0f), t)), _mm_mul_ps(b, t));
+        }
+
+        /**
+        *   @brief Linear filter for 2D and 3D textures with float as destination-type.
+        *   The addresses of the 4 (2D) or 8 (3D) texels of the footprint are combuted at once,
+        *   the texels are gathered and blended in SIMD registers.
+        *   @param[in] px_pos: floored pixel-coordinate
+        *   @param[in] t: Fractional part of the pixel-coordinate.
+        *   @param[in] level: mip level
+        *   @param[out] color: Color of the sample, 4 floats.
+        */
+        void _sample_linear_simd(const glm::ivec4& px_pos, const glm::vec4& t, uint32_t level, float* color) const noexcept
+        {
+            constexpr uint32_t n = (dimmensions == 3) ? 8 : 4;  // number of texels of the footprint
+            const ImageCreateInfo& ci = this->level_info(level);
+            const T_texel* map = this->level_data(level);
+
+            // texel i of the footprint has the offset (i & 1, (i >> 1) & 1, i >> 2)
+            alignas(16) int32_t idx[8];
+            uint32_t border_bits = 0;
+            __m128i border_xy = _mm_setzero_si128();
+            const __m128i x = this->combute_address_mode_simd(_mm_add_epi32(_mm_set1_epi32(px_pos.x), _mm_setr_epi32(0, 1, 0, 1)), ci.width, 0, border_xy);
+            const __m128i y = this->combute_address_mode_simd(_mm_add_epi32(_mm_set1_epi32(px_pos.y), _mm_setr_epi32(0, 0, 1, 1)), ci.height, 1, border_xy);
+            for (uint32_t i = 0; i < n / 4; i++)
+            {
+                __m128i border = border_xy;
+                const __m128i z = (dimmensions == 3) ? this->combute_address_mode_simd(_mm_set1_epi32(px_pos.z + i), ci.depth, 2, border) : _mm_setzero_si128();
+                _mm_store_si128((__m128i*)(idx + 4 * i), texel_index_simd(x, y, z, ci));
+                border_bits |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(border))) << (4 * i);
+            }
+
+            // gather and decode the texels, the texels outside of the image are replaced by the border color
+            const __m128 border_color = _mm_setr_ps(static_cast<float>(this->border_color.r), static_cast<float>(this->border_color.g),
+                                                    static_cast<float>(this->border_color.b), static_cast<float>(this->border_color.a));
+            __m128 c[8];
+            for (uint32_t i = 0; i < n; i++)
+            {
+                alignas(16) float texel[4];
+                texel_format::decode(map + idx[i], this->channels, texel);
+                c[i] = (border_bits & (1 << i)) ? border_color : _mm_load_ps(texel);
+            }
+
+            const __m128 tx = _mm_set1_ps(t.x);
+            const __m128 ty = _mm_set1_ps(t.y);
+            __m128 c0 = mix_simd(mix_simd(c[0], c[1], tx), mix_simd(c[2], c[3], tx), ty);
+            if (dimmensions == 3)
+            {
+                const __m128 c1 = mix_simd(mix_simd(c[4], c[5], tx), mix_simd(c[6], c[7], tx), ty);
+                c0 = mix_simd(c0, c1, _mm_set1_ps(t.z));
+            }
+            _mm_storeu_ps(color, c0);
         }
 
+        /**
+        *   @brief Samples the base level of 2D and 3D textures with float as destination-type at 4 uvw-coordinates at once.
+        *   The pixel-coordinates, the address modes and the texel indices of the 4 samples are combuted in SIMD registers,
+        *   only the texels are gathered and decoded one by one. The result is the same as _sample_level() for every coordinate.
+        *   @param[in] pos: 4 uvw-coordinates
+        *   @param[in] linear: True for linear filtering, otherwise the nearest pixel is sampled.
+        *   @param[out] color: Colors of the 4 samples, 16 floats.
+        */
+        void _sample4_simd(const glm::vec4* pos, bool linear, float* color) const noexcept
+        {
+            const uint32_t n = linear ? ((dimmensions == 3) ? 8 : 4) : 1;   // number of texels of the footprint
+            const ImageCreateInfo& ci = this->create_info;
+            const T_texel* map = this->map_rdonly();
+
+            // transpose the coordinates, every register holds one component of the 4 samples
+            __m128 u = _mm_loadu_ps((const float*)(pos + 0));
+            __m128 v = _mm_loadu_ps((const float*)(pos + 1));
+            __m128 w = _mm_loadu_ps((const float*)(pos + 2));
+            __m128 q = _mm_loadu_ps((const float*)(pos + 3));
+            _MM_TRANSPOSE4_PS(u, v, w, q);
+
+            // the same as combute_image_pos(), but for 4 coordinates at once
+            const __m128 px = _mm_mul_ps(u, _mm_cvtepi32_ps(_mm_set1_epi32(static_cast<int32_t>(ci.width))));
+            const __m128 py = _mm_mul_ps(v, _mm_cvtepi32_ps(_mm_set1_epi32(static_cast<int32_t>(ci.height))));
+            const __m128 pz = _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_set1_epi32(static_cast<int32_t>(ci.depth))));
+            const __m128 fx = _mm_floor_ps(px), fy = _mm_floor_ps(py), fz = _mm_floor_ps(pz);
+            const __m128i x0 = _mm_cvttps_epi32(fx), y0 = _mm_cvttps_epi32(fy), z0 = _mm_cvttps_epi32(fz);
+            alignas(16) float tx[4], ty[4], tz[4];
+            _mm_store_ps(tx, _mm_sub_ps(px, fx));
+            _mm_store_ps(ty, _mm_sub_ps(py, fy));
+            _mm_store_ps(tz, _mm_sub_ps(pz, fz));
+
+            // texel i of the footprint has the offset (i & 1, (i >> 1) & 1, i >> 2), every row holds the texel i of the 4 samples
+            alignas(16) int32_t idx[8][4];
+            uint32_t border_bits[8];
+            const __m128i one = _mm_set1_epi32(1);
+            for (uint32_t i = 0; i < n; i++)
+            {
+                __m128i border = _mm_setzero_si128();
+                const __m128i x = this->combute_address_mode_simd((i & 1) ? _mm_add_epi32(x0, one) : x0, ci.width, 0, border);
+                const __m128i y = this->combute_address_mode_simd(((i >> 1) & 1) ? _mm_add_epi32(y0, one) : y0, ci.height, 1, border);
+                const __m128i z = (dimmensions == 3) ? this->combute_address_mode_simd((i >> 2) ? _mm_add_epi32(z0, one) : z0, ci.depth, 2, border) : _mm_setzero_si128();
+                _mm_store_si128((__m128i*)idx[i], texel_index_simd(x, y, z, ci));
+                border_bits[i] = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(border)));
+            }
+
+            // gather and decode the texels of every sample and blend them, the texels outside of the image are replaced by the border color
+            const __m128 border_color = _mm_setr_ps(static_cast<float>(this->border_color.r), static_cast<float>(this->border_color.g),
+                                                    static_cast<float>(this->border_color.b), static_cast<float>(this->border_color.a));
+            for (uint32_t s = 0; s < 4; s++)
+            {
+                __m128 c[8];
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    alignas(16) float texel[4];
+                    texel_format::decode(map + idx[i][s], this->channels, texel);
+                    c[i] = (border_bits[i] & (1 << s)) ? border_color : _mm_load_ps(texel);
+                }
+
+                if (!linear)
+                {
+                    _mm_storeu_ps(color + 4 * s, c[0]);
+                    continue;
+                }
+
+                const __m128 sx = _mm_set1_ps(tx[s]);
+                const __m128 sy = _mm_set1_ps(ty[s]);
+                __m128 c0 = mix_simd(mix_simd(c[0], c[1], sx), mix_simd(c[2], c[3], sx), sy);
+                if (dimmensions == 3)
+                {
+                    const __m128 c1 = mix_simd(mix_simd(c[4], c[5], sx), mix_simd(c[6], c[7], sx), sy);
+                    c0 = mix_simd(c0, c1, _mm_set1_ps(tz[s]));
+                }
+                _mm_storeu_ps(color + 4 * s, c0);
+            }
+        }
+#endif
+
     protected:
         Filter filter;
         TextureAddressMode address_mode[3];
         vec_ret border_color;
 
+        /** @return The size of the mip level @param level. */
+        inline const ImageCreateInfo& level_info(uint32_t level) const noexcept
+        {
+            return (level == 0) ? this->create_info : this->mip_levels[level - 1].info;
+        }
+
+        /** @return The texels of the mip level @param level. */
+        inline const T_texel* level_data(uint32_t level) const noexcept
+        {
+            return (level == 0) ? this->map_rdonly() : this->mip_data.data() + this->mip_levels[level - 1].offset;
+        }
+
         /**
-        *   @brief Samples the texture with filter operations applied.
+        *   @brief Samples one mip level of the texture.
         *   @praram[in] pos: uvw-coordinate
+        *   @param[in] level: mip level
+        *   @param[in] linear: True for linear filtering, otherwise the nearest pixel is sampled.
         *   @param[out] color: Color of the sample.
         */
-        void _sample(const glm::vec4& pos, vec_ret& color) const noexcept
+        void _sample_level(const glm::vec4& pos, uint32_t level, bool linear, vec_ret& color) const noexcept
         {
-            alignas(16) glm::uvec4 px_pos;
+            alignas(16) glm::ivec4 px_pos;
             alignas(16) glm::vec4 interpos;
             alignas(16) glm::vec4 _pos = pos;
-            this->combute_image_pos(&_pos, &px_pos, &interpos);
+            this->combute_image_pos(&_pos, &this->level_info(level), &px_pos, &interpos);
 
-            if (this->filter == RT_FILTER_NEAREST)
+            if (!linear)
             {
-                _sample_px(px_pos, color);
+                _sample_px(px_pos, level, color);
                 return; 
             }
 
-            // linear filter
+#if defined(__AVX2__) || defined(__SSE4_1__)
+            // linear filter, the kernel blends floats in SIMD registers
+            if (dimmensions > 1 && std::is_same<T_dst, float>::value)
+            {
+                this->_sample_linear_simd(px_pos, interpos, level, (float*)&color);
+                return;
+            }
+#endif
+
             if (dimmensions == 1)
             {
-                glm::uvec4 pos0 = px_pos;
-                glm::uvec4 pos1 = px_pos + glm::uvec4(1, 0, 0, 0);
+                glm::ivec4 pos0 = px_pos;
+                glm::ivec4 pos1 = px_pos + glm::ivec4(1, 0, 0, 0);
 
                 vec_ret c0, c1;
-                _sample_px(pos0, c0);
-                _sample_px(pos1, c1);
+                _sample_px(pos0, level, c0);
+                _sample_px(pos1, level, c1);
                 color = glm::mix(c0, c1, interpos.x);
             }
             else if (dimmensions == 2)
             {
-                glm::uvec4 pos00 = px_pos;
-                glm::uvec4 pos10 = px_pos + glm::uvec4(1, 0, 0, 0);
-                glm::uvec4 pos01 = px_pos + glm::uvec4(0, 1, 0, 0);
-                glm::uvec4 pos11 = px_pos + glm::uvec4(1, 1, 0, 0);
+                glm::ivec4 pos00 = px_pos;
+                glm::ivec4 pos10 = px_pos + glm::ivec4(1, 0, 0, 0);
+                glm::ivec4 pos01 = px_pos + glm::ivec4(0, 1, 0, 0);
+                glm::ivec4 pos11 = px_pos + glm::ivec4(1, 1, 0, 0);
 
                 vec_ret c00, c10, c01, c11;
-                _sample_px(pos00, c00);
-                _sample_px(pos10, c10);
-                _sample_px(pos01, c01);
-                _sample_px(pos11, c11);
+                _sample_px(pos00, level, c00);
+                _sample_px(pos10, level, c10);
+                _sample_px(pos01, level, c01);
+                _sample_px(pos11, level, c11);
 
                 vec_ret c0 = glm::mix(c00, c10, interpos.x);
                 vec_ret c1 = glm::mix(c01, c11, interpos.x);
@@ -201,24 +530,24 @@ namespace rt
             }
             else if (dimmensions == 3)
             {
-                glm::vec4 pos000 = px_pos;
-                glm::vec4 pos100 = px_pos + glm::uvec4(1, 0, 0, 0);
-                glm::vec4 pos010 = px_pos + glm::uvec4(0, 1, 0, 0);
-                glm::vec4 pos110 = px_pos + glm::uvec4(1, 1, 0, 0);
-                glm::vec4 pos001 = px_pos + glm::uvec4(0, 0, 1, 0);
-                glm::vec4 pos101 = px_pos + glm::uvec4(1, 0, 1, 0);
-                glm::vec4 pos011 = px_pos + glm::uvec4(0, 1, 1, 0);
-                glm::vec4 pos111 = px_pos + glm::uvec4(1, 1, 1, 0);
+                glm::ivec4 pos000 = px_pos;
+                glm::ivec4 pos100 = px_pos + glm::ivec4(1, 0, 0, 0);
+                glm::ivec4 pos010 = px_pos + glm::ivec4(0, 1, 0, 0);
+                glm::ivec4 pos110 = px_pos + glm::ivec4(1, 1, 0, 0);
+                glm::ivec4 pos001 = px_pos + glm::ivec4(0, 0, 1, 0);
+                glm::ivec4 pos101 = px_pos + glm::ivec4(1, 0, 1, 0);
+                glm::ivec4 pos011 = px_pos + glm::ivec4(0, 1, 1, 0);
+                glm::ivec4 pos111 = px_pos + glm::ivec4(1, 1, 1, 0);
 
                 vec_ret c000, c100, c010, c110, c001, c101, c011, c111;
-                _sample_px(pos000, c000);
-                _sample_px(pos100, c100);
-                _sample_px(pos010, c010);
-                _sample_px(pos110, c110);
-                _sample_px(pos001, c001);
-                _sample_px(pos101, c101);
-                _sample_px(pos011, c011);
-                _sample_px(pos111, c111);
+                _sample_px(pos000, level, c000);
+                _sample_px(pos100, level, c100);
+                _sample_px(pos010, level, c010);
+                _sample_px(pos110, level, c110);
+                _sample_px(pos001, level, c001);
+                _sample_px(pos101, level, c101);
+                _sample_px(pos011, level, c011);
+                _sample_px(pos111, level, c111);
 
                 vec_ret c00 = glm::mix(c000, c100, interpos.x);
                 vec_ret c10 = glm::mix(c010, c110, interpos.x);
@@ -232,34 +561,119 @@ namespace rt
             }
         }
 
+        /**
+        *   @brief Samples the base level of the texture with filter operations applied.
+        *   RT_FILTER_TRILINEAR filters the base level linear.
+        *   @praram[in] pos: uvw-coordinate
+        *   @param[out] color: Color of the sample.
+        */
+        void _sample(const glm::vec4& pos, vec_ret& color) const noexcept
+        {
+            this->_sample_level(pos, 0, this->filter != RT_FILTER_NEAREST, color);
+        }
+
+        /**
+        *   @brief Samples the base level of the texture at many uvw-coordinates, the same as _sample() for every coordinate.
+        *   The filter and the level are resolved once. 2D and 3D textures with float as destination-type sample
+        *   4 coordinates per iteration (see _sample4_simd()), the remaining coordinates are sampled one by one.
+        *   @praram[in] pos: uvw-coordinates
+        *   @param[out] color: Colors of the samples.
+        *   @param[in] n: Number of samples.
+        */
+        void _sample_n(const glm::vec4* pos, vec_ret* color, size_t n) const noexcept
+        {
+            const bool linear = (this->filter != RT_FILTER_NEAREST);
+            size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE4_1__)
+            if (dimmensions > 1 && std::is_same<T_dst, float>::value)
+            {
+                for (; i + 4 <= n; i += 4)
+                    this->_sample4_simd(pos + i, linear, (float*)(color + i));
+            }
+#endif
+            for (; i < n; i++)
+                this->_sample_level(pos[i], 0, linear, color[i]);
+        }
+
+        /**
+        *   @brief Samples the texture at a level of detail.
+        *   RT_FILTER_NEAREST:      The nearest pixel of the nearest mip level is sampled.
+        *   RT_FILTER_LINEAR:       The nearest mip level is filtered linear.
+        *   RT_FILTER_TRILINEAR:    The two closest mip levels are filtered linear and blended.
+        *   @praram[in] pos: uvw-coordinate
+        *   @param[in] lod: Level of detail, 0 is the base level. Gets clamped to the existing mip levels.
+        *   @param[out] color: Color of the sample.
+        */
+        void _sample_lod(const glm::vec4& pos, float lod, vec_ret& color) const noexcept
+        {
+            lod = glm::clamp(lod, 0.0f, static_cast<float>(this->mip_levels.size()));
+            if (this->filter == RT_FILTER_TRILINEAR)
+            {
+                const uint32_t level = static_cast<uint32_t>(lod);
+                const float t = lod - static_cast<float>(level);
+                this->_sample_level(pos, level, true, color);
+                if (t > 0.0f)
+                {
+                    vec_ret color1;
+                    this->_sample_level(pos, level + 1, true, color1);
+                    color = glm::mix(color, color1, static_cast<T_dst>(t));
+                }
+                return;
+            }
+            this->_sample_level(pos, static_cast<uint32_t>(lod + 0.5f), this->filter == RT_FILTER_LINEAR, color);
+        }
+
+        /**
+        *   @brief Combutes the level of detail from the uvw-derivatives of the footprint of a sample.
+        *   @param[in] ddx: Change of the uvw-coordinate from one pixel to the next in x-direction.
+        *   @param[in] ddy: Change of the uvw-coordinate from one pixel to the next in y-direction.
+        *   @return log2 of the length of the longer derivative in pixels of the base level.
+        */
+        float combute_lod(const glm::vec4& ddx, const glm::vec4& ddy) const noexcept
+        {
+            const glm::vec3 size(this->create_info.width, (dimmensions > 1) ? this->create_info.height : 0, (dimmensions > 2) ? this->create_info.depth : 0);
+            const glm::vec3 dx = glm::vec3(ddx) * size;
+            const glm::vec3 dy = glm::vec3(ddy) * size;
+            const float rho2 = glm::max(glm::dot(dx, dx), glm::dot(dy, dy));
+            return (rho2 > 0.0f) ? 0.5f * std::log2(rho2) : 0.0f;
+        }
+
         /**
         *   @brief Transformes the uvw-coordinate to pixel-coordinate.
         *   IMPORTANT: EVERY PARAMETER MUST BE 16-BYTE ALIGNED!!!
         *   @param[in] pos: uvw-coordinate
-        *   @param[out] _floor: floored pixel-coordinate
+        *   @param[in] ci: Size of the image (mip level).
+        *   @param[out] _floor: floored pixel-coordinate, negative for negative uvw-coordinates
         *   @param[out] _fract: Fractional part of the pixel-coordinate.
         */
-        inline void combute_image_pos(const glm::vec4* pos, glm::uvec4* _floor, glm::vec4* _fract) const noexcept
+        inline void combute_image_pos(const glm::vec4* pos, const ImageCreateInfo* ci, glm::ivec4* _floor, glm::vec4* _fract) const noexcept
         {
             __m128 a = _mm_load_ps((const float*)pos);                         // load image positions
-            __m128 b = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*)&this->create_info)); // load image dimmensions and cast to float
+            __m128 b = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*)ci));    // load image dimmensions and cast to float
             __m128 res = _mm_mul_ps(a, b);                                      // pixel position = position * size (floating point)
-            __m128i floor_res = _mm_cvttps_epi32(res);                          // cast with truncation to integer (floor operation)
-            __m128 fract_res = _mm_sub_ps(res, _mm_cvtepi32_ps(floor_res));     // fract operation
-            _mm_store_si128((__m128i*)_floor, floor_res);
-            _mm_store_ps((float*)_fract, a);
+#if defined(__AVX2__) || defined(__SSE4_1__)
+            __m128 floor_res = _mm_floor_ps(res);                               // floor operation, also rounds negative positions down
+#else
+            // SSE2 has no floor, the truncated value is decremented if it was rounded up (negative positions)
+            __m128 trunc_res = _mm_cvtepi32_ps(_mm_cvttps_epi32(res));
+            __m128 floor_res = _mm_sub_ps(trunc_res, _mm_and_ps(_mm_cmpgt_ps(trunc_res, res), _mm_set1_ps(1.0f)));
+#endif
+            __m128 fract_res = _mm_sub_ps(res, floor_res);                      // fract operation
+            _mm_store_si128((__m128i*)_floor, _mm_cvttps_epi32(floor_res));
+            _mm_store_ps((float*)_fract, fract_res);
         }
 
         /**
         *   @brief Combutes the address mode for all dimmensions.
         *   @param[in] pos: pixel-coordinate
+        *   @param[in] ci: Size of the image (mip level).
         *   @param[out] pos2: Pixel-coordinate after address mode computation.
         */
-        void combute_address_mode(const glm::uvec4& pos, glm::uvec4& pos2) const noexcept
+        void combute_address_mode(const glm::ivec4& pos, const ImageCreateInfo& ci, glm::uvec4& pos2) const noexcept
         {
-            pos2.x = combute_address_mode_comp(pos.x, 0);
-            pos2.y = combute_address_mode_comp(pos.y, 1);
-            pos2.z = combute_address_mode_comp(pos.z, 2);
+            pos2.x = combute_address_mode_comp(pos.x, ci.width, 0);
+            pos2.y = (dimmensions > 1) ? combute_address_mode_comp(pos.y, ci.height, 1) : 0;
+            pos2.z = (dimmensions > 2) ? combute_address_mode_comp(pos.z, ci.depth, 2) : 0;
         }
 
     public:
@@ -271,6 +685,8 @@ namespace rt
         {
             this->filter = filter;
             this->border_color = border_color;
+            this->mipmapped = true;
+            this->channels = 0;
             this->set_address_mode(RT_TEXTURE_ADDRESS_MODE_REPEAT, RT_TEXTURE_ADDRESS_MODE_REPEAT, RT_TEXTURE_ADDRESS_MODE_REPEAT);
         }
         virtual ~Texture(void) {}
@@ -287,15 +703,77 @@ namespace rt
             this->address_mode[2] = w;
         }
 
+        /** @return Number of color channels of a texel. */
+        inline uint32_t channel_count(void) const noexcept
+        {
+            return this->channels;
+        }
+
         /** @param[in] filter: filter operation */
         void set_filter(Filter filter) noexcept { this->filter = filter; }
 
         /** @param[in] border_color: Color of the border for oversampling. */
         void set_border_color(const vec_ret& border_color) noexcept { this->border_color = border_color; }
 
+        /**
+        *   @param[in] generate: True to generate the mip levels when the texture is loaded (default).
+        *   Without mip levels, sampling at a level of detail always samples the base level.
+        */
+        void set_mipmaps(bool generate) noexcept { this->mipmapped = generate; }
+
+        /** @return The number of mip levels, including the base level. */
+        inline uint32_t mip_level_count(void) const noexcept
+        {
+            return static_cast<uint32_t>(this->mip_levels.size()) + 1;
+        }
+
+        /**
+        *   @brief Generates the mip levels down to a size of 1 pixel from the base level.
+        *   Every level has half the size of the level above (rounded down) and is filtered with a box filter.
+        *   The levels are generated by load() automatically, call this method if the texels are
+        *   written with map_rdwr().
+        *   @return image error
+        */
+        ImageError generate_mipmaps(void)
+        {
+            this->mip_levels.clear();
+            this->mip_data.clear();
+            if (this->map_rdonly() == nullptr) return RT_IMAGE_ERROR_NULL;
+
+            ImageCreateInfo ci = this->create_info;
+            size_t offset = 0;
+            while (ci.width > 1 || (dimmensions > 1 && ci.height > 1) || (dimmensions > 2 && ci.depth > 1))
+            {
+                ci.width = glm::max(ci.width / 2, 1u);
+                if (dimmensions > 1) ci.height = glm::max(ci.height / 2, 1u);
+                if (dimmensions > 2) ci.depth = glm::max(ci.depth / 2, 1u);
+
+                mip_level_t level;
+                level.info = ci;
+                level.offset = offset;
+                this->mip_levels.push_back(level);
+                offset += Texture::storage_count(ci);
+            }
+            this->mip_data.resize(offset);
+
+            for (uint32_t level = 1; level < this->mip_level_count(); level++)
+                this->downsample(level);
+            return RT_IMAGE_ERROR_NONE;
+        }
+
+        /** @brief Frees the allocated memory of the texture and its mip levels. */
+        void free(void) noexcept
+        {
+            Image<T_texel, dimmensions>::free();
+            this->mip_levels.clear();
+            this->mip_data.clear();
+            this->mip_data.shrink_to_fit();
+        }
+
         /**
         *   @brief Loads the pixels into the texture object.
         *   NOTE: This method does not read the image file!
+        *   RT_IMAGE_LAYOUT_AUTO selects the tiled layout if the texture is larger than RT_IMAGE_TILED_LAYOUT_THRESHOLD.
         *   @param[in] ci: image create info
         *   @param[in] byte_data: pixels
         *   @return image error
@@ -304,19 +782,48 @@ namespace rt
         {
             if (byte_data == nullptr) return RT_IMAGE_ERROR_NULL;
             if (ci.width == 0 || ci.height == 0 || ci.depth == 0) return RT_IMAGE_ERROR_ZERO_SIZE;
+            if (ci.channels > texel_format::MAX_CHANNELS) return RT_IMAGE_ERROR_UNSUPPORTED_FORMAT;
+
+            // the underlying image stores the elements of the storage type
+            ImageCreateInfo _ci = ci;
+            _ci.channels = texel_format::elements(ci.channels);
+
+            // textures are sampled at scattered positions, large textures are tiled unless a layout is requested
+            if (_ci.layout == RT_IMAGE_LAYOUT_AUTO)
+            {
+                _ci.layout = RT_IMAGE_LAYOUT_LINEAR;
+                if (dimmensions > 1 && sizeof(T_texel) * Texture::storage_count(_ci) > RT_IMAGE_TILED_LAYOUT_THRESHOLD)
+                    _ci.layout = RT_IMAGE_LAYOUT_TILED;
+            }
 
             this->free();
-            this->set_create_info(ci);
+            this->set_create_info(_ci);
+            this->channels = ci.channels;
             ImageError error = this->create();  // error may return an error code
             if (error != RT_IMAGE_ERROR_NONE) return error;
 
-            T_dst* map = this->map_rdwr();          // get pointer to the image data array
-            size_t s = this->count() * ci.channels; // get number of elemnts in the image array
-
-            // iterate through every image array element and convert it from source- to destination-type
-            for (size_t i = 0; i < s; i++)
-                map[i] = convert_type(byte_data[i]);
+            // the source pixels are row after row, they are converted to the destination-type
+            // and encoded one by one into their place (row or tile) of the image data array,
+            // the rows are converted in parallel
+            T_texel* map = this->map_rdwr();
+            const glm::uvec3 size(this->width(), (dimmensions > 1) ? this->height() : 1, (dimmensions > 2) ? this->depth() : 1);
+            #pragma omp parallel for
+            for (int32_t row = 0; row < static_cast<int32_t>(size.y * size.z); row++)
+            {
+                const uint32_t y = static_cast<uint32_t>(row) % size.y;
+                const uint32_t z = static_cast<uint32_t>(row) / size.y;
+                for (uint32_t x = 0; x < size.x; x++)
+                {
+                    const T_src* src = byte_data + ((size_t)row * size.x + x) * ci.channels;
+                    T_dst texel[4];
+                    for (uint32_t c = 0; c < ci.channels; c++)
+                        texel[c] = convert_type(src[c]);
+                    texel_format::encode(texel, ci.channels, map + texel_index(glm::uvec4(x, y, z, 0), this->create_info));
+                }
+            }
 
+            if (this->mipmapped)
+                return this->generate_mipmaps();
             return RT_IMAGE_ERROR_NONE;
         }
 
@@ -332,17 +839,61 @@ namespace rt
             this->_sample(pos, color);
             return color;
         }
+
+        /**
+        *   @brief Samples the texture at a level of detail (see RT_FILTER_TRILINEAR).
+        *   @praram[in] pos: uvw-coordinate
+        *   @param[in] lod: Level of detail, 0 is the base level, 1 the first mip level, etc.
+        *   @return Color of the sample.
+        */
+        virtual vec_ret sample(const glm::vec4& pos, float lod) const
+        {
+            vec_ret color;
+            this->_sample_lod(pos, lod, color);
+            return color;
+        }
+
+        /**
+        *   @brief Samples the texture at many coordinates with one call, the same as sample(pos) for every coordinate.
+        *   2D and 3D textures with float as destination-type combute the addresses of 4 samples at once.
+        *   @praram[in] coords: uvw-coordinates
+        *   @param[out] out: Colors of the samples.
+        *   @param[in] n: Number of samples.
+        *   NOTE: This method can be inheritated and overwritten.
+        */
+        virtual void sample_n(const glm::vec4* coords, vec_ret* out, size_t n) const
+        {
+            this->_sample_n(coords, out, n);
+        }
+
+        /**
+        *   @brief Samples the texture with a level of detail that is combuted from the footprint of the sample.
+        *   @praram[in] pos: uvw-coordinate
+        *   @param[in] ddx: Change of the uvw-coordinate from one pixel to the next in x-direction.
+        *   @param[in] ddy: Change of the uvw-coordinate from one pixel to the next in y-direction.
+        *   @return Color of the sample.
+        */
+        vec_ret sample(const glm::vec4& pos, const glm::vec4& ddx, const glm::vec4& ddy) const
+        {
+            vec_ret color;
+            this->_sample_lod(pos, this->combute_lod(ddx, ddy), color);
+            return color;
+        }
     };
 
-    template<typename T_src, typename T_dst> using Texture1D = Texture<T_src, T_dst, 1>;
-    template<typename T_src, typename T_dst> using Texture2D = Texture<T_src, T_dst, 2>;
-    template<typename T_src, typename T_dst> using Texture3D = Texture<T_src, T_dst, 3>;
+    template<typename T_src, typename T_dst, typename T_texel = T_dst> using Texture1D = Texture<T_src, T_dst, 1, T_texel>;
+    template<typename T_src, typename T_dst, typename T_texel = T_dst> using Texture2D = Texture<T_src, T_dst, 2, T_texel>;
+    template<typename T_src, typename T_dst, typename T_texel = T_dst> using Texture3D = Texture<T_src, T_dst, 3, T_texel>;
 
     /**
     *   Load functions for typical image formats:
     *   1) 8-bit (per color channel) image format
     *   2) 16-bit (per color channel) image format
     *   3) floating-point image format
+    *   The texels can be stored as float (default), uint8_t, rt::half_t or rt::rgb9e5_t.
+    *   Every function has an asynchronous version, which loads the image on its own thread and returns a
+    *   future of the image error. Several images can be loaded at once this way.
+    *   IMPORTANT: The texture must not be used or destroyed until the future is ready.
     */
     namespace TextureLoader
     {
@@ -354,7 +905,8 @@ namespace rt
         *                              Leave it to 0 to not force the loader.
         *   @return image error
         */
-        ImageError load(Texture2D<uint8_t, float>& tex, const std::string& path, uint32_t force_channels);
+        template<typename T_texel>
+        ImageError load(Texture2D<uint8_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels);
 
         /**
         *   @brief Loads a 16-bit (per color channel) image into a texture object.
@@ -364,7 +916,8 @@ namespace rt
         *                              Leave it to 0 to not force the loader.
         *   @return image error
         */
-        ImageError load16(Texture2D<uint16_t, float>& tex, const std::string& path, uint32_t force_channels);
+        template<typename T_texel>
+        ImageError load16(Texture2D<uint16_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels);
 
         /**
         *   @brief Loads a floating-point image into a texture object.
@@ -374,6 +927,19 @@ namespace rt
         *                              Leave it to 0 to not force the loader.
         *   @return image error
         */
-        ImageError loadf(Texture2D<float, float>& tex, const std::string& path, uint32_t force_channels);
+        template<typename T_texel>
+        ImageError loadf(Texture2D<float, float, T_texel>& tex, const std::string& path, uint32_t force_channels);
+
+        /** @brief Asynchronous version of load(), the returned future contains the image error. */
+        template<typename T_texel>
+        std::future<ImageError> load_async(Texture2D<uint8_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels);
+
+        /** @brief Asynchronous version of load16(), the returned future contains the image error. */
+        template<typename T_texel>
+        std::future<ImageError> load16_async(Texture2D<uint16_t, float, T_texel>& tex, const std::string& path, uint32_t force_channels);
+
+        /** @brief Asynchronous version of loadf(), the returned future contains the image error. */
+        template<typename T_texel>
+        std::future<ImageError> loadf_async(Texture2D<float, float, T_texel>& tex, const std::string& path, uint32_t force_channels);
     }
 }
\ No newline at end of file
@@ -0,0 +1,280 @@
+/**
+* @file     texture_sampler.h
+* @brief    Texture sampler that is specialized at compile time for its filter and address modes.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "texture.h"
+
+namespace rt
+{
+    /**
+    *   A texture sampler samples the texels of a texture with a filter, address modes and a channel count
+    *   that are template parameters. Unlike rt::Texture::sample() there are no branches over the
+    *   filter and address modes and no loop over the channels, every sample is straight-line code.
+    *   The repeat address modes of mip levels with a power of two size wrap with a bit mask instead of
+    *   a division.
+    *   The sampler returns the same colors as the texture, if the texture has the same filter and address modes.
+    *   If the sampler has fewer channels than the texture, the remaining channels are 0.
+    *   IMPORTANT: The sampler refers to the texels of the texture, it must be created again if the
+    *   texture is loaded again, its mip levels are generated again or the texture is freed.
+    *   T_texture: The texture type, e.g. rt::Texture2D<uint8_t, float>.
+    *   filter: filter operation
+    *   channels: Number of color channels that are sampled.
+    *   address_u, address_v, address_w: Address-modes in the u-, v- and w-direction.
+    */
+    template<typename T_texture, Filter filter, uint32_t channels, TextureAddressMode address_u, TextureAddressMode address_v = address_u, TextureAddressMode address_w = address_v>
+    class TextureSampler;
+
+    template<typename T_src, typename T_dst, uint32_t dimmensions, typename T_texel, Filter filter, uint32_t channels, TextureAddressMode address_u, TextureAddressMode address_v, TextureAddressMode address_w>
+    class TextureSampler<Texture<T_src, T_dst, dimmensions, T_texel>, filter, channels, address_u, address_v, address_w>
+    {
+    public:
+        using texture_type = Texture<T_src, T_dst, dimmensions, T_texel>;
+        using vec_ret = glm::vec<4, T_dst, glm::defaultp>;
+
+    private:
+        using texel_format = TexelFormat<T_texel>;
+
+        static_assert(channels > 0 && channels <= texel_format::MAX_CHANNELS,
+                        "[Ray-Tracer | TextureSampler]: Channel count is not supported by the texel format.");
+
+        static constexpr bool LINEAR = (filter != RT_FILTER_NEAREST);
+        static constexpr bool BORDER_U = (address_u == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER);
+        static constexpr bool BORDER_V = (dimmensions > 1 && address_v == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER);
+        static constexpr bool BORDER_W = (dimmensions > 2 && address_w == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER);
+
+        struct level_t
+        {
+            const T_texel* data;    // texels of the mip level
+            ImageCreateInfo info;   // size and layout of the mip level
+            glm::vec4 size;         // size of the mip level as float, to convert the uvw- to pixel-coordinates
+            int32_t extent[3];      // size of the mip level in every dimmension
+            int32_t mask[3];        // extent - 1 if the extent is a power of two, otherwise -1
+        };
+
+        std::vector<level_t> levels;
+        vec_ret border_color;
+
+        /**
+        *   @brief Applies an address mode to one dimmension of a pixel-coordinate.
+        *   @param[in] pos: x/y/z-pixel-coordinate, may be negative
+        *   @param[in] s: Size of the mip level in that dimmension.
+        *   @param[in] mask: s - 1 if s is a power of two, otherwise -1.
+        *   @return x/y/z-pixel-coordinate after address mode computation, @param s if the border is sampled.
+        */
+        template<TextureAddressMode mode>
+        static inline int32_t wrap(int32_t pos, int32_t s, int32_t mask) noexcept
+        {
+            if (mode == RT_TEXTURE_ADDRESS_MODE_REPEAT)
+            {
+                if (mask >= 0) return pos & mask;
+                const int32_t m = pos % s;
+                return (m < 0) ? m + s : m;
+            }
+            if (mode == RT_TEXTURE_ADDRESS_MODE_MIRRORED_REPEAT)
+            {
+                // the image and its mirror image repeat with a period of 2 * s, which is also a power of two
+                int32_t m;
+                if (mask >= 0)
+                    m = pos & (2 * mask + 1);
+                else
+                {
+                    m = pos % (2 * s);
+                    if (m < 0) m += 2 * s;
+                }
+                return (m < s) ? m : 2 * s - 1 - m;
+            }
+            if (mode == RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_EDGE)
+                return glm::clamp(pos, 0, s - 1);
+            return (pos < 0 || pos >= s) ? s : pos;
+        }
+
+        /**
+        *   @brief Reads a single texel of a mip level without filter operations applied.
+        *   @param[in] level: mip level
+        *   @param[in] x, y, z: pixel-coordinate
+        *   @param[out] color: color of the texel
+        */
+        inline void fetch(const level_t& level, int32_t x, int32_t y, int32_t z, vec_ret& color) const noexcept
+        {
+            const int32_t _x = wrap<address_u>(x, level.extent[0], level.mask[0]);
+            const int32_t _y = (dimmensions > 1) ? wrap<address_v>(y, level.extent[1], level.mask[1]) : 0;
+            const int32_t _z = (dimmensions > 2) ? wrap<address_w>(z, level.extent[2], level.mask[2]) : 0;
+
+            // only the dimmensions with the clamp to border mode can leave the mip level
+            if ((BORDER_U && _x == level.extent[0]) || (BORDER_V && _y == level.extent[1]) || (BORDER_W && _z == level.extent[2]))
+            {
+                color = this->border_color;
+                return;
+            }
+            texel_format::decode(level.data + texture_type::texel_index(glm::uvec4(_x, _y, _z, 0), level.info), channels, (T_dst*)&color);
+        }
+
+        /**
+        *   @brief Samples one mip level with the filter of the sampler.
+        *   @param[in] pos: uvw-coordinate
+        *   @param[in] level: mip level
+        *   @param[out] color: Color of the sample.
+        */
+        void sample_level(const glm::vec4& pos, const level_t& level, vec_ret& color) const noexcept
+        {
+            const glm::vec4 px = pos * level.size;
+            const glm::vec4 px_floor = glm::floor(px);
+            const glm::vec4 t = px - px_floor;
+            const glm::ivec4 p = glm::ivec4(px_floor);
+
+            if (!LINEAR)
+            {
+                this->fetch(level, p.x, p.y, p.z, color);
+                return;
+            }
+
+            if (dimmensions == 1)
+            {
+                vec_ret c0, c1;
+                this->fetch(level, p.x,     0, 0, c0);
+                this->fetch(level, p.x + 1, 0, 0, c1);
+                color = glm::mix(c0, c1, t.x);
+            }
+            else if (dimmensions == 2)
+            {
+                vec_ret c00, c10, c01, c11;
+                this->fetch(level, p.x,     p.y,     0, c00);
+                this->fetch(level, p.x + 1, p.y,     0, c10);
+                this->fetch(level, p.x,     p.y + 1, 0, c01);
+                this->fetch(level, p.x + 1, p.y + 1, 0, c11);
+
+                vec_ret c0 = glm::mix(c00, c10, t.x);
+                vec_ret c1 = glm::mix(c01, c11, t.x);
+                color = glm::mix(c0, c1, t.y);
+            }
+            else
+            {
+                vec_ret c000, c100, c010, c110, c001, c101, c011, c111;
+                this->fetch(level, p.x,     p.y,     p.z,     c000);
+                this->fetch(level, p.x + 1, p.y,     p.z,     c100);
+                this->fetch(level, p.x,     p.y + 1, p.z,     c010);
+                this->fetch(level, p.x + 1, p.y + 1, p.z,     c110);
+                this->fetch(level, p.x,     p.y,     p.z + 1, c001);
+                this->fetch(level, p.x + 1, p.y,     p.z + 1, c101);
+                this->fetch(level, p.x,     p.y + 1, p.z + 1, c011);
+                this->fetch(level, p.x + 1, p.y + 1, p.z + 1, c111);
+
+                vec_ret c00 = glm::mix(c000, c100, t.x);
+                vec_ret c10 = glm::mix(c010, c110, t.x);
+                vec_ret c01 = glm::mix(c001, c101, t.x);
+                vec_ret c11 = glm::mix(c011, c111, t.x);
+
+                vec_ret c0 = glm::mix(c00, c10, t.y);
+                vec_ret c1 = glm::mix(c01, c11, t.y);
+
+                color = glm::mix(c0, c1, t.z);
+            }
+        }
+
+    public:
+        TextureSampler(void) noexcept : border_color(static_cast<T_dst>(0)) {}
+
+        /**
+        *   @param[in] texture: The texture to sample, see create().
+        *   NOTE: The sampler is empty if the texture cannot be sampled.
+        */
+        explicit TextureSampler(const texture_type& texture) : TextureSampler()
+        {
+            this->create(texture);
+        }
+
+        virtual ~TextureSampler(void) {}
+
+        /**
+        *   @brief Takes over the mip levels and the border color of a texture.
+        *   The filter and address modes of the texture are ignored, the ones of the sampler are used.
+        *   @param[in] texture: The texture to sample.
+        *   @return RT_IMAGE_ERROR_NULL if the texture is not loaded, RT_IMAGE_ERROR_UNSUPPORTED_FORMAT if
+        *   the texture has fewer channels than the sampler.
+        */
+        ImageError create(const texture_type& texture)
+        {
+            this->levels.clear();
+            if (texture.map_rdonly() == nullptr) return RT_IMAGE_ERROR_NULL;
+            if (texture.channel_count() < channels) return RT_IMAGE_ERROR_UNSUPPORTED_FORMAT;
+
+            for (uint32_t i = 0; i < texture.mip_level_count(); i++)
+            {
+                const ImageCreateInfo& ci = texture.level_info(i);
+                const uint32_t size[3] = { ci.width, ci.height, ci.depth };
+
+                level_t level;
+                level.data = texture.level_data(i);
+                level.info = ci;
+                level.size = glm::vec4(static_cast<float>(ci.width), static_cast<float>(ci.height), static_cast<float>(ci.depth), 0.0f);
+                for (uint32_t d = 0; d < 3; d++)
+                {
+                    level.extent[d] = static_cast<int32_t>(size[d]);
+                    level.mask[d] = (size[d] != 0 && (size[d] & (size[d] - 1)) == 0) ? level.extent[d] - 1 : -1;
+                }
+                this->levels.push_back(level);
+            }
+            for (uint32_t c = 0; c < 4; c++)
+                this->border_color[c] = (c < channels) ? texture.border_color[c] : static_cast<T_dst>(0);
+            return RT_IMAGE_ERROR_NONE;
+        }
+
+        /** @return The number of mip levels of the sampled texture, 0 if the sampler is empty. */
+        inline uint32_t mip_level_count(void) const noexcept
+        {
+            return static_cast<uint32_t>(this->levels.size());
+        }
+
+        /**
+        *   @brief Samples the base level of the texture, the same as rt::Texture::sample(pos).
+        *   @param[in] pos: uvw-coordinate
+        *   @return Color of the sample, 0 if the sampler is empty.
+        */
+        inline vec_ret sample(const glm::vec4& pos) const noexcept
+        {
+            if (this->levels.empty()) return vec_ret(static_cast<T_dst>(0));
+
+            vec_ret color;
+            this->sample_level(pos, this->levels[0], color);
+            return color;
+        }
+
+        /**
+        *   @brief Samples the texture at a level of detail, the same as rt::Texture::sample(pos, lod).
+        *   @param[in] pos: uvw-coordinate
+        *   @param[in] lod: Level of detail, 0 is the base level. Gets clamped to the existing mip levels.
+        *   @return Color of the sample, 0 if the sampler is empty.
+        */
+        inline vec_ret sample(const glm::vec4& pos, float lod) const noexcept
+        {
+            if (this->levels.empty()) return vec_ret(static_cast<T_dst>(0));
+
+            vec_ret color;
+            lod = glm::clamp(lod, 0.0f, static_cast<float>(this->levels.size() - 1));
+            if (filter == RT_FILTER_TRILINEAR)
+            {
+                const uint32_t level = static_cast<uint32_t>(lod);
+                const float t = lod - static_cast<float>(level);
+                this->sample_level(pos, this->levels[level], color);
+                if (t > 0.0f)
+                {
+                    vec_ret color1;
+                    this->sample_level(pos, this->levels[level + 1], color1);
+                    color = glm::mix(color, color1, static_cast<T_dst>(t));
+                }
+                return color;
+            }
+            this->sample_level(pos, this->levels[static_cast<uint32_t>(lod + 0.5f)], color);
+            return color;
+        }
+    };
+}
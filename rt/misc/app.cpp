@@ -11,6 +11,9 @@
 
 
 #include "app.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <omp.h>
 
 #define atXY(x, y, stride) (y * stride + x)
@@ -23,45 +26,74 @@ RayTracer::RayTracer(void) noexcept
     this->_rt_ratio = 0.0f;
     this->_rt_pixels = 0;
     this->_n_threads = 1;
+    this->_tile_size = 16;
+    this->_pass = 0;
+    this->_backend = RT_BACKEND_RECURSIVE;
 }
 
 RayTracer::~RayTracer(void) noexcept
 {
+    for (GeometryBuffer* buff : this->_geometry_buff)
+        delete buff;
 }
 
 float RayTracer::intersection(const rt::ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const rt::Primitive** hit_prim)
 {
-    float t = t_max;
-    const size_t bs = this->rt_geometry_buffer_count();
+    float t = this->_bvh.intersect(ray, t_max, cull_mask, hit_info, hit_prim);
 
-    // for each buffer...
-    for(size_t b = 0; b < bs; b++)
-    {
-        // and for each primitive...
-        const Primitive * const * map = this->rt_geometry()[b].map_rdonly();
-        const size_t first = this->rt_geometry()[b].layout().first;
-        const size_t last = this->rt_geometry()[b].layout().last;
+    // geometry buffers only report hits that are closer than the closest hit so far
+    for (const GeometryBuffer* buff : this->_geometry_buff)
+        t = buff->intersect(ray, t, cull_mask, hit_info, hit_prim);
+    return t;
+}
 
-        for(size_t p = first; p < last; p++)
-        {
-            // if it is not a nullptr...
-            if(map[p] != nullptr)
-            {
-                // test for intersection...
-                uint32_t _hit_info;
-                const float t_cur = map[p]->intersect(ray, t_max, cull_mask, _hit_info);
-                // and return the closest hit.
-                if(t_cur < t)
-                {
-                    if(hit_prim != nullptr)
-                        *hit_prim = map[p];
-                    t = t_cur;
-                    hit_info = _hit_info;
-                }
-            }
-        }
+void RayTracer::intersection_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim)
+{
+    this->_bvh.intersect_packet(packet, mask, cull_mask, t, hit_info, hit_prim);
+    for (const GeometryBuffer* buff : this->_geometry_buff)
+        buff->intersect_packet(packet, mask, cull_mask, t, hit_info, hit_prim);
+}
+
+bool RayTracer::any_hit(void* user_data, const ray_t& ray, float t, const Primitive* hit_prim, RayHitInformation hit_info)
+{
+    return ((RayTracer*)user_data)->any_hit_shader(ray, t, hit_prim, hit_info);
+}
+
+bool RayTracer::trace_occlusion(const ray_t& ray, float t_max, RayCullMask cull_mask)
+{
+    if (this->_bvh.occluded(ray, t_max, cull_mask, RayTracer::any_hit, this))
+        return true;
+    for (const GeometryBuffer* buff : this->_geometry_buff)
+    {
+        if (buff->occluded(ray, t_max, cull_mask, RayTracer::any_hit, this))
+            return true;
     }
-    return t;
+    return false;
+}
+
+bool RayTracer::any_hit_shader(const ray_t& ray, float t, const Primitive* hit, RayHitInformation hit_info)
+{
+    return true;
+}
+
+float RayTracer::scene_distance(const glm::vec3& p, float d_max, const Primitive** hit_prim)
+{
+    float d = this->_bvh.distance(p, d_max, hit_prim);
+    for (const GeometryBuffer* buff : this->_geometry_buff)
+        d = buff->distance(p, d, hit_prim);
+    return d;
+}
+
+void RayTracer::update_acceleration_structure(void)
+{
+    // the revisions of the buffers only match if they still share the same primitives
+    std::vector<uint64_t> revisions(this->_cmd_buff.size());
+    for (size_t i = 0; i < this->_cmd_buff.size(); i++)
+        revisions[i] = this->_cmd_buff[i].revision();
+    if (revisions == this->_bvh_revisions) return;
+
+    this->_bvh.build(this->_cmd_buff.data(), this->_cmd_buff.size());
+    this->_bvh_revisions = std::move(revisions);
 }
 
 void RayTracer::trace_ray(const ray_t& ray, int recursions, float t_max, RayCullMask cull_mask, void* ray_payload)
@@ -76,20 +108,364 @@ void RayTracer::trace_ray(const ray_t& ray, int recursions, float t_max, RayCull
     else            this->miss_shader(ray, recursions, t_max, ray_payload);
 }
 
+void RayTracer::trace_ray_packet(const ray_packet_t& packet, uint32_t mask, int recursions, float t_max, RayCullMask cull_mask, void** ray_payloads)
+{
+    if (recursions == 0 || mask == 0) return;
+
+    alignas(32) float t[RT_RAY_PACKET_SIZE];
+    RayHitInformation hit_info[RT_RAY_PACKET_SIZE];
+    const Primitive* hit_prim[RT_RAY_PACKET_SIZE];
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        t[i] = t_max;
+        hit_info[i] = RT_HIT_INFO_NONE;
+        hit_prim[i] = nullptr;
+    }
+    this->intersection_packet(packet, mask, cull_mask, t, hit_info, hit_prim);
+
+    // shading is done per ray
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+
+        const ray_t ray = packet.ray(i);
+        if (t[i] < t_max)   this->closest_hit_shader(ray, recursions, t[i], t_max, hit_prim[i], hit_info[i], ray_payloads[i]);
+        else                this->miss_shader(ray, recursions, t_max, ray_payloads[i]);
+    }
+}
+
+void RayTracer::ray_generation_shader_packet(const uint32_t* x, const uint32_t* y, uint32_t mask, glm::vec3* colors)
+{
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        if (mask & (1 << i))
+            colors[i] = this->ray_generation_shader(x[i], y[i]);
+    }
+}
+
+bool RayTracer::wavefront_ray_generation_shader(uint32_t x, uint32_t y, ray_t& ray, glm::vec3& weight)
+{
+    return false;
+}
+
+bool RayTracer::wavefront_closest_hit_shader(const ray_t& ray, uint32_t depth, float t, const Primitive* hit, RayHitInformation hit_info, glm::vec3& emitted, glm::vec3& attenuation, ray_t& next_ray)
+{
+    return false;
+}
+
+glm::vec3 RayTracer::wavefront_miss_shader(const ray_t& ray, uint32_t depth)
+{
+    return glm::vec3(0.0f);
+}
+
+void RayTracer::wavefront_miss_shader_n(const ray_t* rays, size_t n, uint32_t depth, glm::vec3* radiance)
+{
+    for (size_t i = 0; i < n; i++)
+        radiance[i] = this->wavefront_miss_shader(rays[i], depth);
+}
+
+uint64_t RayTracer::material_key(const Primitive* hit)
+{
+    return (uint64_t)(uintptr_t)hit->attribute();
+}
+
 void RayTracer::run(void)
+{
+    this->update_acceleration_structure();
+
+    const uint32_t pass = this->_pass;
+    this->_pass = 0;
+    this->render_pass(false);
+    this->_pass = pass;
+}
+
+void RayTracer::run_progressive(uint32_t n_passes)
+{
+    this->update_acceleration_structure();
+
+    if (this->_accum.size() != this->_fbo.count())
+        this->reset_accumulation();
+
+    for (uint32_t i = 0; i < n_passes; i++)
+    {
+        this->render_pass(true);
+        this->_pass++;
+        if (!this->pass_callback(this->_pass, n_passes))
+            break;
+    }
+}
+
+void RayTracer::reset_accumulation(void)
+{
+    this->_accum.assign(this->_fbo.count(), glm::vec3(0.0f));
+    this->_sample_count.assign(this->_fbo.count(), 0);
+    this->_m2.assign(this->_fbo.count(), 0.0f);
+    this->_pass = 0;
+}
+
+bool RayTracer::pass_callback(uint32_t pass, uint32_t n_passes)
+{
+    return true;
+}
+
+// walks the pixels of a tile along the Morton-curve and collects the pixels that pass @param filter,
+// consecutive pixels form small blocks of neighbouring pixels
+template<typename Filter>
+static uint32_t collect_tile(const tile_t& tile, size_t curve_length, Filter filter, uint32_t* x, uint32_t* y)
+{
+    uint32_t n = 0;
+    for (uint32_t code = 0; code < curve_length; code++)
+    {
+        TileScheduler::morton_decode(code, x[n], y[n]);
+        x[n] += tile.x0;
+        y[n] += tile.y0;
+        if (x[n] >= tile.x1 || y[n] >= tile.y1) continue;    // tile is at the border of the image or not a power of 2
+        if (!filter(x[n], y[n])) continue;
+        n++;
+    }
+    return n;
+}
+
+size_t RayTracer::curve_length(void) const noexcept
+{
+    // edge length of the Morton-curve that covers a whole tile (next power of 2)
+    size_t curve_size = 1;
+    while (curve_size < this->_tile_size) curve_size <<= 1;
+    return curve_size * curve_size;
+}
+
+void RayTracer::init_batch(batch_t& batch) const
+{
+    // padded to a whole packet, the packet ray generation shader may write every lane
+    const size_t n = this->curve_length() + RT_RAY_PACKET_SIZE;
+    batch.x.assign(n, 0);
+    batch.y.assign(n, 0);
+    batch.colors.assign(n, glm::vec3(0.0f));
+    if (this->_backend == RT_BACKEND_WAVEFRONT)
+    {
+        batch.queue[0].reserve(n);
+        batch.queue[1].reserve(n);
+        batch.order.reserve(n);
+        batch.misses.reserve(n);
+        batch.miss_rays.reserve(n);
+        batch.miss_radiance.reserve(n);
+    }
+}
+
+void RayTracer::render_pixels(batch_t& batch, uint32_t n, bool accumulate)
+{
+    const uint32_t* x = batch.x.data();
+    const uint32_t* y = batch.y.data();
+    glm::vec3* colors = batch.colors.data();
+
+    if (this->_backend == RT_BACKEND_WAVEFRONT)
+    {
+        this->trace_wavefront(batch, n);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < n; i += RT_RAY_PACKET_SIZE)
+        {
+            const uint32_t n_packet = std::min(n - i, RT_RAY_PACKET_SIZE);
+            this->ray_generation_shader_packet(x + i, y + i, (1 << n_packet) - 1, colors + i);
+        }
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (accumulate)
+        {
+            // every pixel belongs to one tile only, no synchronization is needed
+            const size_t p = (size_t)y[i] * this->_fbo.width() + x[i];
+            const float lum = luminance(colors[i]);
+            const float mean = (this->_sample_count[p] > 0) ? luminance(this->_accum[p]) / (float)this->_sample_count[p] : 0.0f;
+
+            this->_accum[p] += colors[i];
+            this->_sample_count[p]++;
+
+            // Welford's online algorithm for the variance of the luminance
+            const float delta = lum - mean;
+            this->_m2[p] += delta * (lum - (mean + delta / (float)this->_sample_count[p]));
+
+            colors[i] = this->_accum[p] / (float)this->_sample_count[p];
+        }
+        this->_fbo.store(x[i], y[i], glm::vec4(colors[i], 1.0f));
+    }
+}
+
+void RayTracer::trace_wavefront(batch_t& batch, uint32_t n)
+{
+    const WavefrontInfo& info = this->_wavefront_info;
+    glm::vec3* colors = batch.colors.data();
+    RayQueue* queue = &batch.queue[0];
+    RayQueue* next = &batch.queue[1];
+
+    // generation stage: one path per pixel
+    queue->clear();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ray_t ray;
+        glm::vec3 weight(1.0f);
+        colors[i] = glm::vec3(0.0f);
+        if (this->wavefront_ray_generation_shader(batch.x[i], batch.y[i], ray, weight))
+            queue->push(ray, weight, i);
+    }
+
+    for (uint32_t depth = 0; depth < info.max_depth && queue->size() > 0; depth++)
+    {
+        // the secondary rays go into any direction, sorting them makes the rays of a packet coherent
+        // again and the intersection and miss stages access the memory in a more coherent order
+        if (depth > 0 && info.sort_rays)
+        {
+            const size_t n_packets = (queue->size() + RT_RAY_PACKET_SIZE - 1) / RT_RAY_PACKET_SIZE;
+            batch.sort_stats.sorted_rays += queue->size();
+            batch.sort_stats.packets += n_packets;
+            batch.sort_stats.coherent_before += queue->coherent_packets();
+            queue->sort(*next, batch.order);
+            std::swap(queue, next);
+            batch.sort_stats.coherent_after += queue->coherent_packets();
+        }
+
+        // intersection stage: the whole queue is intersected packet by packet
+        queue->reset_hits(info.t_max);
+        for (size_t i = 0; i < queue->size(); i += RT_RAY_PACKET_SIZE)
+        {
+            ray_packet_t packet;
+            const uint32_t mask = queue->load_packet(i, packet);
+            this->intersection_packet(packet, mask, info.cull_mask, queue->t() + i, queue->hit_info() + i, queue->hit_prim() + i);
+        }
+
+        // miss stage, the hits are collected for the shading stage and the misses are shaded at once
+        batch.order.clear();
+        batch.misses.clear();
+        batch.miss_rays.clear();
+        for (size_t i = 0; i < queue->size(); i++)
+        {
+            if (queue->t()[i] < info.t_max)
+                batch.order.push_back(std::make_pair(this->material_key(queue->hit_prim()[i]), (uint32_t)i));
+            else
+            {
+                batch.misses.push_back((uint32_t)i);
+                batch.miss_rays.push_back(queue->ray(i));
+            }
+        }
+        if (!batch.misses.empty())
+        {
+            batch.miss_radiance.resize(batch.misses.size());
+            this->wavefront_miss_shader_n(batch.miss_rays.data(), batch.miss_rays.size(), depth, batch.miss_radiance.data());
+            for (size_t i = 0; i < batch.misses.size(); i++)
+                colors[queue->pixel(batch.misses[i])] += queue->weight(batch.misses[i]) * batch.miss_radiance[i];
+        }
+
+        // shading stage: the hits are shaded grouped by their material, the paths that continue
+        // are written into the queue of the next bounce, which removes the terminated paths
+        std::sort(batch.order.begin(), batch.order.end());
+        next->clear();
+        for (const std::pair<uint64_t, uint32_t>& hit : batch.order)
+        {
+            const uint32_t i = hit.second;
+            const glm::vec3 weight = queue->weight(i);
+            glm::vec3 emitted(0.0f), attenuation(1.0f);
+            ray_t next_ray;
+            const bool next_bounce = this->wavefront_closest_hit_shader(queue->ray(i), depth, queue->t()[i], queue->hit_prim()[i], queue->hit_info()[i], emitted, attenuation, next_ray);
+
+            colors[queue->pixel(i)] += weight * emitted;
+            if (next_bounce)
+                next->push(next_ray, weight * attenuation, queue->pixel(i));
+        }
+        std::swap(queue, next);
+    }
+}
+
+void RayTracer::merge_batch(const batch_t& batch)
+{
+    #pragma omp critical
+    {
+        this->_sort_stats.sorted_rays += batch.sort_stats.sorted_rays;
+        this->_sort_stats.packets += batch.sort_stats.packets;
+        this->_sort_stats.coherent_before += batch.sort_stats.coherent_before;
+        this->_sort_stats.coherent_after += batch.sort_stats.coherent_after;
+    }
+}
+
+void RayTracer::render_pass(bool accumulate)
 {
     omp_set_num_threads(this->_n_threads);
-    uint8_t* map = this->_fbo.map_rdwr();
 
-    #pragma omp parallel for
-    for (uint32_t y = 0; y < this->_fbo.height(); y++)
+    TileScheduler scheduler;
+    scheduler.init(this->_fbo.width(), this->_fbo.height(), this->_tile_size, this->_n_threads);
+    const size_t curve_length = this->curve_length();
+
+    #pragma omp parallel
     {
-        for (uint32_t x = 0; x < this->_fbo.width(); x++)
+        const uint32_t thread_id = (uint32_t)omp_get_thread_num();
+        batch_t batch;
+        this->init_batch(batch);
+
+        tile_t tile;
+        while (scheduler.next(thread_id, tile))
+        {
+            const uint32_t n = collect_tile(tile, curve_length, [](uint32_t, uint32_t) { return true; }, batch.x.data(), batch.y.data());
+            this->render_pixels(batch, n, accumulate);
+        }
+        this->merge_batch(batch);
+    }
+}
+
+float RayTracer::sample_error(size_t p) const noexcept
+{
+    const uint32_t n = this->_sample_count[p];
+    if (n < 2) return std::numeric_limits<float>::infinity();
+
+    // standard error of the mean luminance, relative to 1 + mean: absolute for dark pixels, relative for bright pixels
+    const float mean = luminance(this->_accum[p]) / (float)n;
+    const float std_error = std::sqrt(this->_m2[p] / (float)(n - 1) / (float)n);
+    return std_error / (1.0f + mean);
+}
+
+uint64_t RayTracer::run_adaptive(const AdaptiveSamplingInfo& info)
+{
+    this->update_acceleration_structure();
+
+    if (this->_accum.size() != this->_fbo.count())
+        this->reset_accumulation();
+
+    omp_set_num_threads(this->_n_threads);
+
+    TileScheduler scheduler;
+    scheduler.init(this->_fbo.width(), this->_fbo.height(), this->_tile_size, this->_n_threads);
+    const size_t curve_length = this->curve_length();
+    const uint32_t min_samples = std::max(info.min_samples, 2u);    // the variance needs 2 samples at least
+    const uint32_t max_samples = std::max(info.max_samples, min_samples);
+    const uint32_t width = this->_fbo.width();
+    uint64_t n_samples = 0;
+
+    #pragma omp parallel reduction(+ : n_samples)
+    {
+        const uint32_t thread_id = (uint32_t)omp_get_thread_num();
+        batch_t batch;
+        this->init_batch(batch);
+
+        tile_t tile;
+        while (scheduler.next(thread_id, tile))
         {
-            const size_t idx = this->_fbo.combute_index({ x, y });
-            this->cvt_to_uint8(ray_generation_shader(x, y), map[idx + 0], map[idx + 1], map[idx + 2]);
+            // every round samples the pixels of the tile whose error is still above the threshold
+            const auto unconverged = [&](uint32_t x, uint32_t y)
+            {
+                const size_t p = (size_t)y * width + x;
+                const uint32_t n = this->_sample_count[p];
+                return n < min_samples || (n < max_samples && this->sample_error(p) > info.threshold);
+            };
+            for (uint32_t n = collect_tile(tile, curve_length, unconverged, batch.x.data(), batch.y.data()); n > 0;
+                          n = collect_tile(tile, curve_length, unconverged, batch.x.data(), batch.y.data()))
+            {
+                this->render_pixels(batch, n, true);
+                n_samples += n;
+            }
         }
+        this->merge_batch(batch);
     }
+    return n_samples;
 }
 
 void RayTracer::set_framebuffer(const ImageCreateInfo& ci) noexcept
@@ -100,8 +476,14 @@ void RayTracer::set_framebuffer(const ImageCreateInfo& ci) noexcept
 
     // reallocate image memory if create info changes
     this->_fbo.free();
-    this->_fbo.set_create_info({ci.width, ci.height, 0, 3}); // framebuffer contains only RGB (3 color channels)
+    this->_fbo.set_create_info(ci);  // the channel count is defined by the pixel format
     this->_fbo.create();
+
+    // the accumulated samples belong to the old framebuffer
+    this->_accum.clear();
+    this->_sample_count.clear();
+    this->_m2.clear();
+    this->_pass = 0;
 }
 
 const Framebuffer& RayTracer::get_framebuffer(void) const noexcept
@@ -111,24 +493,52 @@ const Framebuffer& RayTracer::get_framebuffer(void) const noexcept
 
 void RayTracer::clear_color(float r, float g, float b)
 {
-    uint8_t* map = this->_fbo.map_rdwr();
     for (uint32_t y = 0; y < this->_fbo.height(); y++)
     {
         for (uint32_t x = 0; x < this->_fbo.width(); x++)
-        {
-            const size_t idx = this->_fbo.combute_index({ x, y });
-            uint8_t _r, _g, _b;
-            this->cvt_to_uint8({ r, g, b }, map[idx + 0], map[idx + 1], map[idx + 2]);
-        }
+            this->_fbo.store(x, y, glm::vec4(r, g, b, 1.0f));
     }
 }
 
 void RayTracer::draw_buffer(const Buffer& buff)
 {
-    this->_cmd_buff.push_back(buff);
+    this->_cmd_buff.push_back(buff);    // shares the primitives, no copy is made
+}
+
+void RayTracer::draw_buffer(const GeometryBuffer& buff)
+{
+    this->_geometry_buff.push_back(buff.clone_dynamic());  // the clone shares the primitives if the buffer supports it
+}
+
+void RayTracer::clear_draw_buffers(void) noexcept
+{
+    this->_cmd_buff.clear();
+    for (GeometryBuffer* buff : this->_geometry_buff)
+        delete buff;
+    this->_geometry_buff.clear();
 }
 
 void RayTracer::set_num_threads(uint32_t n_threads) noexcept
 {
     this->_n_threads = (n_threads > 0) ? n_threads : this->_n_threads;
+}
+
+void RayTracer::set_tile_size(uint32_t tile_size) noexcept
+{
+    this->_tile_size = (tile_size > 0) ? std::min(tile_size, RT_MAX_TILE_SIZE) : this->_tile_size;
+}
+
+void RayTracer::set_backend(RenderBackend backend) noexcept
+{
+    this->_backend = backend;
+}
+
+void RayTracer::set_wavefront_info(const WavefrontInfo& info) noexcept
+{
+    this->_wavefront_info = info;
+}
+
+void RayTracer::reset_ray_sort_statistics(void) noexcept
+{
+    this->_sort_stats = RaySortStatistics();
 }
\ No newline at end of file
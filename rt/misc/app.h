@@ -12,6 +12,11 @@
 #pragma once
 
 #include "buffer.h"
+#include "bvh.h"
+#include "sphere_buffer.h"
+#include "typed_buffer.h"
+#include "tile_scheduler.h"
+#include "ray_queue.h"
 #include "../image/framebuffer.h"
 #include <vector>
 
@@ -33,8 +38,60 @@ namespace rt
         float _rt_ratio;                // screen aspect ratio
         int32_t _rt_pixels;             // number of pixels the framebuffer has
         std::vector<Buffer> _cmd_buff;  // command buffer for drawing
+        std::vector<GeometryBuffer*> _geometry_buff;    // clones of the geometry buffers that are drawn next to the command buffer
+        BVH _bvh;                       // acceleration structure over the primitives of the command buffer
+        std::vector<uint64_t> _bvh_revisions;   // revisions of the command buffer the acceleration structure was built from
         Framebuffer _fbo;               // framebuffer where the pixels get stored
         uint32_t _n_threads;            // number of threads used for rendering
+        uint32_t _tile_size;            // edge length of the tiles the threads render
+        std::vector<glm::vec3> _accum;          // sum of the colors of every pixel of the progressive passes
+        std::vector<uint32_t> _sample_count;    // number of samples of every pixel of the progressive passes
+        std::vector<float> _m2;                 // sum of the squared differences to the mean luminance of every pixel
+        uint32_t _pass;                         // number of progressive passes rendered so far
+        RenderBackend _backend;                 // how the rays of a pixel are traced
+        WavefrontInfo _wavefront_info;          // settings of the wavefront backend
+        RaySortStatistics _sort_stats;          // coherence of the secondary rays of the wavefront backend
+
+        // memory of a render thread, it is reused for every tile
+        struct batch_t
+        {
+            std::vector<uint32_t> x, y;         // pixels of the tile that are rendered
+            std::vector<glm::vec3> colors;      // colors of the pixels
+            RayQueue queue[2];                  // rays of the current and the next bounce (wavefront backend)
+            std::vector<std::pair<uint64_t, uint32_t>> order;   // sort key and position of every ray or hit (wavefront backend)
+            std::vector<uint32_t> misses;       // positions of the rays that missed (wavefront backend)
+            std::vector<ray_t> miss_rays;       // rays that missed (wavefront backend)
+            std::vector<glm::vec3> miss_radiance;   // radiance of the rays that missed (wavefront backend)
+            RaySortStatistics sort_stats;       // coherence of the secondary rays that were sorted by the thread
+        };
+
+        // rebuilds the acceleration structure if the command buffer has changed since the last build
+        void update_acceleration_structure(void);
+
+        // number of Morton-codes that cover a whole tile
+        size_t curve_length(void) const noexcept;
+
+        // allocates the memory of a render thread
+        void init_batch(batch_t& batch) const;
+
+        // renders one sample for the first @param n pixels of the batch, the colors are averaged with the previous samples if @param accumulate is true
+        void render_pixels(batch_t& batch, uint32_t n, bool accumulate);
+
+        // renders the first @param n pixels of the batch with the wavefront backend
+        void trace_wavefront(batch_t& batch, uint32_t n);
+
+        // adds the statistics of a render thread to the statistics of the ray tracer
+        void merge_batch(const batch_t& batch);
+
+        // renders one sample for every pixel, the colors are averaged with the previous samples if @param accumulate is true
+        void render_pass(bool accumulate);
+
+        // estimated error of the accumulated color of the pixel @param p
+        float sample_error(size_t p) const noexcept;
+
+        // luminance of a linear RGB color
+        static inline float luminance(const glm::vec3& c) noexcept
+        {return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;}
 
         /**
          *  @brief Tests if a ray intersects with a primitive in the scene..
@@ -48,19 +105,18 @@ namespace rt
         float intersection(const rt::ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const rt::Primitive** hit_prim);
 
         /**
-        *   @brief Converts floating-point color to uint8_t-color value.
-        *   @param[in] v: floating-point color vector
-        *   @param[out] r: red in uint8_t
-        *   @param[out] g: green in uint8_t
-        *   @param[out] b: blue in uint8_t
-        */
-        inline void cvt_to_uint8(const glm::vec3& v, uint8_t& r, uint8_t& g, uint8_t& b)
-        {
-            glm::vec3 _v = v * 255.0f;
-            r = (_v.r > 255.0) ? 255 : (uint8_t)_v.r;
-            g = (_v.g > 255.0) ? 255 : (uint8_t)_v.g;
-            b = (_v.b > 255.0) ? 255 : (uint8_t)_v.b;
-        }
+         *  @brief Tests if the rays of a ray packet intersect with a primitive in the scene.
+         *  @param[in] packet: The rays that are tested if they intersect with a primitive.
+         *  @param[in] mask: Bit i is set if the ray i is active.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[in, out] t: The maximum length of every ray, returns the length to the closest intersection point.
+         *  @param[out] hit_info: Information about the ray-hits.
+         *  @param[out] hit_prim: The primitives that the rays intersected with.
+         */
+        void intersection_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim);
+
+        // forwards the hits of an occlusion query to the any hit shader, @param user_data is the ray tracer
+        static bool any_hit(void* user_data, const ray_t& ray, float t, const Primitive* hit_prim, RayHitInformation hit_info);
 
     protected:
         /** @return The pixel-dimensions of the framebuffer. */
@@ -75,6 +131,21 @@ namespace rt
         inline int32_t rt_pixels(void) noexcept
         {return this->_rt_pixels;}
 
+        /**
+         *  @return The index of the current progressive pass (0 for the first pass and for run()).
+         *  Shaders can use it to choose a different sample position in every pass.
+         */
+        inline uint32_t rt_pass(void) const noexcept
+        {return this->_pass;}
+
+        /**
+         *  @return The number of samples that are accumulated for the pixel (x, y) so far.
+         *  With run_adaptive the pixels have different sample counts, shaders can use it
+         *  instead of rt_pass() to choose a different sample position for every sample.
+         */
+        inline uint32_t rt_sample_count(uint32_t x, uint32_t y) const noexcept
+        {return this->_sample_count.empty() ? 0 : this->_sample_count[(size_t)y * this->_fbo.width() + x];}
+
         /** @return The whole scene-geometry. Can be multiple primitive-buffers. */
         inline const Buffer* rt_geometry(void) noexcept
         {return this->_cmd_buff.data();}
@@ -93,6 +164,41 @@ namespace rt
          */
         void trace_ray(const ray_t& ray, int recursions, float t_max, RayCullMask cull_mask, void* ray_payload);
 
+        /**
+         *  @brief Begins the ray-tracing process for a packet of rays.
+         *  The closest intersections of all rays are searched at once, afterwards the closest hit shader
+         *  or the miss shader is called for every active ray.
+         *  @param[in] packet: Rays to be traced.
+         *  @param[in] mask: Bit i is set if the ray i is active. Inactive rays (e.g. terminated rays) are ignored.
+         *  @param[in] recursions: The number of recursions to be called.
+         *  @param[in] t_max: Maximum length the rays are allowed to have.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[out] ray_payloads: Ray tracing payload of every ray.
+         */
+        void trace_ray_packet(const ray_packet_t& packet, uint32_t mask, int recursions, float t_max, RayCullMask cull_mask, void** ray_payloads);
+
+        /**
+         *  @brief Tests if a ray hits any primitive within its maximum length (e.g. for shadow rays).
+         *  Unlike trace_ray, the closest intersection is not searched. The search stops at the first hit
+         *  that is accepted by the any hit shader, no closest hit- or miss shader is called.
+         *  @param[in] ray: Ray to be tested.
+         *  @param[in] t_max: Maximum length the ray is allowed to have.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @return True if the ray is occluded.
+         */
+        bool trace_occlusion(const ray_t& ray, float t_max, RayCullMask cull_mask);
+
+        /**
+         *  @brief Calculates the distance from a point to the closest primitive of the scene (e.g. for sphere tracing).
+         *  The primitives of the command buffer are searched with the acceleration structure,
+         *  so not every primitive is visited. The geometry buffers are searched afterwards.
+         *  @param[in] p: Point from where the distance is calculated.
+         *  @param[in] d_max: Maximum distance, primitives that are further away are ignored.
+         *  @param[out] hit_prim: The closest primitive, can be nullptr.
+         *  @return The distance to the closest primitive, caps at @param d_max.
+         */
+        float scene_distance(const glm::vec3& p, float d_max, const Primitive** hit_prim);
+
         /**
          *  @brief This shader gets called for every pixel and is used calculate
          *  the final color of the current pixel. It is also used to invoke 
@@ -103,6 +209,17 @@ namespace rt
          */
         virtual glm::vec3 ray_generation_shader(uint32_t x, uint32_t y) = 0;
 
+        /**
+         *  @brief This shader gets called for a packet of neighbouring pixels and is used to calculate
+         *  the final colors of the pixels. Overwrite it to generate and trace ray packets with trace_ray_packet.
+         *  By default it calls the ray generation shader for every active pixel.
+         *  @param[in] x: X coordinates of the pixels, RT_RAY_PACKET_SIZE elements.
+         *  @param[in] y: Y coordinates of the pixels, RT_RAY_PACKET_SIZE elements.
+         *  @param[in] mask: Bit i is set if the pixel i is active.
+         *  @param[out] colors: Colors of the pixels, RT_RAY_PACKET_SIZE elements.
+         */
+        virtual void ray_generation_shader_packet(const uint32_t* x, const uint32_t* y, uint32_t mask, glm::vec3* colors);
+
         /**
          *  @brief This shader gets called if there is an intersection with a sphere.
          *  @param[in] ray: The ray that was traced to that intersction.
@@ -115,6 +232,81 @@ namespace rt
          */
         virtual void closest_hit_shader(const ray_t& ray, int recursion, float t, float t_max, const Primitive* hit, RayHitInformation hit_info, void* ray_payload) = 0;
 
+        /**
+         *  @brief This callback gets called after every pass of run_progressive, the framebuffer
+         *  contains the average of all passes so far and can be displayed or saved.
+         *  @param[in] pass: Number of passes that are accumulated in the framebuffer.
+         *  @param[in] n_passes: Number of passes run_progressive was called with.
+         *  @return False to stop rendering, by default true is returned.
+         */
+        virtual bool pass_callback(uint32_t pass, uint32_t n_passes);
+
+        /**
+         *  @brief This shader gets called for every hit of an occlusion query (trace_occlusion).
+         *  The hits are not sorted by their distance. By default every hit is accepted.
+         *  @param[in] ray: The ray that is tested for occlusion.
+         *  @param[in] t: The length of the vector from origin to the intersection.
+         *  @param[in] hit: The primitive that the ray intersected with.
+         *  @param[in] hit_info: Information about the ray-hit.
+         *  @return True to accept the hit and terminate the query, false to ignore the hit (e.g. cut-outs).
+         */
+        virtual bool any_hit_shader(const ray_t& ray, float t, const Primitive* hit, RayHitInformation hit_info);
+
+        /**
+         *  @brief Ray generation stage of the wavefront backend (see set_backend), gets called for every pixel.
+         *  Unlike the ray generation shader it does not trace the ray, it only generates it. The ray is
+         *  traced together with the rays of the other pixels of the tile. By default no ray is generated.
+         *  @param[in] x: X coordinate of the pixel.
+         *  @param[in] y: Y coordinate of the pixel.
+         *  @param[out] ray: The primary ray of the pixel.
+         *  @param[in, out] weight: Weight of the radiance the ray gathers, initialized with 1.
+         *  @return False if the pixel does not generate a ray, the pixel is black.
+         */
+        virtual bool wavefront_ray_generation_shader(uint32_t x, uint32_t y, ray_t& ray, glm::vec3& weight);
+
+        /**
+         *  @brief Shading stage of the wavefront backend, gets called for every ray that hits a primitive.
+         *  The hits of a bounce are shaded grouped by their material (see material_key).
+         *  Instead of tracing a secondary ray recursively, the shader returns the ray of the next bounce.
+         *  @param[in] ray: The ray that was traced to that intersection.
+         *  @param[in] depth: Bounce of the ray, 0 for the primary rays.
+         *  @param[in] t: The length of the vector from origin to the intersection.
+         *  @param[in] hit: The primitive that the ray intersected with.
+         *  @param[in] hit_info: Information about the ray-hit.
+         *  @param[out] emitted: Radiance that is added to the pixel, it is multiplied with the weight of the ray. Initialized with 0.
+         *  @param[out] attenuation: Factor the weight of the next ray is multiplied with. Initialized with 1.
+         *  @param[out] next_ray: Ray of the next bounce.
+         *  @return True if the path continues with @param next_ray. By default the path is terminated.
+         */
+        virtual bool wavefront_closest_hit_shader(const ray_t& ray, uint32_t depth, float t, const Primitive* hit, RayHitInformation hit_info, glm::vec3& emitted, glm::vec3& attenuation, ray_t& next_ray);
+
+        /**
+         *  @brief Miss stage of the wavefront backend, gets called for every ray that does not hit any primitive.
+         *  @param[in] ray: The ray that was traced into the void.
+         *  @param[in] depth: Bounce of the ray, 0 for the primary rays.
+         *  @return Radiance that is added to the pixel, it is multiplied with the weight of the ray. By default 0.
+         */
+        virtual glm::vec3 wavefront_miss_shader(const ray_t& ray, uint32_t depth);
+
+        /**
+         *  @brief Miss stage of the wavefront backend for all rays of a bounce that do not hit any primitive.
+         *  Gets called once per bounce, so the shader can process the rays in batches (e.g. with simd instructions).
+         *  By default wavefront_miss_shader() is called for every ray.
+         *  @param[in] rays: The rays that were traced into the void.
+         *  @param[in] n: Number of rays.
+         *  @param[in] depth: Bounce of the rays, 0 for the primary rays.
+         *  @param[out] radiance: Radiance of every ray, it is multiplied with the weight of the ray.
+         */
+        virtual void wavefront_miss_shader_n(const ray_t* rays, size_t n, uint32_t depth, glm::vec3* radiance);
+
+        /**
+         *  @brief Key the hits of the wavefront backend are grouped by before shading.
+         *  By default the hits are grouped by the address of the attribute of the primitive.
+         *  @param[in] hit: The primitive that was hit.
+         *  @return Key of the material of the primitive.
+         */
+        virtual uint64_t material_key(const Primitive* hit);
+
         /**
          *  @brief This shader gets called if there is no intersection with any object in the scene.
          *  @param[in] ray: The ray that was traced into the void.
@@ -139,12 +331,47 @@ namespace rt
          *  @brief Effectively runs the ray-tracing application.
          *  Processes the color for every pixel and stores the resulting color into
          *  the framebuffer. Additionally it provides the NDC coordinates for the ray generation shader.
+         *  The framebuffer is split into square tiles that are distributed to the threads with work
+         *  stealing. The pixels of a tile are processed in Morton-order (Z-curve) and are passed to
+         *  the packet ray generation shader in groups of RT_RAY_PACKET_SIZE.
+         *  The colors are written unclamped into the framebuffer, for HDR formats no tonemapping
+         *  is applied. Tonemapping is a post-pass on the framebuffer (e.g. rt::ImageWriter::tonemap).
          */
         void run(void);
 
+        /**
+         *  @brief Runs the ray-tracing application progressively.
+         *  Every pass renders one more sample for every pixel and the framebuffer is updated with
+         *  the average of all samples so far, so the image is valid after every pass.
+         *  The samples are accumulated in a floating-point buffer across multiple calls, until
+         *  reset_accumulation() is called or the framebuffer changes.
+         *  @param[in] n_passes: Number of passes to render.
+         */
+        void run_progressive(uint32_t n_passes);
+
+        /**
+         *  @brief Runs the ray-tracing application with adaptive sampling.
+         *  Every pixel gets at least info.min_samples samples. Afterwards additional samples are only
+         *  rendered for pixels whose estimated error is above info.threshold, until the pixel has
+         *  info.max_samples samples. The error is the standard error of the mean luminance divided
+         *  by 1 + the mean luminance. The tiles are refined independently by the threads.
+         *  The samples are accumulated together with the samples of run_progressive.
+         *  @param[in] info: Parameters of the adaptive sampling.
+         *  @return The number of samples that were rendered.
+         */
+        uint64_t run_adaptive(const AdaptiveSamplingInfo& info);
+
+        /** @brief Discards the samples of the previous progressive passes. */
+        void reset_accumulation(void);
+
+        /** @return The number of progressive passes that are accumulated. */
+        inline uint32_t get_pass_count(void) const noexcept
+        {return this->_pass;}
+
         /**
          *  @brief Sets the create info for the internal frame-buffer.
          *  The image data will be written into the framebuffer object.
+         *  The pixel format is set by the format field of the create info, the channel count is ignored.
          *  NOTE: Frame-buffer gets reallocated if this method is called twice!
          *  @param[in] ci: The framebuffer to attach.
          */
@@ -167,10 +394,24 @@ namespace rt
 
         /**
          *  @brief Adds a draw buffer to the comand buffer.
+         *  The buffer is not duplicated, the ray tracer shares the primitives with it (see rt::Buffer).
+         *  Re-submitting an unchanged buffer does not rebuild the acceleration structure.
          *  @param buff: Buffer to draw.
          */
         void draw_buffer(const Buffer& buff);
 
+        /**
+         *  @brief Adds a geometry buffer (e.g. rt::SphereBuffer) to the draw list.
+         *  Geometry buffers are tested after the primitive buffers of the command buffer.
+         *  The ray tracer draws a clone of the buffer (see GeometryBuffer::clone_dynamic), the clones of
+         *  rt::SphereBuffer and rt::TypedBuffer share the primitives with it and are not duplicated.
+         *  @param buff: Geometry buffer to draw.
+         */
+        void draw_buffer(const GeometryBuffer& buff);
+
+        /** @brief Removes every buffer from the comand buffer and the geometry buffers from the draw list. */
+        void clear_draw_buffers(void) noexcept;
+
         /**
          *  @brief Sets the number of threads the ray tracer uses for rendering.
          *  @param n_threads: Number of threads.
@@ -180,5 +421,50 @@ namespace rt
         /** @return The number of threads used for rendering. */
         inline uint32_t get_num_threads(void) const noexcept
         {return this->_n_threads;}
+
+        /**
+         *  @brief Sets the edge length of the tiles the threads render.
+         *  @param tile_size: Edge length of a tile in pixels, it is clamped to RT_MAX_TILE_SIZE.
+         */
+        void set_tile_size(uint32_t tile_size) noexcept;
+
+        /** @return The edge length of the tiles in pixels. */
+        inline uint32_t get_tile_size(void) const noexcept
+        {return this->_tile_size;}
+
+        /**
+         *  @brief Sets how the rays are traced.
+         *  RT_BACKEND_RECURSIVE: The ray generation shader is called for every pixel and the closest hit
+         *  shader traces the secondary rays recursively with trace_ray (default).
+         *  RT_BACKEND_WAVEFRONT: The rays of all pixels of a tile are stored in a queue and every stage
+         *  (generation, intersection, miss, shading) is run for the whole queue at once. The shading stage
+         *  writes the rays of the next bounce into a new queue, until the queue is empty or the maximum depth
+         *  is reached. The wavefront_* shaders are called instead of the recursive shaders.
+         *  If WavefrontInfo::sort_rays is set, the secondary rays are sorted by their direction and origin
+         *  before they are intersected, see get_ray_sort_statistics().
+         *  The backend is used by run, run_progressive and run_adaptive.
+         *  @param backend: The backend.
+         */
+        void set_backend(RenderBackend backend) noexcept;
+
+        /** @return The backend that traces the rays. */
+        inline RenderBackend get_backend(void) const noexcept
+        {return this->_backend;}
+
+        /**
+         *  @brief Sets the settings of the wavefront backend.
+         *  @param info: Maximum depth, maximum ray length and culling of the rays.
+         */
+        void set_wavefront_info(const WavefrontInfo& info) noexcept;
+
+        /**
+         *  @return How much the sorting of the secondary rays (WavefrontInfo::sort_rays) increased the
+         *  number of coherent ray packets. The statistics are summed up until reset_ray_sort_statistics() is called.
+         */
+        inline const RaySortStatistics& get_ray_sort_statistics(void) const noexcept
+        {return this->_sort_stats;}
+
+        /** @brief Resets the statistics of the ray sorting. */
+        void reset_ray_sort_statistics(void) noexcept;
     };
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+/**
+* @file     arena.cpp
+* @brief    Implementation of the arena allocator.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "arena.h"
+#include <cstdlib>
+#include <utility>
+
+using namespace rt;
+
+Arena::Arena(size_t block_size) noexcept
+{
+    this->_offset = 0;
+    this->_block_size = (block_size > 0) ? block_size : DEFAULT_BLOCK_SIZE;
+    this->_used = 0;
+}
+
+Arena::Arena(Arena&& arena) noexcept : Arena()
+{
+    *this = std::move(arena);
+}
+
+Arena& Arena::operator= (Arena&& arena) noexcept
+{
+    this->release();
+    this->_blocks = std::move(arena._blocks);
+    this->_offset = arena._offset;
+    this->_block_size = arena._block_size;
+    this->_used = arena._used;
+
+    arena._blocks.clear();
+    arena._offset = 0;
+    arena._used = 0;
+    return *this;
+}
+
+Arena::~Arena(void)
+{
+    this->release();
+}
+
+bool Arena::add_block(size_t size)
+{
+    block_t block;
+    block.size = (size > this->_block_size) ? size : this->_block_size;
+    block.data = (uint8_t*)malloc(block.size);
+    if (block.data == nullptr)
+        return false;
+
+    this->_blocks.push_back(block);
+    this->_offset = 0;
+    return true;
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    if (!this->_blocks.empty())
+    {
+        const block_t& block = this->_blocks.back();
+        const uintptr_t begin = (uintptr_t)block.data + this->_offset;
+        const uintptr_t aligned = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        const size_t end = this->_offset + (size_t)(aligned - begin) + size;
+        if (end <= block.size)
+        {
+            this->_offset = end;
+            this->_used += size;
+            return (void*)aligned;
+        }
+    }
+
+    // the current block is full, the new block needs space for the worst case alignment
+    if (!this->add_block(size + alignment))
+        return nullptr;
+    return this->allocate(size, alignment);
+}
+
+void Arena::reset(void) noexcept
+{
+    // keep the first block, free the others
+    for (size_t i = 1; i < this->_blocks.size(); i++)
+        free(this->_blocks[i].data);
+    if (this->_blocks.size() > 1)
+        this->_blocks.resize(1);
+    this->_offset = 0;
+    this->_used = 0;
+}
+
+void Arena::release(void) noexcept
+{
+    for (const block_t& block : this->_blocks)
+        free(block.data);
+    this->_blocks.clear();
+    this->_offset = 0;
+    this->_used = 0;
+}
+
+size_t Arena::capacity(void) const noexcept
+{
+    size_t n = 0;
+    for (const block_t& block : this->_blocks)
+        n += block.size;
+    return n;
+}
@@ -0,0 +1,81 @@
+/**
+* @file     arena.h
+* @brief    Arena allocator that places many small objects contiguously in large memory blocks.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rt
+{
+    /**
+     *  The arena allocates memory by bumping a pointer inside of large blocks.
+     *  Single allocations can not be freed, instead the whole arena is released at once.
+     *  The arena does not call any destructor, objects that are placed into the arena
+     *  must be destroyed by the owner of the arena.
+     *  But keep in mind that the arena is not thread save.
+     */
+    class Arena
+    {
+    private:
+        struct block_t
+        {
+            uint8_t* data;
+            size_t size;
+        };
+
+        std::vector<block_t> _blocks;   // allocated memory blocks, the last block is the current one
+        size_t _offset;                 // offset to the free memory of the current block
+        size_t _block_size;             // size of a new block
+        size_t _used;                   // number of bytes that are allocated by the user
+
+        // allocates a new block that can hold at least @param size bytes
+        bool add_block(size_t size);
+
+    public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+        /** @param[in] block_size: Size of the memory blocks in bytes. */
+        explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE) noexcept;
+
+        Arena(const Arena&) = delete;
+        Arena& operator= (const Arena&) = delete;
+        Arena(Arena&& arena) noexcept;
+        Arena& operator= (Arena&& arena) noexcept;
+
+        virtual ~Arena(void);
+
+        /**
+         *  @brief Allocates memory within the arena.
+         *  @param[in] size: Number of bytes to allocate.
+         *  @param[in] alignment: Alignment of the memory, must be a power of 2.
+         *  @return Pointer to the allocated memory or nullptr if there is no memory left.
+         */
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        /**
+         *  @brief Releases every allocation at once. The first block is kept,
+         *  so that refilling the arena does not need to allocate again.
+         */
+        void reset(void) noexcept;
+
+        /** @brief Frees all memory blocks of the arena. */
+        void release(void) noexcept;
+
+        /** @return The number of bytes that are allocated by the user. */
+        inline size_t size(void) const noexcept
+        {return this->_used;}
+
+        /** @return The number of bytes that are reserved by the arena. */
+        size_t capacity(void) const noexcept;
+    };
+}
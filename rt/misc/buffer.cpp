@@ -11,13 +11,48 @@
 
 
 #include "buffer.h"
-#include <malloc.h>
+#include <atomic>
 
 using namespace rt;
 
+Buffer::storage_t::~storage_t(void)
+{
+    for(size_t i = 0; i < this->buff.size(); i++)
+        this->destroy(i);
+}
+
+void Buffer::storage_t::allocate(void)
+{
+    for(size_t i = this->layout_info.size; i < this->buff.size(); i++)   // clear memory that would be out of bounds
+        this->destroy(i);
+    this->buff.resize(this->layout_info.size, nullptr);                 // resize buffer, new elements are nullptr
+    this->in_arena.resize(this->layout_info.size, false);
+}
+
+void Buffer::storage_t::set(size_t pos, const Primitive* prim)
+{
+    this->destroy(pos);                                         // delete actual primitive that is at this position
+    if(prim != nullptr)
+    {
+        this->buff[pos] = prim->clone_arena(this->arena);       // copy primitive to this position.
+        this->in_arena[pos] = (this->buff[pos] != nullptr);
+        if(!this->in_arena[pos])                                // primitive does not support arenas
+            this->buff[pos] = const_cast<Primitive*>(prim)->clone_dynamic();
+    }
+}
+
+void Buffer::storage_t::destroy(size_t pos) noexcept
+{
+    if(this->buff[pos] == nullptr) return;
+    if(this->in_arena[pos])     this->buff[pos]->~Primitive();  // memory belongs to the arena
+    else                        delete(this->buff[pos]);
+    this->buff[pos] = nullptr;
+    this->in_arena[pos] = false;
+}
+
 Buffer::Buffer(void)
 {
-    this->_layout_info  = BufferLayout();
+    // the storage is created when the buffer is modified the first time
 }
 
 Buffer::Buffer(const BufferLayout& layout_info) : Buffer()
@@ -32,96 +67,126 @@ Buffer::Buffer(const Buffer& buff)
 
 Buffer& Buffer::operator= (const Buffer& buff)
 {
-    this->set_layout(buff._layout_info);                // copy layout information
-    this->clear();                                      // clear own buffer memory
-    for(size_t i = 0; i < buff._layout_info.size; i++)  // copy other instance's memory into own memory    
-    { 
-        if(buff._buff[i] != nullptr)
-            this->_buff[i] = buff._buff[i]->clone_dynamic();
-    }
+    this->_storage = buff._storage;     // share the primitives, they get copied if one of the buffers is modified
     return *this;
 }
 
-Buffer::Buffer(Buffer&& buff)
+Buffer::Buffer(Buffer&& buff) noexcept
 {
     *this = std::move(buff);
 }
 
-Buffer& Buffer::operator= (Buffer&& buff)
+Buffer& Buffer::operator= (Buffer&& buff) noexcept
 {
-    this->set_layout(buff._layout_info);                // copy layout information
-    this->clear();                                      // clear own memory
-    for(size_t i = 0; i < buff._layout_info.size; i++)  // copy other instance's memory into own memory   
-        this->_buff[i] = buff._buff[i]->clone_dynamic();
-    buff.set_layout(BufferLayout());                    // set other instance's layout information to default values, other instance's memory gets cleared automatically
+    this->_storage = std::move(buff._storage);  // other instance is empty afterwards
     return *this;
 }
 
 Buffer::~Buffer(void)
 {
-    this->clear();  // clear all stored primitives
+    // the primitives are deleted by the storage as soon as no buffer references them anymore
+}
+
+uint64_t Buffer::next_revision(void) noexcept
+{
+    static std::atomic<uint64_t> revision(0);
+    return ++revision;
+}
+
+Buffer::storage_t& Buffer::modify(void)
+{
+    if(this->_storage == nullptr)
+    {
+        this->_storage = std::make_shared<storage_t>();
+    }
+    else if(this->_storage.use_count() > 1)
+    {
+        // the primitives are shared, copy them before they are modified
+        std::shared_ptr<storage_t> copy = std::make_shared<storage_t>();
+        copy->layout_info = this->_storage->layout_info;
+        copy->allocate();
+        for(size_t i = 0; i < this->_storage->buff.size(); i++)
+        {
+            if(this->_storage->buff[i] != nullptr)
+                copy->set(i, this->_storage->buff[i]);
+        }
+        this->_storage = std::move(copy);
+    }
+    this->_storage->revision = next_revision();
+    return *this->_storage;
 }
 
 void Buffer::set_layout(const BufferLayout& layout_info)
 {
-    this->_layout_info = layout_info;
-    this->allocate();   // reallocate memory
+    storage_t& storage = this->modify();
+    storage.layout_info = layout_info;
+    storage.allocate();   // reallocate memory
 }
 
 BufferError Buffer::data(size_t pos, Primitive* prim)
 {
-    if(pos >= this->_buff.size())
+    if(pos >= this->layout().size)
         return BufferError::RT_BUFFER_ERROR_OVERFLOW;
 
-    if(this->_buff[pos] != nullptr)
-    {
-        delete(this->_buff[pos]);                    // delete actual primitive that is at this position
-        this->_buff[pos] = nullptr;
-    }
-    if(prim != nullptr)
-        this->_buff[pos] = prim->clone_dynamic();    // copy primitive to this position.
+    this->modify().set(pos, prim);
     return BufferError::RT_BUFFER_ERROR_NONE;
 }
 
 BufferError Buffer::data(size_t begin, size_t count, Primitive* prims)
 {
     const size_t end = begin + count;
+    storage_t& storage = this->modify();
 
     int8_t* _prims = (int8_t*)prims;  // cast to byte pointer
     for(size_t i = begin; i < end; i++)
     {
-        BufferError err = this->data(i, (Primitive*)_prims);
-        if(err != BufferError::RT_BUFFER_ERROR_NONE)
-            return err;
+        if(i >= storage.buff.size())
+            return BufferError::RT_BUFFER_ERROR_OVERFLOW;
+        storage.set(i, (Primitive*)_prims);
 
         _prims += ((Primitive*)_prims)->get_sizeof();
     }
     return BufferError::RT_BUFFER_ERROR_NONE;
 }
 
-void Buffer::allocate(void)
+Primitive** Buffer::map_rdwr(void)
 {
-    const size_t old_size = this->_buff.size();                 // save old size of the buffer
-    this->clearEXT(this->_layout_info.size, old_size);          // clear memory that would be out of bounds
-    this->_buff.resize(this->_layout_info.size);                // resize buffer
-
-    for(size_t i = old_size; i < this->_buff.size(); i++)       // initialize every new element with nullptr
-        this->_buff[i] = nullptr;
+    if(this->_storage == nullptr || this->_storage->buff.size() == 0)
+        return nullptr;
+    return this->modify().buff.data();
 }
 
-void Buffer::clear(void) noexcept
+const BufferLayout& Buffer::layout(void) const noexcept
 {
-    this->clearEXT(0, this->_buff.size());
+    static const BufferLayout empty_layout;
+    return (this->_storage == nullptr) ? empty_layout : this->_storage->layout_info;
 }
 
-void Buffer::clearEXT(size_t begin, size_t end) noexcept
+void Buffer::clear(void)
 {
-    for(size_t i = begin; i < end && i < this->_buff.size(); i++)
+    if(this->_storage == nullptr) return;
+    if(this->_storage.use_count() > 1)
     {
-        if(this->_buff[i] != nullptr)
-        {
-            delete(this->_buff[i]);
-            this->_buff[i] = nullptr;
-        }
+        // do not copy primitives that would be deleted anyway
+        const BufferLayout layout_info = this->_storage->layout_info;
+        this->_storage = std::make_shared<storage_t>();
+        this->_storage->layout_info = layout_info;
+        this->_storage->allocate();
+        this->_storage->revision = next_revision();
+        return;
     }
-}
\ No newline at end of file
+
+    storage_t& storage = this->modify();
+    for(size_t i = 0; i < storage.buff.size(); i++)
+        storage.destroy(i);
+    storage.arena.reset();
+}
+
+void Buffer::clearEXT(size_t begin, size_t end)
+{
+    if(this->_storage == nullptr) return;
+
+    storage_t& storage = this->modify();
+    for(size_t i = begin; i < end && i < storage.buff.size(); i++)
+        storage.destroy(i);
+}
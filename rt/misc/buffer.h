@@ -13,7 +13,9 @@
 #pragma once
 
 #include "rt_error.h"
+#include "arena.h"
 #include "../primitive/primitive.h"
+#include <memory>
 #include <vector>
 
 namespace rt
@@ -21,17 +23,48 @@ namespace rt
     /**
      *  This class stores primitives and can make the internal primitive buffer aviable by
      *  mapping it (read-only or read-write access).
+     *  The primitives and their attributes are placed contiguously into an arena that is
+     *  owned by the buffer, so that loading and clearing the buffer needs almost no allocations.
+     *  Primitives that do not support arenas (see Primitive::clone_arena) are allocated on the heap.
+     *  Copies of a buffer share the same primitives (copy-on-write), copying a buffer is cheap.
+     *  The primitives are only duplicated if a buffer that shares them is modified.
      *  But keep in mind that the buffer is not thread save. If you decide to stream
      *  data into the buffer by a secondary thread, YOU have to make it multithreading-save!
      */
     class Buffer
     {
     private:
-        BufferLayout _layout_info;
-        std::vector<Primitive*> _buff;
+        // primitives that are shared between the copies of a buffer
+        struct storage_t
+        {
+            BufferLayout layout_info;
+            std::vector<Primitive*> buff;
+            std::vector<bool> in_arena;     // true if the primitive at that position is placed in the arena
+            Arena arena;                    // memory of the primitives and their attributes
+            uint64_t revision;              // changes with every modification, unique among all buffers
 
-        // allocates or reallocates buffer memory
-        void allocate(void);
+            storage_t(void) noexcept : revision(0) {}
+            storage_t(const storage_t&) = delete;
+            storage_t& operator= (const storage_t&) = delete;
+            ~storage_t(void);
+
+            // allocates or reallocates buffer memory
+            void allocate(void);
+
+            // copies the primitive @param prim to the position @param pos
+            void set(size_t pos, const Primitive* prim);
+
+            // destroys the primitive at position @param pos
+            void destroy(size_t pos) noexcept;
+        };
+
+        std::shared_ptr<storage_t> _storage;
+
+        // makes the storage unique to this buffer before it is modified and updates the revision
+        storage_t& modify(void);
+
+        // returns a new unique revision number
+        static uint64_t next_revision(void) noexcept;
 
     public:
         /**
@@ -52,8 +85,8 @@ namespace rt
 
         Buffer(const Buffer& buff);
         Buffer& operator= (const Buffer& buff);
-        Buffer(Buffer&& buff);
-        Buffer& operator= (Buffer&& buff);
+        Buffer(Buffer&& buff) noexcept;
+        Buffer& operator= (Buffer&& buff) noexcept;
 
         virtual ~Buffer(void);
 
@@ -88,9 +121,10 @@ namespace rt
          *  @return The the internal array of primitive pointers.
          *              The mapped memory is read write.
          *  NOTE: If the buffer-layout is invalid this function will return 'nullptr'.
+         *  NOTE: Mapping the buffer read-write counts as modification, the primitives
+         *  are duplicated if they are shared with another buffer.
          */
-        inline Primitive** map_rdwr(void) noexcept
-        {return (this->_buff.size() == 0) ? nullptr : this->_buff.data();}
+        Primitive** map_rdwr(void);
 
         /**
          *  @return The the internal array of primitive pointers.
@@ -98,21 +132,29 @@ namespace rt
          *  NOTE: If the buffer-layout is invalid this function will return 'nullptr'.
          */
         inline const Primitive * const * map_rdonly(void) const noexcept
-        {return (this->_buff.size() == 0) ? nullptr : this->_buff.data();}
+        {return (this->_storage == nullptr || this->_storage->buff.size() == 0) ? nullptr : this->_storage->buff.data();}
 
         /** @return Buffer-layout information. */
-        inline const BufferLayout& layout(void) const noexcept
-        {return this->_layout_info;}
+        const BufferLayout& layout(void) const noexcept;
+
+        /**
+         *  @return The revision of the primitives. The revision changes every time the buffer is modified
+         *  and is unique among all buffers. Copies of a buffer have the same revision until one of them
+         *  is modified. A default constructed buffer has the revision 0.
+         */
+        inline uint64_t revision(void) const noexcept
+        {return (this->_storage == nullptr) ? 0 : this->_storage->revision;}
 
-        // Cleares all internal memory.
-        void clear(void) noexcept;
+        // Cleares all internal memory, the memory of the arena is released at once.
+        void clear(void);
 
         /**
          *  @brief Cleares memory in a given range.
          *  Parameters that would be out of range will be ignored.
+         *  NOTE: The arena memory of the primitives is not reused until the whole buffer is cleared.
          *  @param[in] begin: Begin index to clear.
          *  @param[in] end: End index to clear.
          */
-        void clearEXT(size_t begin, size_t end) noexcept;
+        void clearEXT(size_t begin, size_t end);
     };
 }
\ No newline at end of file
@@ -0,0 +1,512 @@
+/**
+* @file     bvh.cpp
+* @brief    Implementation of the bounding volume hierarchy.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "bvh.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace rt;
+
+// box that contains nothing, growing it by any other box results in the other box
+static inline aabb_t empty_box(void)
+{
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    return { glm::vec3(inf), glm::vec3(-inf) };
+}
+
+static inline void grow(aabb_t& box, const aabb_t& other)
+{
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+static inline void grow(aabb_t& box, const glm::vec3& p)
+{
+    box.min = glm::min(box.min, p);
+    box.max = glm::max(box.max, p);
+}
+
+static inline float surface_area(const aabb_t& box)
+{
+    const glm::vec3 e = box.max - box.min;
+    if (e.x < 0.0f || e.y < 0.0f || e.z < 0.0f) return 0.0f;  // empty box
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+static inline bool is_bounded(const aabb_t& box)
+{
+    return std::isfinite(box.min.x) && std::isfinite(box.min.y) && std::isfinite(box.min.z)
+        && std::isfinite(box.max.x) && std::isfinite(box.max.y) && std::isfinite(box.max.z);
+}
+
+void BVH::build(const Buffer* buffers, size_t n_buffers)
+{
+    this->clear();
+
+    // collect every primitive of every buffer...
+    std::vector<build_prim_t> build_prims;
+    for (size_t b = 0; b < n_buffers; b++)
+    {
+        const Primitive* const* map = buffers[b].map_rdonly();
+        if (map == nullptr) continue;
+
+        const size_t first = buffers[b].layout().first;
+        const size_t last = std::min(buffers[b].layout().last, buffers[b].layout().size);
+        for (size_t p = first; p < last; p++)
+        {
+            if (map[p] == nullptr) continue;
+
+            // ...and sort out the ones that can not be inserted into the hierarchy
+            const aabb_t bounds = map[p]->bounds();
+            if (is_bounded(bounds))
+                build_prims.push_back({ bounds, 0.5f * (bounds.min + bounds.max), map[p] });
+            else
+                this->_unbounded.push_back(map[p]);
+        }
+    }
+    if (build_prims.empty()) return;
+
+    this->_nodes.reserve(2 * build_prims.size());
+    this->build_recursive(build_prims, 0, build_prims.size(), 0);
+
+    this->_prims.reserve(build_prims.size());
+    for (const build_prim_t& bp : build_prims)
+        this->_prims.push_back(bp.prim);
+}
+
+uint32_t BVH::build_recursive(std::vector<build_prim_t>& build_prims, size_t begin, size_t end, uint32_t depth)
+{
+    const uint32_t node_idx = (uint32_t)this->_nodes.size();
+    this->_nodes.push_back(node_t());
+
+    aabb_t bounds = empty_box();
+    aabb_t centroid_bounds = empty_box();
+    for (size_t i = begin; i < end; i++)
+    {
+        grow(bounds, build_prims[i].bounds);
+        grow(centroid_bounds, build_prims[i].centroid);
+    }
+
+    const size_t n = end - begin;
+    this->_nodes[node_idx].bounds = bounds;
+    this->_nodes[node_idx].offset = (uint32_t)begin;
+    this->_nodes[node_idx].count = (uint16_t)n;
+    this->_nodes[node_idx].axis = 0;
+    if (n == 1) return node_idx;
+
+    /*  Evaluate the SAH for the split planes between the bins of every axis.
+        The cost of a split is: C = C_trav + (A_left * N_left + A_right * N_right) / A_parent
+        The cost of a leaf is:  C = N */
+    struct bin_t
+    {
+        aabb_t bounds;
+        uint32_t count;
+    };
+
+    const float parent_area = surface_area(bounds);
+    float best_cost = std::numeric_limits<float>::infinity();
+    uint32_t best_axis = 0;
+    uint32_t best_split = 0;
+
+    for (uint32_t axis = 0; axis < 3 && depth < MAX_SAH_DEPTH; axis++)
+    {
+        const float c_min = centroid_bounds.min[axis];
+        const float c_extent = centroid_bounds.max[axis] - c_min;
+        if (c_extent <= 0.0f) continue;     // every centroid is on the same plane, this axis can not be split
+
+        bin_t bins[SAH_BIN_COUNT];
+        for (uint32_t i = 0; i < SAH_BIN_COUNT; i++)
+            bins[i] = { empty_box(), 0 };
+
+        const float scale = SAH_BIN_COUNT / c_extent;
+        for (size_t i = begin; i < end; i++)
+        {
+            uint32_t b = (uint32_t)((build_prims[i].centroid[axis] - c_min) * scale);
+            if (b >= SAH_BIN_COUNT) b = SAH_BIN_COUNT - 1;
+            grow(bins[b].bounds, build_prims[i].bounds);
+            bins[b].count++;
+        }
+
+        // sweep from the right to get the area and count of every right partition
+        float right_area[SAH_BIN_COUNT];
+        uint32_t right_count[SAH_BIN_COUNT];
+        aabb_t box = empty_box();
+        uint32_t count = 0;
+        for (uint32_t i = SAH_BIN_COUNT - 1; i > 0; i--)
+        {
+            grow(box, bins[i].bounds);
+            count += bins[i].count;
+            right_area[i] = surface_area(box);
+            right_count[i] = count;
+        }
+
+        // sweep from the left and evaluate the split after every bin
+        box = empty_box();
+        count = 0;
+        for (uint32_t i = 0; i < SAH_BIN_COUNT - 1; i++)
+        {
+            grow(box, bins[i].bounds);
+            count += bins[i].count;
+            if (count == 0 || right_count[i + 1] == 0) continue;
+
+            const float cost = TRAVERSAL_COST + (surface_area(box) * count + right_area[i + 1] * right_count[i + 1]) / parent_area;
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = i + 1;
+            }
+        }
+    }
+
+    // no valid split was found (all centroids are the same or the tree is too deep), or a leaf is cheaper than the split
+    size_t mid;
+    if (best_cost == std::numeric_limits<float>::infinity())
+    {
+        if (n <= MAX_LEAF_SIZE) return node_idx;
+
+        // split in the middle of the largest centroid-axis to keep the leafs small and the tree balanced
+        const glm::vec3 c_extent = centroid_bounds.max - centroid_bounds.min;
+        best_axis = (c_extent.x >= c_extent.y && c_extent.x >= c_extent.z) ? 0 : ((c_extent.y >= c_extent.z) ? 1 : 2);
+        mid = begin + n / 2;
+        std::nth_element(build_prims.data() + begin, build_prims.data() + mid, build_prims.data() + end,
+            [=](const build_prim_t& a, const build_prim_t& b) { return a.centroid[best_axis] < b.centroid[best_axis]; });
+    }
+    else
+    {
+        if (n <= MAX_LEAF_SIZE && best_cost >= (float)n) return node_idx;
+
+        const float c_min = centroid_bounds.min[best_axis];
+        const float scale = SAH_BIN_COUNT / (centroid_bounds.max[best_axis] - c_min);
+        build_prim_t* const mid_ptr = std::partition(build_prims.data() + begin, build_prims.data() + end,
+            [=](const build_prim_t& bp)
+            {
+                uint32_t b = (uint32_t)((bp.centroid[best_axis] - c_min) * scale);
+                if (b >= SAH_BIN_COUNT) b = SAH_BIN_COUNT - 1;
+                return b < best_split;
+            });
+        mid = mid_ptr - build_prims.data();
+    }
+
+    // the first child is always the following node, only the index of the second child must be stored
+    this->build_recursive(build_prims, begin, mid, depth + 1);
+    const uint32_t second = this->build_recursive(build_prims, mid, end, depth + 1);
+    this->_nodes[node_idx].offset = second;
+    this->_nodes[node_idx].count = 0;
+    this->_nodes[node_idx].axis = (uint16_t)best_axis;
+    return node_idx;
+}
+
+void BVH::clear(void) noexcept
+{
+    this->_nodes.clear();
+    this->_prims.clear();
+    this->_unbounded.clear();
+}
+
+// slab test, returns true if the ray intersects the box within [0, t_max)
+static inline bool intersect_box(const aabb_t& box, const glm::vec3& origin, const glm::vec3& inv_dir, float t_max)
+{
+    const glm::vec3 t0 = (box.min - origin) * inv_dir;
+    const glm::vec3 t1 = (box.max - origin) * inv_dir;
+    const glm::vec3 t_near = glm::min(t0, t1);
+    const glm::vec3 t_far = glm::max(t0, t1);
+    const float t_enter = glm::max(glm::max(t_near.x, t_near.y), glm::max(t_near.z, 0.0f));
+    const float t_exit = glm::min(glm::min(t_far.x, t_far.y), t_far.z);
+    return t_enter <= t_exit && t_enter < t_max;
+}
+
+float BVH::intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const
+{
+    float t = t_max;
+
+    // primitives without bounds are always tested
+    for (const Primitive* prim : this->_unbounded)
+    {
+        RayHitInformation _hit_info;
+        const float t_cur = prim->intersect(ray, t_max, cull_mask, _hit_info);
+        if (t_cur < t)
+        {
+            if (hit_prim != nullptr)
+                *hit_prim = prim;
+            t = t_cur;
+            hit_info = _hit_info;
+        }
+    }
+    if (this->_nodes.empty()) return t;
+
+    const glm::vec3 inv_dir = 1.0f / ray.direction;
+    const bool dir_is_neg[3] = { inv_dir.x < 0.0f, inv_dir.y < 0.0f, inv_dir.z < 0.0f };
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t stack_ptr = 0;
+    uint32_t node_idx = 0;
+
+    while (true)
+    {
+        const node_t& node = this->_nodes[node_idx];
+        if (intersect_box(node.bounds, ray.origin, inv_dir, t))
+        {
+            if (node.count > 0)
+            {
+                // leaf: test every primitive with the current closest hit as maximum length
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                {
+                    RayHitInformation _hit_info;
+                    const float t_cur = this->_prims[i]->intersect(ray, t, cull_mask, _hit_info);
+                    if (t_cur < t)
+                    {
+                        if (hit_prim != nullptr)
+                            *hit_prim = this->_prims[i];
+                        t = t_cur;
+                        hit_info = _hit_info;
+                    }
+                }
+                if (stack_ptr == 0) break;
+                node_idx = stack[--stack_ptr];
+            }
+            else
+            {
+                // interior node: visit the child that is closer to the ray-origin first
+                if (dir_is_neg[node.axis])
+                {
+                    stack[stack_ptr++] = node_idx + 1;
+                    node_idx = node.offset;
+                }
+                else
+                {
+                    stack[stack_ptr++] = node.offset;
+                    node_idx = node_idx + 1;
+                }
+            }
+        }
+        else
+        {
+            if (stack_ptr == 0) break;
+            node_idx = stack[--stack_ptr];
+        }
+    }
+    return t;
+}
+
+// updates the closest hits of the rays whose bit is set in hit_mask
+static inline void update_packet_hits(uint32_t hit_mask, const Primitive* prim, const Primitive** hit_prim)
+{
+    if (hit_prim == nullptr) return;
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        if (hit_mask & (1 << i))
+            hit_prim[i] = prim;
+    }
+}
+
+void BVH::intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const
+{
+    using namespace simd;
+    if (mask == 0) return;
+
+    for (const Primitive* prim : this->_unbounded)
+        update_packet_hits(prim->intersect_packet(packet, mask, cull_mask, t, hit_info), prim, hit_prim);
+    if (this->_nodes.empty()) return;
+
+    const vfloat one = set1(1.0f);
+    const vfloat ox = load(packet.origin_x);
+    const vfloat oy = load(packet.origin_y);
+    const vfloat oz = load(packet.origin_z);
+    const vfloat inv_dx = div(one, load(packet.direction_x));
+    const vfloat inv_dy = div(one, load(packet.direction_y));
+    const vfloat inv_dz = div(one, load(packet.direction_z));
+    const vfloat active = mask_from_bits(mask);
+
+    // the traversal order is determined by the first active ray
+    uint32_t first = 0;
+    while (!(mask & (1 << first))) first++;
+    const bool dir_is_neg[3] = { packet.direction_x[first] < 0.0f, packet.direction_y[first] < 0.0f, packet.direction_z[first] < 0.0f };
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t stack_ptr = 0;
+    uint32_t node_idx = 0;
+
+    while (true)
+    {
+        const node_t& node = this->_nodes[node_idx];
+
+        // slab test for every ray of the packet
+        const vfloat tx0 = mul(sub(set1(node.bounds.min.x), ox), inv_dx);
+        const vfloat tx1 = mul(sub(set1(node.bounds.max.x), ox), inv_dx);
+        const vfloat ty0 = mul(sub(set1(node.bounds.min.y), oy), inv_dy);
+        const vfloat ty1 = mul(sub(set1(node.bounds.max.y), oy), inv_dy);
+        const vfloat tz0 = mul(sub(set1(node.bounds.min.z), oz), inv_dz);
+        const vfloat tz1 = mul(sub(set1(node.bounds.max.z), oz), inv_dz);
+        const vfloat t_enter = max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), simd::zero()));
+        const vfloat t_exit = min(min(max(tx0, tx1), max(ty0, ty1)), max(tz0, tz1));
+        const vfloat box_hit = bit_and(active, bit_and(cmp_le(t_enter, t_exit), cmp_lt(t_enter, loadu(t))));
+        const uint32_t hit_mask = movemask(box_hit);
+
+        if (hit_mask != 0)
+        {
+            if (node.count > 0)
+            {
+                // leaf: only the rays that hit the box are tested
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                    update_packet_hits(this->_prims[i]->intersect_packet(packet, hit_mask, cull_mask, t, hit_info), this->_prims[i], hit_prim);
+
+                if (stack_ptr == 0) break;
+                node_idx = stack[--stack_ptr];
+            }
+            else
+            {
+                if (dir_is_neg[node.axis])
+                {
+                    stack[stack_ptr++] = node_idx + 1;
+                    node_idx = node.offset;
+                }
+                else
+                {
+                    stack[stack_ptr++] = node.offset;
+                    node_idx = node_idx + 1;
+                }
+            }
+        }
+        else
+        {
+            if (stack_ptr == 0) break;
+            node_idx = stack[--stack_ptr];
+        }
+    }
+}
+
+bool BVH::occluded(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const
+{
+    // tests a primitive, returns true if it occludes the ray
+    auto test = [&](const Primitive* prim) -> bool
+    {
+        RayHitInformation hit_info;
+        const float t = prim->intersect(ray, t_max, cull_mask, hit_info);
+        return t < t_max && (any_hit == nullptr || any_hit(user_data, ray, t, prim, hit_info));
+    };
+
+    for (const Primitive* prim : this->_unbounded)
+    {
+        if (test(prim)) return true;
+    }
+    if (this->_nodes.empty()) return false;
+
+    const glm::vec3 inv_dir = 1.0f / ray.direction;
+    uint32_t stack[STACK_SIZE];
+    uint32_t stack_ptr = 0;
+    uint32_t node_idx = 0;
+
+    // the order of the nodes does not matter, the first accepted hit terminates the traversal
+    while (true)
+    {
+        const node_t& node = this->_nodes[node_idx];
+        if (intersect_box(node.bounds, ray.origin, inv_dir, t_max))
+        {
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                {
+                    if (test(this->_prims[i])) return true;
+                }
+                if (stack_ptr == 0) break;
+                node_idx = stack[--stack_ptr];
+            }
+            else
+            {
+                stack[stack_ptr++] = node.offset;
+                node_idx = node_idx + 1;
+            }
+        }
+        else
+        {
+            if (stack_ptr == 0) break;
+            node_idx = stack[--stack_ptr];
+        }
+    }
+    return false;
+}
+
+// distance from a point to a box, 0 if the point is inside the box
+static inline float box_distance(const aabb_t& box, const glm::vec3& p)
+{
+    const glm::vec3 d = glm::max(glm::max(box.min - p, p - box.max), glm::vec3(0.0f));
+    return glm::length(d);
+}
+
+float BVH::distance(const glm::vec3& p, float d_max, const Primitive** hit_prim) const
+{
+    float d = d_max;
+
+    // primitives without bounds are always tested
+    for (const Primitive* prim : this->_unbounded)
+    {
+        const float d_cur = prim->distance(p);
+        if (d_cur < d)
+        {
+            if (hit_prim != nullptr)
+                *hit_prim = prim;
+            d = d_cur;
+        }
+    }
+    if (this->_nodes.empty()) return d;
+
+    // a node is skipped if the point is outside of its box and the box is further away than the closest primitive,
+    // if the point is inside the box the primitives can have a negative distance
+    struct entry_t
+    {
+        uint32_t node;
+        float lower_bound;
+    };
+    entry_t stack[STACK_SIZE];
+    uint32_t stack_ptr = 0;
+    stack[stack_ptr++] = { 0, box_distance(this->_nodes[0].bounds, p) };
+
+    while (stack_ptr > 0)
+    {
+        const entry_t entry = stack[--stack_ptr];
+        if (entry.lower_bound > 0.0f && entry.lower_bound >= d) continue;
+
+        const node_t& node = this->_nodes[entry.node];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const float d_cur = this->_prims[i]->distance(p);
+                if (d_cur < d)
+                {
+                    if (hit_prim != nullptr)
+                        *hit_prim = this->_prims[i];
+                    d = d_cur;
+                }
+            }
+        }
+        else
+        {
+            // the closer child is pushed last, so it is visited first
+            const entry_t first = { entry.node + 1, box_distance(this->_nodes[entry.node + 1].bounds, p) };
+            const entry_t second = { node.offset, box_distance(this->_nodes[node.offset].bounds, p) };
+            if (first.lower_bound <= second.lower_bound)
+            {
+                stack[stack_ptr++] = second;
+                stack[stack_ptr++] = first;
+            }
+            else
+            {
+                stack[stack_ptr++] = first;
+                stack[stack_ptr++] = second;
+            }
+        }
+    }
+    return d;
+}
@@ -0,0 +1,138 @@
+/**
+* @file     bvh.h
+* @brief    Bounding volume hierarchy that accelerates the ray - primitive - intersection.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "buffer.h"
+#include <vector>
+
+namespace rt
+{
+    /**
+     *  This class builds a bounding volume hierarchy over the primitives of one or more
+     *  primitive buffers. The hierarchy is built with the surface area heuristic (SAH).
+     *  Primitives with an unbounded box (e.g. the infinite plane) can not be inserted
+     *  into the hierarchy, they are stored in a seperate list and are tested for every ray.
+     *  NOTE: The BVH only stores pointers to the primitives of the buffers. If a buffer
+     *  changes or gets destroyed, the BVH has to be rebuilt.
+     */
+    class BVH
+    {
+    private:
+        struct node_t
+        {
+            aabb_t bounds;      // bounding box of all primitives within the node
+            uint32_t offset;    // leaf: index of the first primitive, interior node: index of the second child
+            uint16_t count;     // number of primitives, 0 if it is an interior node
+            uint16_t axis;      // split axis of an interior node
+        };
+
+        struct build_prim_t
+        {
+            aabb_t bounds;              // bounding box of the primitive
+            glm::vec3 centroid;         // center of the bounding box
+            const Primitive* prim;      // the primitive itself
+        };
+
+        std::vector<node_t> _nodes;                 // flattened tree, the first child of a node is always the next node
+        std::vector<const Primitive*> _prims;       // primitives in the order the leafs are referencing them
+        std::vector<const Primitive*> _unbounded;   // primitives that are tested for every ray
+
+        // recursively builds the hierarchy of the primitives within [begin, end)
+        uint32_t build_recursive(std::vector<build_prim_t>& build_prims, size_t begin, size_t end, uint32_t depth);
+
+    public:
+        static constexpr uint32_t SAH_BIN_COUNT     = 16;   // number of bins used to evaluate the SAH
+        static constexpr uint32_t MAX_LEAF_SIZE     = 4;    // maximum number of primitives in a leaf
+        static constexpr float TRAVERSAL_COST       = 1.0f; // cost of a node traversal relative to an intersection test
+        static constexpr uint32_t MAX_SAH_DEPTH     = 64;   // below this depth the nodes are split in the middle to limit the tree-depth
+        static constexpr uint32_t STACK_SIZE        = 128;  // size of the traversal stack
+
+        BVH(void) = default;
+        virtual ~BVH(void) = default;
+
+        /**
+         *  @brief Builds the hierarchy over the primitives of the buffers.
+         *  Only the primitives within the range [first, last) of the buffer-layout are inserted.
+         *  @param[in] buffers: Array of primitive buffers.
+         *  @param[in] n_buffers: Number of primitive buffers.
+         */
+        void build(const Buffer* buffers, size_t n_buffers);
+
+        /** @brief Cleares the hierarchy. */
+        void clear(void) noexcept;
+
+        /**
+         *  @brief Finds the closest intersection of a ray with the primitives of the hierarchy.
+         *  The nodes are traversed front to back and the maximum length of the ray shrinks
+         *  with every closer hit.
+         *  @param[in] ray: The ray that is tested if it intersects with a primitive.
+         *  @param[in] t_max: The maximum length of the ray. Similar to the render distance.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[out] hit_info: Information about the ray-hit.
+         *  @param[out] hit_prim: The primitive that the ray intersected with.
+         *  @return The length of the ray-origin to the closest intersection point.
+         *  The length caps at @param t_max if the ray does not intersect with any primitive.
+         */
+        float intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const;
+
+        /**
+         *  @brief Finds the closest intersection of every active ray of a ray packet.
+         *  The whole packet traverses the hierarchy at once, a node is visited if at least one
+         *  active ray intersects with its box. The nodes are visited front to back in the
+         *  direction of the first active ray.
+         *  @param[in] packet: The rays that are tested if they intersect with a primitive.
+         *  @param[in] mask: Bit i is set if the ray i is active.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[in, out] t: The maximum length of every ray. Gets updated if a ray hits a primitive.
+         *  @param[out] hit_info: Hit information of every ray, only written if the ray hits a primitive.
+         *  @param[out] hit_prim: The primitive every ray intersected with, only written if the ray hits a primitive.
+         */
+        void intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const;
+
+        /**
+         *  @brief Tests if a ray hits any primitive of the hierarchy within its maximum length.
+         *  The traversal stops at the first hit that is accepted.
+         *  @param[in] ray: The ray that is tested for occlusion.
+         *  @param[in] t_max: The maximum length of the ray.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[in] any_hit: Decides if a hit is accepted, every hit is accepted if it is nullptr.
+         *  @param[in] user_data: Pointer that is passed to @param any_hit.
+         *  @return True if the ray is occluded.
+         */
+        bool occluded(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const;
+
+        /**
+         *  @brief Finds the primitive that is the closest to a point (e.g. for sphere tracing).
+         *  The distance from the point to the box of a node is a lower bound of the distances to
+         *  the primitives inside the node, nodes that can not contain a closer primitive are skipped.
+         *  NOTE: This requires that the distance of a point outside the bounding box of a primitive
+         *  is not smaller than the distance to the box, which is true for every signed distance function.
+         *  @param[in] p: Point from where the distance is calculated.
+         *  @param[in] d_max: Maximum distance, primitives that are further away are ignored.
+         *  @param[out] hit_prim: The closest primitive, only written if it is closer than @param d_max.
+         *  @return The distance to the closest primitive, caps at @param d_max.
+         */
+        float distance(const glm::vec3& p, float d_max, const Primitive** hit_prim) const;
+
+        /** @return The number of nodes of the hierarchy. */
+        inline size_t node_count(void) const noexcept
+        {return this->_nodes.size();}
+
+        /** @return The number of primitives inside the hierarchy. */
+        inline size_t primitive_count(void) const noexcept
+        {return this->_prims.size();}
+
+        /** @return The number of primitives that are tested for every ray. */
+        inline size_t unbounded_count(void) const noexcept
+        {return this->_unbounded.size();}
+    };
+}
@@ -0,0 +1,123 @@
+/**
+* @file     geometry_buffer.h
+* @brief    Base class of buffers that store and intersect their primitives on their own.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "rt_error.h"
+#include "../primitive/primitive.h"
+#include <atomic>
+
+namespace rt
+{
+    /**
+     *  Unlike the rt::Buffer, which only stores pointers to primitives, a geometry buffer
+     *  chooses the memory layout of its primitives by itself and implements the intersection
+     *  test for all of its primitives at once. Geometry buffers are drawn next to the
+     *  primitive buffers.
+     *  Every custom made geometry buffer must inherit from the rt::GeometryBuffer class.
+     */
+    class GeometryBuffer
+    {
+    protected:
+        // returns a new revision number that is unique among all geometry buffers
+        static uint64_t next_revision(void) noexcept
+        {
+            static std::atomic<uint64_t> revision(0);
+            return ++revision;
+        }
+
+    public:
+        GeometryBuffer(void) noexcept {}
+        virtual ~GeometryBuffer(void) {}
+
+        /**
+         *  @brief Finds the closest intersection of a ray with the primitives of the buffer.
+         *  @param[in] ray: The ray that is tested if it intersects with a primitive.
+         *  @param[in] t_max: The maximum length of the ray, usually the closest hit found so far.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[out] hit_info: Information about the ray-hit.
+         *  @param[out] hit_prim: The primitive that the ray intersected with.
+         *  @return The length of the ray-origin to the closest intersection point.
+         *  The length caps at @param t_max if the ray does not intersect with any primitive.
+         *  NOTE: The output parameters are only written if there is an intersection closer than @param t_max.
+         */
+        virtual float intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const = 0;
+
+        /**
+         *  @brief Finds the closest intersection of every active ray of a ray packet.
+         *  By default the rays are tested one after another, geometry buffers can overwrite this
+         *  method to test the whole packet with SIMD instructions.
+         *  @param[in] packet: The rays that are tested if they intersect with a primitive.
+         *  @param[in] mask: Bit i is set if the ray i is active.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[in, out] t: The maximum length of every ray. Gets updated if a ray hits a primitive.
+         *  @param[out] hit_info: Hit information of every ray, only written if the ray hits a primitive.
+         *  @param[out] hit_prim: The primitive every ray intersected with, only written if the ray hits a primitive.
+         */
+        virtual void intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const
+        {
+            for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+            {
+                if (mask & (1 << i))
+                    t[i] = this->intersect(packet.ray(i), t[i], cull_mask, hit_info[i], (hit_prim != nullptr) ? hit_prim + i : nullptr);
+            }
+        }
+
+        /**
+         *  @brief Tests if a ray hits any primitive of the buffer within its maximum length.
+         *  The test stops at the first hit that is accepted.
+         *  By default only the closest hit is passed to @param any_hit, geometry buffers should
+         *  overwrite this method to test the hits in any order and to stop early.
+         *  @param[in] ray: The ray that is tested for occlusion.
+         *  @param[in] t_max: The maximum length of the ray.
+         *  @param[in] cull_mask: Back- and/or front-face culling.
+         *  @param[in] any_hit: Decides if a hit is accepted, every hit is accepted if it is nullptr.
+         *  @param[in] user_data: Pointer that is passed to @param any_hit.
+         *  @return True if the ray is occluded.
+         */
+        virtual bool occluded(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const
+        {
+            RayHitInformation hit_info = RT_HIT_INFO_NONE;
+            const Primitive* hit_prim = nullptr;
+            const float t = this->intersect(ray, t_max, cull_mask, hit_info, &hit_prim);
+            return t < t_max && (any_hit == nullptr || any_hit(user_data, ray, t, hit_prim, hit_info));
+        }
+
+        /**
+         *  @brief Finds the primitive of the buffer that is the closest to a point (e.g. for sphere tracing).
+         *  By default the buffer has no distance function and @param d_max is returned.
+         *  @param[in] p: Point from where the distance is calculated.
+         *  @param[in] d_max: Maximum distance, primitives that are further away are ignored.
+         *  @param[out] hit_prim: The closest primitive, only written if it is closer than @param d_max.
+         *  @return The distance to the closest primitive, caps at @param d_max.
+         */
+        virtual float distance(const glm::vec3& p, float d_max, const Primitive** hit_prim) const
+        {return d_max;}
+
+        /**
+         *  @return The revision of the primitives. Geometry buffers that share their primitives between
+         *  copies should return a revision that changes every time the primitives are modified, copies
+         *  that still share the same primitives have the same revision.
+         *  By default the buffer has no revision and 0 is returned.
+         */
+        virtual uint64_t revision(void) const noexcept
+        {return 0;}
+
+        /**
+         *  @return A dynamic clone of the own instance.
+         *  The memory does not free automantically.
+         *  To avoid memory leaks YOU have to free it yourself.
+         *  HINT: The ray tracer clones the buffers it draws and deletes the clones automatically,
+         *  the clone should share the primitives instead of copying them if possible.
+         */
+        virtual GeometryBuffer* clone_dynamic(void) const = 0;
+    };
+}
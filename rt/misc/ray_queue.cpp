@@ -0,0 +1,132 @@
+/**
+* @file     ray_queue.cpp
+* @brief    Implementation of the queue of pending rays.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "ray_queue.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace rt;
+
+// inserts two 0-bits after each of the 10 lower bits of @param v
+static inline uint32_t expand_bits(uint32_t v) noexcept
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+void RayQueue::reserve(size_t n)
+{
+    this->_origin_x.reserve(n);     this->_origin_y.reserve(n);     this->_origin_z.reserve(n);
+    this->_direction_x.reserve(n);  this->_direction_y.reserve(n);  this->_direction_z.reserve(n);
+    this->_weight_r.reserve(n);     this->_weight_g.reserve(n);     this->_weight_b.reserve(n);
+    this->_pixel.reserve(n);
+}
+
+void RayQueue::clear(void) noexcept
+{
+    this->_origin_x.clear();    this->_origin_y.clear();    this->_origin_z.clear();
+    this->_direction_x.clear(); this->_direction_y.clear(); this->_direction_z.clear();
+    this->_weight_r.clear();    this->_weight_g.clear();    this->_weight_b.clear();
+    this->_pixel.clear();
+}
+
+void RayQueue::push(const ray_t& ray, const glm::vec3& weight, uint32_t pixel)
+{
+    this->_origin_x.push_back(ray.origin.x);
+    this->_origin_y.push_back(ray.origin.y);
+    this->_origin_z.push_back(ray.origin.z);
+    this->_direction_x.push_back(ray.direction.x);
+    this->_direction_y.push_back(ray.direction.y);
+    this->_direction_z.push_back(ray.direction.z);
+    this->_weight_r.push_back(weight.r);
+    this->_weight_g.push_back(weight.g);
+    this->_weight_b.push_back(weight.b);
+    this->_pixel.push_back(pixel);
+}
+
+uint32_t RayQueue::load_packet(size_t first, ray_packet_t& packet) const noexcept
+{
+    const size_t n = std::min<size_t>(RT_RAY_PACKET_SIZE, this->size() - first);
+    memcpy(packet.origin_x, this->_origin_x.data() + first, n * sizeof(float));
+    memcpy(packet.origin_y, this->_origin_y.data() + first, n * sizeof(float));
+    memcpy(packet.origin_z, this->_origin_z.data() + first, n * sizeof(float));
+    memcpy(packet.direction_x, this->_direction_x.data() + first, n * sizeof(float));
+    memcpy(packet.direction_y, this->_direction_y.data() + first, n * sizeof(float));
+    memcpy(packet.direction_z, this->_direction_z.data() + first, n * sizeof(float));
+
+    // the inactive lanes get a valid ray, so that the SIMD code does not work with garbage
+    for (size_t i = n; i < RT_RAY_PACKET_SIZE; i++)
+        packet.set_ray((uint32_t)i, { glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) });
+
+    return (uint32_t)((1ull << n) - 1);
+}
+
+void RayQueue::reset_hits(float t_max)
+{
+    const size_t n = (this->size() + RT_RAY_PACKET_SIZE - 1) / RT_RAY_PACKET_SIZE * RT_RAY_PACKET_SIZE;
+    this->_t.assign(n, t_max);
+    this->_hit_info.assign(n, RT_HIT_INFO_NONE);
+    this->_hit_prim.assign(n, nullptr);
+}
+
+size_t RayQueue::coherent_packets(void) const noexcept
+{
+    size_t n = 0;
+    for (size_t first = 0; first < this->size(); first += RT_RAY_PACKET_SIZE)
+    {
+        const size_t last = std::min<size_t>(first + RT_RAY_PACKET_SIZE, this->size());
+        const uint32_t octant = this->octant(first);
+        size_t i = first + 1;
+        while (i < last && this->octant(i) == octant) i++;
+        if (i == last) n++;
+    }
+    return n;
+}
+
+void RayQueue::sort(RayQueue& dst, std::vector<std::pair<uint64_t, uint32_t>>& keys) const
+{
+    if (this->size() == 0)
+    {
+        dst.clear();
+        return;
+    }
+
+    // bounding box of the origins
+    glm::vec3 lo = this->ray(0).origin, hi = lo;
+    for (size_t i = 1; i < this->size(); i++)
+    {
+        const glm::vec3 o = this->ray(i).origin;
+        lo = glm::min(lo, o);
+        hi = glm::max(hi, o);
+    }
+    const glm::vec3 extent = hi - lo;
+    const glm::vec3 scale = glm::vec3(
+        (extent.x > 0.0f) ? 1023.0f / extent.x : 0.0f,
+        (extent.y > 0.0f) ? 1023.0f / extent.y : 0.0f,
+        (extent.z > 0.0f) ? 1023.0f / extent.z : 0.0f
+    );
+
+    keys.clear();
+    for (size_t i = 0; i < this->size(); i++)
+    {
+        const glm::vec3 q = glm::clamp((this->ray(i).origin - lo) * scale, 0.0f, 1023.0f);
+        const uint32_t morton = (expand_bits((uint32_t)q.x) << 2) | (expand_bits((uint32_t)q.y) << 1) | expand_bits((uint32_t)q.z);
+        keys.push_back(std::make_pair(((uint64_t)this->octant(i) << 30) | morton, (uint32_t)i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    dst.clear();
+    for (const std::pair<uint64_t, uint32_t>& key : keys)
+        dst.push(this->ray(key.second), this->weight(key.second), this->pixel(key.second));
+}
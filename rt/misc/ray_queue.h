@@ -0,0 +1,127 @@
+/**
+* @file     ray_queue.h
+* @brief    Queue of pending rays for the wavefront renderer.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "../primitive/primitive.h"
+#include <utility>
+#include <vector>
+
+namespace rt
+{
+    /**
+     *  This class stores the rays of one bounce of the wavefront renderer as structure of arrays.
+     *  Every ray has a weight (the product of the attenuations along its path) and the index of
+     *  the pixel it contributes to. Next to the rays the queue stores the results of the
+     *  intersection stage. The arrays of the results are padded to a multiple of RT_RAY_PACKET_SIZE,
+     *  so that the queue can be intersected packet by packet.
+     *  Rays are only ever appended, the rays that terminate are simply not pushed into the queue
+     *  of the next bounce, which compacts the queue.
+     */
+    class RayQueue
+    {
+    private:
+        std::vector<float> _origin_x, _origin_y, _origin_z;
+        std::vector<float> _direction_x, _direction_y, _direction_z;
+        std::vector<float> _weight_r, _weight_g, _weight_b;
+        std::vector<uint32_t> _pixel;                   // index of the pixel the ray contributes to
+
+        std::vector<float> _t;                          // length to the closest hit, t_max on a miss
+        std::vector<RayHitInformation> _hit_info;       // hit information of the closest hit
+        std::vector<const Primitive*> _hit_prim;        // closest primitive, nullptr on a miss
+
+    public:
+        RayQueue(void) = default;
+        virtual ~RayQueue(void) = default;
+
+        /** @brief Reserves memory for @param n rays. */
+        void reserve(size_t n);
+
+        /** @brief Removes every ray from the queue, the memory is kept. */
+        void clear(void) noexcept;
+
+        /** @return The number of rays in the queue. */
+        inline size_t size(void) const noexcept
+        {return this->_pixel.size();}
+
+        /**
+         *  @brief Appends a ray to the queue.
+         *  @param[in] ray: The ray.
+         *  @param[in] weight: Weight of the radiance the ray gathers.
+         *  @param[in] pixel: Index of the pixel the ray contributes to.
+         */
+        void push(const ray_t& ray, const glm::vec3& weight, uint32_t pixel);
+
+        /** @return The ray at position @param i. */
+        inline ray_t ray(size_t i) const noexcept
+        {
+            return { {this->_origin_x[i], this->_origin_y[i], this->_origin_z[i]},
+                     {this->_direction_x[i], this->_direction_y[i], this->_direction_z[i]} };
+        }
+
+        /** @return The weight of the ray at position @param i. */
+        inline glm::vec3 weight(size_t i) const noexcept
+        {return glm::vec3(this->_weight_r[i], this->_weight_g[i], this->_weight_b[i]);}
+
+        /** @return The pixel of the ray at position @param i. */
+        inline uint32_t pixel(size_t i) const noexcept
+        {return this->_pixel[i];}
+
+        /**
+         *  @brief Copies RT_RAY_PACKET_SIZE rays into a ray packet.
+         *  @param[in] first: Position of the first ray.
+         *  @param[out] packet: The ray packet.
+         *  @return The mask of the active rays, the lanes after the end of the queue are inactive.
+         */
+        uint32_t load_packet(size_t first, ray_packet_t& packet) const noexcept;
+
+        /** @return The octant of the direction of the ray at position @param i, bit 0/1/2 is set if x/y/z is negative. */
+        inline uint32_t octant(size_t i) const noexcept
+        {
+            return (uint32_t)(this->_direction_x[i] < 0.0f) | ((uint32_t)(this->_direction_y[i] < 0.0f) << 1) | ((uint32_t)(this->_direction_z[i] < 0.0f) << 2);
+        }
+
+        /**
+         *  @return The number of ray packets (RT_RAY_PACKET_SIZE consecutive rays) whose rays all point
+         *  into the same octant. Such packets traverse the acceleration structure in the same order.
+         */
+        size_t coherent_packets(void) const noexcept;
+
+        /**
+         *  @brief Copies the rays sorted by a coherence key into another queue.
+         *  The key is the octant of the direction followed by the Morton-code of the origin, which is
+         *  quantized to 10 bits per axis within the bounding box of all origins of the queue.
+         *  So rays with a similar direction and a close origin become neighbours.
+         *  NOTE: The results of the intersection stage are not copied.
+         *  @param[out] dst: The queue the sorted rays are written into, must not be this queue.
+         *  @param[out] keys: Memory for the keys, it is reused to avoid allocations.
+         */
+        void sort(RayQueue& dst, std::vector<std::pair<uint64_t, uint32_t>>& keys) const;
+
+        /**
+         *  @brief Resets the results of the intersection stage.
+         *  @param[in] t_max: Maximum length of the rays.
+         */
+        void reset_hits(float t_max);
+
+        /** @return The lengths to the closest hits, padded to a multiple of RT_RAY_PACKET_SIZE. */
+        inline float* t(void) noexcept                                  {return this->_t.data();}
+        inline const float* t(void) const noexcept                      {return this->_t.data();}
+
+        /** @return The hit information of the closest hits, padded to a multiple of RT_RAY_PACKET_SIZE. */
+        inline RayHitInformation* hit_info(void) noexcept               {return this->_hit_info.data();}
+        inline const RayHitInformation* hit_info(void) const noexcept   {return this->_hit_info.data();}
+
+        /** @return The closest primitives, padded to a multiple of RT_RAY_PACKET_SIZE. */
+        inline const Primitive** hit_prim(void) noexcept                {return this->_hit_prim.data();}
+        inline const Primitive* const* hit_prim(void) const noexcept    {return this->_hit_prim.data();}
+    };
+}
@@ -27,6 +27,8 @@ namespace rt
         RT_IMAGE_ERROR_NULL = 1,
         RT_IMAGE_ERROR_OUT_OF_MEMORY = 2,
         RT_IMAGE_ERROR_OUT_OF_RANGE = 3,
-        RT_IMAGE_ERROR_ZERO_SIZE = 4
+        RT_IMAGE_ERROR_ZERO_SIZE = 4,
+        RT_IMAGE_ERROR_WRITE = 5,
+        RT_IMAGE_ERROR_UNSUPPORTED_FORMAT = 6
     };
 }
\ No newline at end of file
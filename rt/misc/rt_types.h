@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include "simd.h"
 #include <glm/glm.hpp>
 
 namespace rt
@@ -20,13 +21,33 @@ namespace rt
     using RayHitInformation = uint32_t;
     using RayCullMask = uint32_t;
 
+    // ================ CONSTANTS ================
+
+    // number of rays in a ray packet, equals the SIMD width (8 with AVX2, 4 with SSE)
+    constexpr uint32_t RT_RAY_PACKET_SIZE = simd::WIDTH;
+
+    // textures that are larger than this size in bytes (about the size of a L2 cache) use the tiled layout by default
+    constexpr size_t RT_IMAGE_TILED_LAYOUT_THRESHOLD = 1024 * 1024;
+
+    // maximum edge length of the tiles the threads render, every thread allocates its memory for a whole tile
+    constexpr uint32_t RT_MAX_TILE_SIZE = 256;
+
     // ================ CLASSES ================
+    class Arena;
+
     class PrimitiveAttribute
     {
     public:
         PrimitiveAttribute(void) {}
         virtual ~PrimitiveAttribute(void) {}
         virtual PrimitiveAttribute* clone_dynamic(void) const = 0;
+
+        /**
+         *  @return A clone of the own instance that is placed into the memory of an arena.
+         *  By default the attribute does not support arenas and nullptr is returned,
+         *  the attribute is cloned with clone_dynamic() instead.
+         */
+        virtual PrimitiveAttribute* clone_arena(Arena& arena) const { return nullptr; }
     };
 
     // ================ STRUCTS ================
@@ -36,6 +57,36 @@ namespace rt
         glm::vec3 direction;
     };
 
+    // rays are stored as structure of arrays, so that every component can be loaded into a SIMD register
+    struct ray_packet_t
+    {
+        alignas(32) float origin_x[RT_RAY_PACKET_SIZE];
+        alignas(32) float origin_y[RT_RAY_PACKET_SIZE];
+        alignas(32) float origin_z[RT_RAY_PACKET_SIZE];
+        alignas(32) float direction_x[RT_RAY_PACKET_SIZE];
+        alignas(32) float direction_y[RT_RAY_PACKET_SIZE];
+        alignas(32) float direction_z[RT_RAY_PACKET_SIZE];
+
+        /** @return The ray of the lane @param i. */
+        inline ray_t ray(uint32_t i) const noexcept
+        {
+            return { {origin_x[i], origin_y[i], origin_z[i]}, {direction_x[i], direction_y[i], direction_z[i]} };
+        }
+
+        /** @brief Sets the ray of the lane @param i. */
+        inline void set_ray(uint32_t i, const ray_t& ray) noexcept
+        {
+            origin_x[i] = ray.origin.x;         origin_y[i] = ray.origin.y;         origin_z[i] = ray.origin.z;
+            direction_x[i] = ray.direction.x;   direction_y[i] = ray.direction.y;   direction_z[i] = ray.direction.z;
+        }
+    };
+
+    struct aabb_t
+    {
+        glm::vec3 min;      // minimum corner of the box
+        glm::vec3 max;      // maximum corner of the box
+    };
+
     struct BufferLayout
     {
         size_t size = 0;    // the number of primitives the buffer can store
@@ -43,12 +94,40 @@ namespace rt
         size_t last = 0;    // last primitive that is processed
     };
 
+    struct AdaptiveSamplingInfo
+    {
+        uint32_t min_samples = 4;   // number of samples every pixel gets
+        uint32_t max_samples = 64;  // maximum number of samples per pixel
+        float threshold = 0.01f;    // pixels with an estimated error below the threshold are not sampled anymore
+    };
+
+    struct WavefrontInfo
+    {
+        uint32_t max_depth = 10;                // maximum number of bounces of a path
+        float t_max = 100.0f;                   // maximum length of the rays
+        RayCullMask cull_mask = 0;              // back- and/or front-face culling of every ray
+        bool sort_rays = false;                 // sorts the secondary rays by direction and origin before they are traced
+    };
+
+    struct RaySortStatistics
+    {
+        uint64_t sorted_rays = 0;               // number of secondary rays that were sorted
+        uint64_t packets = 0;                   // number of ray packets the sorted rays form
+        uint64_t coherent_before = 0;           // packets whose rays all point into the same octant, before sorting
+        uint64_t coherent_after = 0;            // packets whose rays all point into the same octant, after sorting
+    };
+
+    enum ImageFormat : uint32_t;
+    enum ImageLayout : uint32_t;
+
     struct ImageCreateInfo
     {
         uint32_t width;
         uint32_t height;
         uint32_t depth;
         uint32_t channels;
+        ImageFormat format;     // pixel format of the framebuffer, the default value is RT_FORMAT_R8G8B8_UNORM
+        ImageLayout layout;     // order of the pixels in memory, the default value is RT_IMAGE_LAYOUT_AUTO
     };
 
     struct CubemapCreateInfo
@@ -79,7 +158,28 @@ namespace rt
     enum Filter : uint32_t
     {
         RT_FILTER_NEAREST = 0,
-        RT_FILTER_LINEAR = 1
+        RT_FILTER_LINEAR = 1,
+        RT_FILTER_TRILINEAR = 2
+    };
+
+    enum RenderBackend : uint32_t
+    {
+        RT_BACKEND_RECURSIVE = 0,
+        RT_BACKEND_WAVEFRONT = 1
+    };
+
+    enum ImageFormat : uint32_t
+    {
+        RT_FORMAT_R8G8B8_UNORM = 0,
+        RT_FORMAT_R16G16B16A16_SFLOAT = 1,
+        RT_FORMAT_R32G32B32A32_SFLOAT = 2
+    };
+
+    enum ImageLayout : uint32_t
+    {
+        RT_IMAGE_LAYOUT_AUTO = 0,       // textures: tiled if larger than RT_IMAGE_TILED_LAYOUT_THRESHOLD, otherwise linear; other images: linear
+        RT_IMAGE_LAYOUT_LINEAR = 1,     // row after row
+        RT_IMAGE_LAYOUT_TILED = 2       // tiles of 4x4 (4x4x4) pixels in Morton-order, the tiles are stored row after row
     };
 
     enum TextureAddressMode : uint32_t
@@ -0,0 +1,201 @@
+/**
+* @file     simd.h
+* @brief    Thin wrapper around the AVX2 / SSE intrinsics that are used by the ray tracer.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+namespace rt
+{
+    /**
+     *  The functions of this namespace operate on SIMD registers of the widest
+     *  instruction set that is enabled: 8 floats with AVX2, 4 floats with SSE.
+     *  Comparisons return a mask with all bits of a lane set if the comparison is true.
+     */
+    namespace simd
+    {
+#if defined(__AVX2__)
+        using vfloat = __m256;
+        using vint = __m256i;
+        constexpr uint32_t WIDTH = 8;
+
+        inline vfloat load(const float* p) noexcept                         { return _mm256_load_ps(p); }
+        inline vfloat loadu(const float* p) noexcept                        { return _mm256_loadu_ps(p); }
+        inline void store(float* p, vfloat a) noexcept                      { _mm256_store_ps(p, a); }
+        inline vfloat set1(float v) noexcept                                { return _mm256_set1_ps(v); }
+        inline vfloat zero(void) noexcept                                   { return _mm256_setzero_ps(); }
+        inline vfloat add(vfloat a, vfloat b) noexcept                      { return _mm256_add_ps(a, b); }
+        inline vfloat sub(vfloat a, vfloat b) noexcept                      { return _mm256_sub_ps(a, b); }
+        inline vfloat mul(vfloat a, vfloat b) noexcept                      { return _mm256_mul_ps(a, b); }
+        inline vfloat div(vfloat a, vfloat b) noexcept                      { return _mm256_div_ps(a, b); }
+        inline vfloat fmadd(vfloat a, vfloat b, vfloat c) noexcept          { return _mm256_fmadd_ps(a, b, c); }
+        inline vfloat sqrt(vfloat a) noexcept                               { return _mm256_sqrt_ps(a); }
+        inline vfloat min(vfloat a, vfloat b) noexcept                      { return _mm256_min_ps(a, b); }
+        inline vfloat max(vfloat a, vfloat b) noexcept                      { return _mm256_max_ps(a, b); }
+        inline vfloat cmp_lt(vfloat a, vfloat b) noexcept                   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        inline vfloat cmp_le(vfloat a, vfloat b) noexcept                   { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        inline vfloat cmp_ge(vfloat a, vfloat b) noexcept                   { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        inline vfloat bit_and(vfloat a, vfloat b) noexcept                  { return _mm256_and_ps(a, b); }
+        inline vfloat bit_or(vfloat a, vfloat b) noexcept                   { return _mm256_or_ps(a, b); }
+        inline vfloat bit_andnot(vfloat a, vfloat b) noexcept               { return _mm256_andnot_ps(a, b); }
+        inline vfloat bit_xor(vfloat a, vfloat b) noexcept                  { return _mm256_xor_ps(a, b); }
+        inline vfloat select(vfloat mask, vfloat a, vfloat b) noexcept      { return _mm256_blendv_ps(b, a, mask); }
+        inline uint32_t movemask(vfloat mask) noexcept                      { return (uint32_t)_mm256_movemask_ps(mask); }
+        inline vfloat floor(vfloat a) noexcept                              { return _mm256_floor_ps(a); }
+
+        /** @return A mask where the lane i is set if the bit i of @param bits is set. */
+        inline vfloat mask_from_bits(uint32_t bits) noexcept
+        {
+            const __m256i b = _mm256_and_si256(_mm256_set1_epi32((int)bits), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128));
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(b, _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)));
+        }
+#else
+        using vfloat = __m128;
+        using vint = __m128i;
+        constexpr uint32_t WIDTH = 4;
+
+        inline vfloat load(const float* p) noexcept                         { return _mm_load_ps(p); }
+        inline vfloat loadu(const float* p) noexcept                        { return _mm_loadu_ps(p); }
+        inline void store(float* p, vfloat a) noexcept                      { _mm_store_ps(p, a); }
+        inline vfloat set1(float v) noexcept                                { return _mm_set1_ps(v); }
+        inline vfloat zero(void) noexcept                                   { return _mm_setzero_ps(); }
+        inline vfloat add(vfloat a, vfloat b) noexcept                      { return _mm_add_ps(a, b); }
+        inline vfloat sub(vfloat a, vfloat b) noexcept                      { return _mm_sub_ps(a, b); }
+        inline vfloat mul(vfloat a, vfloat b) noexcept                      { return _mm_mul_ps(a, b); }
+        inline vfloat div(vfloat a, vfloat b) noexcept                      { return _mm_div_ps(a, b); }
+        inline vfloat fmadd(vfloat a, vfloat b, vfloat c) noexcept          { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        inline vfloat sqrt(vfloat a) noexcept                               { return _mm_sqrt_ps(a); }
+        inline vfloat min(vfloat a, vfloat b) noexcept                      { return _mm_min_ps(a, b); }
+        inline vfloat max(vfloat a, vfloat b) noexcept                      { return _mm_max_ps(a, b); }
+        inline vfloat cmp_lt(vfloat a, vfloat b) noexcept                   { return _mm_cmplt_ps(a, b); }
+        inline vfloat cmp_le(vfloat a, vfloat b) noexcept                   { return _mm_cmple_ps(a, b); }
+        inline vfloat cmp_ge(vfloat a, vfloat b) noexcept                   { return _mm_cmpge_ps(a, b); }
+        inline vfloat bit_and(vfloat a, vfloat b) noexcept                  { return _mm_and_ps(a, b); }
+        inline vfloat bit_or(vfloat a, vfloat b) noexcept                   { return _mm_or_ps(a, b); }
+        inline vfloat bit_andnot(vfloat a, vfloat b) noexcept               { return _mm_andnot_ps(a, b); }
+        inline vfloat bit_xor(vfloat a, vfloat b) noexcept                  { return _mm_xor_ps(a, b); }
+        inline vfloat select(vfloat mask, vfloat a, vfloat b) noexcept      { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        inline uint32_t movemask(vfloat mask) noexcept                      { return (uint32_t)_mm_movemask_ps(mask); }
+
+        inline vfloat floor(vfloat a) noexcept
+        {
+#if defined(__SSE4_1__)
+            return _mm_floor_ps(a);
+#else
+            // SSE2 has no floor, the truncated value is decremented if it was rounded up (negative values)
+            const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+#endif
+        }
+
+        /** @return A mask where the lane i is set if the bit i of @param bits is set. */
+        inline vfloat mask_from_bits(uint32_t bits) noexcept
+        {
+            const __m128i b = _mm_and_si128(_mm_set1_epi32((int)bits), _mm_setr_epi32(1, 2, 4, 8));
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(b, _mm_setr_epi32(1, 2, 4, 8)));
+        }
+#endif
+
+        /** @return The absolute value of every lane. */
+        inline vfloat abs(vfloat a) noexcept
+        {
+            return bit_andnot(set1(-0.0f), a);
+        }
+
+        /**
+         *  @return atan2(y, x) of every lane in radians, in the range [-pi, pi].
+         *  The arctangent is a polynomial of the Cephes library, the maximum error is about 2 ulp.
+         */
+        inline vfloat atan2(vfloat y, vfloat x) noexcept
+        {
+            const vfloat ax = abs(x), ay = abs(y);
+            const vfloat swap = cmp_lt(ax, ay);
+
+            // a = min / max is in [0, 1], a larger than tan(pi/8) is reduced to (a - 1) / (a + 1)
+            const vfloat a = div(min(ax, ay), max(max(ax, ay), set1(1e-30f)));
+            const vfloat reduce = cmp_lt(set1(0.41421356f), a);
+            const vfloat r = select(reduce, div(sub(a, set1(1.0f)), add(a, set1(1.0f))), a);
+            const vfloat z = mul(r, r);
+
+            vfloat p = fmadd(set1(8.05374449538e-2f), z, set1(-1.38776856032e-1f));
+            p = fmadd(p, z, set1(1.99777106478e-1f));
+            p = fmadd(p, z, set1(-3.33329491539e-1f));
+            p = fmadd(mul(p, z), r, r);
+            p = add(p, bit_and(reduce, set1(0.78539816f)));
+
+            // undo the swap of x and y and move the angle into its quadrant
+            p = select(swap, sub(set1(1.57079633f), p), p);
+            p = select(cmp_lt(x, zero()), sub(set1(3.14159265f), p), p);
+            return bit_xor(p, bit_and(y, set1(-0.0f)));
+        }
+
+        /**
+         *  @return asin(x) of every lane in radians, x is clamped to [-1, 1].
+         *  The arcsine is a polynomial of the Cephes library, the maximum error is about 2 ulp.
+         */
+        inline vfloat asin(vfloat x) noexcept
+        {
+            const vfloat a = min(abs(x), set1(1.0f));
+
+            // for |x| > 0.5: asin(x) = pi/2 - 2 * asin(sqrt((1 - x) / 2))
+            const vfloat big = cmp_lt(set1(0.5f), a);
+            const vfloat z = select(big, mul(set1(0.5f), sub(set1(1.0f), a)), mul(a, a));
+            const vfloat s = select(big, sqrt(z), a);
+
+            vfloat p = fmadd(set1(4.2163199048e-2f), z, set1(2.4181311049e-2f));
+            p = fmadd(p, z, set1(4.5470025998e-2f));
+            p = fmadd(p, z, set1(7.4953002686e-2f));
+            p = fmadd(p, z, set1(1.6666752422e-1f));
+            p = fmadd(mul(p, z), s, s);
+            p = select(big, sub(set1(1.57079633f), add(p, p)), p);
+            return bit_xor(p, bit_and(x, set1(-0.0f)));
+        }
+
+        /**
+         *  @return A fast approximation of atan2(y, x) of every lane in radians.
+         *  The arctangent is the polynomial 4.4.49 of Abramowitz and Stegun, the maximum error is 1.2e-5 radians.
+         */
+        inline vfloat atan2_fast(vfloat y, vfloat x) noexcept
+        {
+            const vfloat ax = abs(x), ay = abs(y);
+            const vfloat swap = cmp_lt(ax, ay);
+            const vfloat a = div(min(ax, ay), max(max(ax, ay), set1(1e-30f)));
+            const vfloat z = mul(a, a);
+
+            vfloat p = fmadd(set1(0.0208351f), z, set1(-0.0851330f));
+            p = fmadd(p, z, set1(0.1801410f));
+            p = fmadd(p, z, set1(-0.3302995f));
+            p = fmadd(p, z, set1(0.9998660f));
+            p = mul(p, a);
+
+            p = select(swap, sub(set1(1.57079633f), p), p);
+            p = select(cmp_lt(x, zero()), sub(set1(3.14159265f), p), p);
+            return bit_xor(p, bit_and(y, set1(-0.0f)));
+        }
+
+        /**
+         *  @return A fast approximation of asin(x) of every lane in radians, x is clamped to [-1, 1].
+         *  The arcsine is combuted from the polynomial 4.4.45 of Abramowitz and Stegun, the maximum error is 7e-5 radians.
+         */
+        inline vfloat asin_fast(vfloat x) noexcept
+        {
+            const vfloat a = min(abs(x), set1(1.0f));
+
+            // asin(a) = pi/2 - acos(a), acos(a) = sqrt(1 - a) * polynomial(a)
+            vfloat p = fmadd(set1(-0.0187293f), a, set1(0.0742610f));
+            p = fmadd(p, a, set1(-0.2121144f));
+            p = fmadd(p, a, set1(1.5707288f));
+            p = sub(set1(1.57079633f), mul(sqrt(sub(set1(1.0f), a)), p));
+            return bit_xor(p, bit_and(x, set1(-0.0f)));
+        }
+    }
+}
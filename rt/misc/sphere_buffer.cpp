@@ -0,0 +1,540 @@
+/**
+* @file     sphere_buffer.cpp
+* @brief    Implementation of the SIMD sphere buffer.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "sphere_buffer.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace rt;
+
+SphereBuffer::storage_t::storage_t(void) noexcept
+{
+    this->layout_info = BufferLayout();
+    this->capacity = 0;
+    this->center_x = nullptr;
+    this->center_y = nullptr;
+    this->center_z = nullptr;
+    this->radius = nullptr;
+    this->revision = 0;
+}
+
+SphereBuffer::storage_t::~storage_t(void)
+{
+    _mm_free(this->center_x);
+    _mm_free(this->center_y);
+    _mm_free(this->center_z);
+    _mm_free(this->radius);
+}
+
+void SphereBuffer::storage_t::allocate(void)
+{
+    // padding lanes and empty slots have a NaN-center, every comparison with NaN is false, so they never get hit
+    constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+
+    const size_t old_capacity = this->capacity;
+    const size_t new_capacity = (this->layout_info.size + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    float* arrays[4] = { this->center_x, this->center_y, this->center_z, this->radius };
+
+    for (uint32_t a = 0; a < 4; a++)
+    {
+        float* mem = (new_capacity > 0) ? (float*)_mm_malloc(new_capacity * sizeof(float), 32) : nullptr;
+        const size_t n_copy = std::min(old_capacity, new_capacity);
+        if (arrays[a] != nullptr && n_copy > 0)
+            memcpy(mem, arrays[a], n_copy * sizeof(float));
+        for (size_t i = n_copy; i < new_capacity; i++)
+            mem[i] = nan;
+        if (arrays[a] != nullptr)
+            _mm_free(arrays[a]);
+        arrays[a] = mem;
+    }
+
+    this->center_x = arrays[0];
+    this->center_y = arrays[1];
+    this->center_z = arrays[2];
+    this->radius   = arrays[3];
+    this->capacity = new_capacity;
+
+    // slots beyond the size are padding and must not be hit
+    for (size_t i = this->layout_info.size; i < new_capacity; i++)
+        this->center_x[i] = this->center_y[i] = this->center_z[i] = this->radius[i] = nan;
+    this->prims.resize(this->layout_info.size);
+}
+
+SphereBuffer::SphereBuffer(void) noexcept
+{
+    // the storage is created when the buffer is modified the first time
+}
+
+SphereBuffer::SphereBuffer(const BufferLayout& layout_info) : SphereBuffer()
+{
+    this->set_layout(layout_info);
+}
+
+SphereBuffer::SphereBuffer(const SphereBuffer& buff) : SphereBuffer()
+{
+    *this = buff;
+}
+
+SphereBuffer& SphereBuffer::operator= (const SphereBuffer& buff)
+{
+    this->_storage = buff._storage;     // share the spheres, they get copied if one of the buffers is modified
+    return *this;
+}
+
+SphereBuffer::SphereBuffer(SphereBuffer&& buff) noexcept : SphereBuffer()
+{
+    *this = std::move(buff);
+}
+
+SphereBuffer& SphereBuffer::operator= (SphereBuffer&& buff) noexcept
+{
+    this->_storage = std::move(buff._storage);  // other instance is empty afterwards
+    return *this;
+}
+
+SphereBuffer::~SphereBuffer(void)
+{
+    // the arrays are freed by the storage as soon as no buffer references them anymore
+}
+
+SphereBuffer::storage_t& SphereBuffer::modify(void)
+{
+    if (this->_storage == nullptr)
+    {
+        this->_storage = std::make_shared<storage_t>();
+    }
+    else if (this->_storage.use_count() > 1)
+    {
+        // the spheres are shared, copy them before they are modified
+        std::shared_ptr<storage_t> copy = std::make_shared<storage_t>();
+        copy->layout_info = this->_storage->layout_info;
+        copy->allocate();
+        memcpy(copy->center_x, this->_storage->center_x, copy->capacity * sizeof(float));
+        memcpy(copy->center_y, this->_storage->center_y, copy->capacity * sizeof(float));
+        memcpy(copy->center_z, this->_storage->center_z, copy->capacity * sizeof(float));
+        memcpy(copy->radius, this->_storage->radius, copy->capacity * sizeof(float));
+        copy->prims = this->_storage->prims;
+        this->_storage = std::move(copy);
+    }
+    this->_storage->revision = next_revision();
+    return *this->_storage;
+}
+
+void SphereBuffer::set_layout(const BufferLayout& layout_info)
+{
+    storage_t& storage = this->modify();
+    storage.layout_info = layout_info;
+    storage.allocate();
+}
+
+const BufferLayout& SphereBuffer::layout(void) const noexcept
+{
+    static const BufferLayout empty_layout;
+    return (this->_storage == nullptr) ? empty_layout : this->_storage->layout_info;
+}
+
+BufferError SphereBuffer::data(size_t pos, const Sphere& sphere)
+{
+    if (pos >= this->layout().size)
+        return BufferError::RT_BUFFER_ERROR_OVERFLOW;
+
+    storage_t& storage = this->modify();
+    storage.center_x[pos]   = sphere.center().x;
+    storage.center_y[pos]   = sphere.center().y;
+    storage.center_z[pos]   = sphere.center().z;
+    storage.radius[pos]     = sphere.radius();
+    storage.prims[pos].clear_attribute();               // the assignment keeps the old attribute if the sphere has none
+    storage.prims[pos]      = sphere;
+    return BufferError::RT_BUFFER_ERROR_NONE;
+}
+
+BufferError SphereBuffer::data(size_t begin, size_t count, const Sphere* spheres)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        BufferError err = this->data(begin + i, spheres[i]);
+        if (err != BufferError::RT_BUFFER_ERROR_NONE)
+            return err;
+    }
+    return BufferError::RT_BUFFER_ERROR_NONE;
+}
+
+void SphereBuffer::clear(void)
+{
+    if (this->_storage == nullptr) return;
+    if (this->_storage.use_count() > 1)
+    {
+        // do not copy spheres that would be removed anyway
+        const BufferLayout layout_info = this->_storage->layout_info;
+        this->_storage = std::make_shared<storage_t>();
+        this->_storage->layout_info = layout_info;
+        this->_storage->allocate();
+        this->_storage->revision = next_revision();
+        return;
+    }
+
+    constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+    storage_t& storage = this->modify();
+    for (size_t i = 0; i < storage.capacity; i++)
+        storage.center_x[i] = storage.center_y[i] = storage.center_z[i] = storage.radius[i] = nan;
+    const size_t n = storage.prims.size();
+    storage.prims.clear();
+    storage.prims.resize(n);
+}
+
+/*  The SIMD intersection test is the same as Sphere::_intersect but with b = dot(D, OC) instead of b = 2 * dot(D, OC),
+    which saves some multiplications: t0,1 = -b -+ sqrt(b^2 - c).
+    For every lane the closest hit, the index of the sphere and the hit information are kept and
+    reduced to a single hit after all spheres are tested. */
+#if defined(__AVX2__)
+float SphereBuffer::intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const
+{
+    const BufferLayout& layout_info = this->layout();
+    const size_t last = std::min(layout_info.last, layout_info.size);
+    const size_t first = layout_info.first;
+    if (first >= last) return t_max;
+    const storage_t& storage = *this->_storage;
+
+    const __m256 ox = _mm256_set1_ps(ray.origin.x);
+    const __m256 oy = _mm256_set1_ps(ray.origin.y);
+    const __m256 oz = _mm256_set1_ps(ray.origin.z);
+    const __m256 dx = _mm256_set1_ps(ray.direction.x);
+    const __m256 dy = _mm256_set1_ps(ray.direction.y);
+    const __m256 dz = _mm256_set1_ps(ray.direction.z);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 front_enabled = (cull_mask & RT_CULL_MASK_FRONT_BIT) ? zero : _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    const __m256 back_enabled = (cull_mask & RT_CULL_MASK_BACK_BIT) ? zero : _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    const __m256i first_idx = _mm256_set1_epi32((int)first - 1);
+    const __m256i last_idx = _mm256_set1_epi32((int)last);
+    const __m256i step = _mm256_set1_epi32((int)SIMD_WIDTH);
+
+    __m256 t_best = _mm256_set1_ps(t_max);
+    __m256i idx_best = _mm256_set1_epi32(-1);
+    __m256i info_best = _mm256_setzero_si256();
+    __m256i idx = _mm256_add_epi32(_mm256_set1_epi32((int)(first / SIMD_WIDTH * SIMD_WIDTH)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    for (size_t i = first / SIMD_WIDTH * SIMD_WIDTH; i < last; i += SIMD_WIDTH)
+    {
+        const __m256 ocx = _mm256_sub_ps(ox, _mm256_load_ps(storage.center_x + i));
+        const __m256 ocy = _mm256_sub_ps(oy, _mm256_load_ps(storage.center_y + i));
+        const __m256 ocz = _mm256_sub_ps(oz, _mm256_load_ps(storage.center_z + i));
+        const __m256 r = _mm256_load_ps(storage.radius + i);
+
+        const __m256 b = _mm256_fmadd_ps(dx, ocx, _mm256_fmadd_ps(dy, ocy, _mm256_mul_ps(dz, ocz)));
+        const __m256 c = _mm256_fmadd_ps(ocx, ocx, _mm256_fmadd_ps(ocy, ocy, _mm256_fmsub_ps(ocz, ocz, _mm256_mul_ps(r, r))));
+        const __m256 delta = _mm256_fmsub_ps(b, b, c);
+        const __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(delta, zero));
+        const __m256 t0 = _mm256_sub_ps(_mm256_sub_ps(zero, b), sq);
+        const __m256 t1 = _mm256_sub_ps(sq, b);
+
+        // front: t0 >= 0 (t1 >= t0), back: t0 < 0 and t1 >= 0, NaN-lanes fail every comparison
+        const __m256 valid = _mm256_cmp_ps(delta, zero, _CMP_GE_OQ);
+        const __m256 front = _mm256_and_ps(_mm256_and_ps(valid, front_enabled), _mm256_cmp_ps(t0, zero, _CMP_GE_OQ));
+        const __m256 back = _mm256_and_ps(_mm256_and_ps(valid, back_enabled), _mm256_and_ps(_mm256_cmp_ps(t0, zero, _CMP_LT_OQ), _mm256_cmp_ps(t1, zero, _CMP_GE_OQ)));
+        const __m256 t_cur = _mm256_blendv_ps(t1, t0, front);
+
+        // only spheres within the range [first, last) of the layout are processed
+        const __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi32(idx, first_idx), _mm256_cmpgt_epi32(last_idx, idx));
+        const __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_or_ps(front, back), _mm256_cmp_ps(t_cur, t_best, _CMP_LT_OQ)), _mm256_castsi256_ps(in_range));
+
+        t_best = _mm256_blendv_ps(t_best, t_cur, hit);
+        idx_best = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(idx_best), _mm256_castsi256_ps(idx), hit));
+        const __m256i info = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_set1_epi32(RT_HIT_INFO_BACK_BIT)), _mm256_castsi256_ps(_mm256_set1_epi32(RT_HIT_INFO_FRONT_BIT)), front));
+        info_best = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(info_best), _mm256_castsi256_ps(info), hit));
+        idx = _mm256_add_epi32(idx, step);
+    }
+
+    alignas(32) float t_lanes[SIMD_WIDTH];
+    alignas(32) int32_t idx_lanes[SIMD_WIDTH];
+    alignas(32) uint32_t info_lanes[SIMD_WIDTH];
+    _mm256_store_ps(t_lanes, t_best);
+    _mm256_store_si256((__m256i*)idx_lanes, idx_best);
+    _mm256_store_si256((__m256i*)info_lanes, info_best);
+#else
+float SphereBuffer::intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const
+{
+    const BufferLayout& layout_info = this->layout();
+    const size_t last = std::min(layout_info.last, layout_info.size);
+    const size_t first = layout_info.first;
+    if (first >= last) return t_max;
+    const storage_t& storage = *this->_storage;
+
+    constexpr size_t SSE_WIDTH = 4;
+    const __m128 ox = _mm_set1_ps(ray.origin.x);
+    const __m128 oy = _mm_set1_ps(ray.origin.y);
+    const __m128 oz = _mm_set1_ps(ray.origin.z);
+    const __m128 dx = _mm_set1_ps(ray.direction.x);
+    const __m128 dy = _mm_set1_ps(ray.direction.y);
+    const __m128 dz = _mm_set1_ps(ray.direction.z);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 front_enabled = (cull_mask & RT_CULL_MASK_FRONT_BIT) ? zero : _mm_castsi128_ps(_mm_set1_epi32(-1));
+    const __m128 back_enabled = (cull_mask & RT_CULL_MASK_BACK_BIT) ? zero : _mm_castsi128_ps(_mm_set1_epi32(-1));
+    const __m128i first_idx = _mm_set1_epi32((int)first - 1);
+    const __m128i last_idx = _mm_set1_epi32((int)last);
+    const __m128i step = _mm_set1_epi32((int)SSE_WIDTH);
+
+    __m128 t_best = _mm_set1_ps(t_max);
+    __m128 idx_best = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128 info_best = _mm_setzero_ps();
+    __m128i idx = _mm_add_epi32(_mm_set1_epi32((int)(first / SSE_WIDTH * SSE_WIDTH)), _mm_setr_epi32(0, 1, 2, 3));
+
+    for (size_t i = first / SSE_WIDTH * SSE_WIDTH; i < last; i += SSE_WIDTH)
+    {
+        const __m128 ocx = _mm_sub_ps(ox, _mm_load_ps(storage.center_x + i));
+        const __m128 ocy = _mm_sub_ps(oy, _mm_load_ps(storage.center_y + i));
+        const __m128 ocz = _mm_sub_ps(oz, _mm_load_ps(storage.center_z + i));
+        const __m128 r = _mm_load_ps(storage.radius + i);
+
+        const __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ocx), _mm_mul_ps(dy, ocy)), _mm_mul_ps(dz, ocz));
+        const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), _mm_mul_ps(r, r));
+        const __m128 delta = _mm_sub_ps(_mm_mul_ps(b, b), c);
+        const __m128 sq = _mm_sqrt_ps(_mm_max_ps(delta, zero));
+        const __m128 t0 = _mm_sub_ps(_mm_sub_ps(zero, b), sq);
+        const __m128 t1 = _mm_sub_ps(sq, b);
+
+        const __m128 valid = _mm_cmpge_ps(delta, zero);
+        const __m128 front = _mm_and_ps(_mm_and_ps(valid, front_enabled), _mm_cmpge_ps(t0, zero));
+        const __m128 back = _mm_and_ps(_mm_and_ps(valid, back_enabled), _mm_and_ps(_mm_cmplt_ps(t0, zero), _mm_cmpge_ps(t1, zero)));
+        const __m128 t_cur = _mm_or_ps(_mm_and_ps(front, t0), _mm_andnot_ps(front, t1));
+
+        const __m128i in_range = _mm_and_si128(_mm_cmpgt_epi32(idx, first_idx), _mm_cmplt_epi32(idx, last_idx));
+        const __m128 hit = _mm_and_ps(_mm_and_ps(_mm_or_ps(front, back), _mm_cmplt_ps(t_cur, t_best)), _mm_castsi128_ps(in_range));
+
+        const __m128 info = _mm_or_ps(_mm_and_ps(front, _mm_castsi128_ps(_mm_set1_epi32(RT_HIT_INFO_FRONT_BIT))),
+                                      _mm_andnot_ps(front, _mm_castsi128_ps(_mm_set1_epi32(RT_HIT_INFO_BACK_BIT))));
+        t_best = _mm_or_ps(_mm_and_ps(hit, t_cur), _mm_andnot_ps(hit, t_best));
+        idx_best = _mm_or_ps(_mm_and_ps(hit, _mm_castsi128_ps(idx)), _mm_andnot_ps(hit, idx_best));
+        info_best = _mm_or_ps(_mm_and_ps(hit, info), _mm_andnot_ps(hit, info_best));
+        idx = _mm_add_epi32(idx, step);
+    }
+
+    alignas(16) float t_lanes[SSE_WIDTH];
+    alignas(16) int32_t idx_lanes[SSE_WIDTH];
+    alignas(16) uint32_t info_lanes[SSE_WIDTH];
+    _mm_store_ps(t_lanes, t_best);
+    _mm_store_ps((float*)idx_lanes, idx_best);
+    _mm_store_ps((float*)info_lanes, info_best);
+#endif
+
+    // reduce the lanes to the closest hit, if two hits have the same length the sphere with the lower index wins
+    float t = t_max;
+    int32_t best = -1;
+    for (size_t l = 0; l < sizeof(t_lanes) / sizeof(float); l++)
+    {
+        if (idx_lanes[l] >= 0 && (t_lanes[l] < t || (t_lanes[l] == t && best >= 0 && idx_lanes[l] < idx_lanes[best])))
+        {
+            t = t_lanes[l];
+            best = (int32_t)l;
+        }
+    }
+
+    if (best >= 0)
+    {
+        hit_info = info_lanes[best];
+        if (hit_prim != nullptr)
+            *hit_prim = &storage.prims[idx_lanes[best]];
+    }
+    return t;
+}
+
+void SphereBuffer::intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const
+{
+    using namespace simd;
+    const BufferLayout& layout_info = this->layout();
+    const size_t last = std::min(layout_info.last, layout_info.size);
+    const size_t first = layout_info.first;
+    if (first >= last || mask == 0) return;
+    const storage_t& storage = *this->_storage;
+
+    const vfloat zero = simd::zero();
+    const vfloat ox = load(packet.origin_x);
+    const vfloat oy = load(packet.origin_y);
+    const vfloat oz = load(packet.origin_z);
+    const vfloat dx = load(packet.direction_x);
+    const vfloat dy = load(packet.direction_y);
+    const vfloat dz = load(packet.direction_z);
+    const vfloat active = mask_from_bits(mask);
+    const vfloat front_enabled = (cull_mask & RT_CULL_MASK_FRONT_BIT) ? zero : active;
+    const vfloat back_enabled = (cull_mask & RT_CULL_MASK_BACK_BIT) ? zero : active;
+
+    vfloat t_best = loadu(t);
+    uint32_t front_best = 0;                    // bit i is set if the closest hit of ray i is a front-hit
+    int64_t idx_best[RT_RAY_PACKET_SIZE];       // closest sphere of every ray
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+        idx_best[i] = -1;
+
+    // every sphere is tested against the whole packet, the sphere is broadcasted to all lanes
+    for (size_t s = first; s < last; s++)
+    {
+        const vfloat ocx = sub(ox, set1(storage.center_x[s]));
+        const vfloat ocy = sub(oy, set1(storage.center_y[s]));
+        const vfloat ocz = sub(oz, set1(storage.center_z[s]));
+        const float r = storage.radius[s];
+
+        const vfloat b = fmadd(dx, ocx, fmadd(dy, ocy, mul(dz, ocz)));
+        const vfloat c = sub(fmadd(ocx, ocx, fmadd(ocy, ocy, mul(ocz, ocz))), set1(r * r));
+        const vfloat delta = sub(mul(b, b), c);
+        const vfloat valid = cmp_ge(delta, zero);
+        if (movemask(valid) == 0) continue;
+
+        const vfloat sq = simd::sqrt(max(delta, zero));
+        const vfloat t0 = sub(sub(zero, b), sq);
+        const vfloat t1 = sub(sq, b);
+        const vfloat front = bit_and(bit_and(valid, front_enabled), cmp_ge(t0, zero));
+        const vfloat back = bit_and(bit_and(valid, back_enabled), bit_and(cmp_lt(t0, zero), cmp_ge(t1, zero)));
+        const vfloat t_cur = select(front, t0, t1);
+        const vfloat hit = bit_and(bit_or(front, back), cmp_lt(t_cur, t_best));
+
+        const uint32_t hit_mask = movemask(hit);
+        if (hit_mask == 0) continue;
+
+        t_best = select(hit, t_cur, t_best);
+        front_best = (front_best & ~hit_mask) | (movemask(front) & hit_mask);
+        for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+        {
+            if (hit_mask & (1 << i))
+                idx_best[i] = (int64_t)s;
+        }
+    }
+
+    alignas(32) float t_lanes[RT_RAY_PACKET_SIZE];
+    store(t_lanes, t_best);
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        if (idx_best[i] < 0) continue;
+        t[i] = t_lanes[i];
+        hit_info[i] = (front_best & (1 << i)) ? RT_HIT_INFO_FRONT_BIT : RT_HIT_INFO_BACK_BIT;
+        if (hit_prim != nullptr)
+            hit_prim[i] = &storage.prims[idx_best[i]];
+    }
+}
+
+bool SphereBuffer::occluded(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const
+{
+    using namespace simd;
+    const BufferLayout& layout_info = this->layout();
+    const size_t last = std::min(layout_info.last, layout_info.size);
+    const size_t first = layout_info.first;
+    if (first >= last) return false;
+    const storage_t& storage = *this->_storage;
+
+    const vfloat zero = simd::zero();
+    const vfloat all = cmp_ge(zero, zero);
+    const vfloat ox = set1(ray.origin.x);
+    const vfloat oy = set1(ray.origin.y);
+    const vfloat oz = set1(ray.origin.z);
+    const vfloat dx = set1(ray.direction.x);
+    const vfloat dy = set1(ray.direction.y);
+    const vfloat dz = set1(ray.direction.z);
+    const vfloat t_end = set1(t_max);
+    const vfloat front_enabled = (cull_mask & RT_CULL_MASK_FRONT_BIT) ? zero : all;
+    const vfloat back_enabled = (cull_mask & RT_CULL_MASK_BACK_BIT) ? zero : all;
+
+    for (size_t i = first / WIDTH * WIDTH; i < last; i += WIDTH)
+    {
+        const vfloat ocx = sub(ox, load(storage.center_x + i));
+        const vfloat ocy = sub(oy, load(storage.center_y + i));
+        const vfloat ocz = sub(oz, load(storage.center_z + i));
+        const vfloat r = load(storage.radius + i);
+
+        const vfloat b = fmadd(dx, ocx, fmadd(dy, ocy, mul(dz, ocz)));
+        const vfloat c = sub(fmadd(ocx, ocx, fmadd(ocy, ocy, mul(ocz, ocz))), mul(r, r));
+        const vfloat delta = sub(mul(b, b), c);
+        const vfloat sq = simd::sqrt(max(delta, zero));
+        const vfloat t0 = sub(sub(zero, b), sq);
+        const vfloat t1 = sub(sq, b);
+
+        // same hit classification as the closest hit test, NaN-lanes fail every comparison
+        const vfloat valid = cmp_ge(delta, zero);
+        const vfloat front = bit_and(bit_and(valid, front_enabled), cmp_ge(t0, zero));
+        const vfloat back = bit_and(bit_and(valid, back_enabled), bit_and(cmp_lt(t0, zero), cmp_ge(t1, zero)));
+        const vfloat t_cur = select(front, t0, t1);
+        const uint32_t hits = movemask(bit_and(bit_or(front, back), cmp_lt(t_cur, t_end)));
+        if (hits == 0) continue;
+
+        alignas(32) float t_lanes[WIDTH];
+        store(t_lanes, t_cur);
+        const uint32_t front_bits = movemask(front);
+        for (uint32_t l = 0; l < WIDTH; l++)
+        {
+            const size_t s = i + l;
+            if (!(hits & (1 << l)) || s < first || s >= last) continue;
+            if (any_hit == nullptr) return true;
+
+            const RayHitInformation hit_info = (front_bits & (1 << l)) ? RT_HIT_INFO_FRONT_BIT : RT_HIT_INFO_BACK_BIT;
+            if (any_hit(user_data, ray, t_lanes[l], &storage.prims[s], hit_info))
+                return true;
+        }
+    }
+    return false;
+}
+
+float SphereBuffer::distance(const glm::vec3& p, float d_max, const Primitive** hit_prim) const
+{
+    const BufferLayout& layout_info = this->layout();
+    const size_t last = std::min(layout_info.last, layout_info.size);
+    const size_t first = layout_info.first;
+    if (first >= last) return d_max;
+    const storage_t& storage = *this->_storage;
+
+    alignas(32) float lane_offsets[simd::WIDTH];
+    for (uint32_t l = 0; l < simd::WIDTH; l++)
+        lane_offsets[l] = (float)l;
+
+    const simd::vfloat px = simd::set1(p.x);
+    const simd::vfloat py = simd::set1(p.y);
+    const simd::vfloat pz = simd::set1(p.z);
+    const simd::vfloat offsets = simd::load(lane_offsets);
+    const simd::vfloat first_idx = simd::set1((float)first);
+    const simd::vfloat last_idx = simd::set1((float)last);
+
+    // the indices are stored as floats, they are exact up to 2^24 spheres
+    simd::vfloat d_best = simd::set1(d_max);
+    simd::vfloat idx_best = simd::set1(-1.0f);
+
+    for (size_t i = first / simd::WIDTH * simd::WIDTH; i < last; i += simd::WIDTH)
+    {
+        const simd::vfloat dx = simd::sub(px, simd::load(storage.center_x + i));
+        const simd::vfloat dy = simd::sub(py, simd::load(storage.center_y + i));
+        const simd::vfloat dz = simd::sub(pz, simd::load(storage.center_z + i));
+        const simd::vfloat d = simd::sub(simd::sqrt(simd::fmadd(dx, dx, simd::fmadd(dy, dy, simd::mul(dz, dz)))), simd::load(storage.radius + i));
+
+        // NaN-lanes (empty spheres) fail the comparison
+        const simd::vfloat idx = simd::add(simd::set1((float)i), offsets);
+        const simd::vfloat in_range = simd::bit_and(simd::cmp_ge(idx, first_idx), simd::cmp_lt(idx, last_idx));
+        const simd::vfloat closer = simd::bit_and(simd::cmp_lt(d, d_best), in_range);
+        d_best = simd::select(closer, d, d_best);
+        idx_best = simd::select(closer, idx, idx_best);
+    }
+
+    alignas(32) float d_lanes[simd::WIDTH];
+    alignas(32) float idx_lanes[simd::WIDTH];
+    simd::store(d_lanes, d_best);
+    simd::store(idx_lanes, idx_best);
+
+    // reduce the lanes to the closest sphere, if two spheres have the same distance the sphere with the lower index wins
+    float d = d_max;
+    int32_t best = -1;
+    for (uint32_t l = 0; l < simd::WIDTH; l++)
+    {
+        if (idx_lanes[l] >= 0.0f && (d_lanes[l] < d || (d_lanes[l] == d && best >= 0 && idx_lanes[l] < idx_lanes[best])))
+        {
+            d = d_lanes[l];
+            best = (int32_t)l;
+        }
+    }
+
+    if (best >= 0 && hit_prim != nullptr)
+        *hit_prim = &storage.prims[(size_t)idx_lanes[best]];
+    return d;
+}
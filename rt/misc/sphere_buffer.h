@@ -0,0 +1,145 @@
+/**
+* @file     sphere_buffer.h
+* @brief    Buffer that stores spheres in a structure of arrays and intersects them with SIMD instructions.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "geometry_buffer.h"
+#include "../primitive/sphere.h"
+#include <memory>
+#include <vector>
+
+namespace rt
+{
+    /**
+     *  This class stores the centers and radii of spheres in seperate float arrays (SoA).
+     *  The intersection test is done for 8 spheres at once with AVX2 instructions,
+     *  or for 4 spheres at once with SSE instructions if AVX2 is not aviable.
+     *  The spheres themselves are also stored, they are the primitives that are passed to
+     *  the shaders and own the primitive attributes. The index of a sphere within the arrays
+     *  is used to look them up.
+     *  Copies of a buffer share the arrays and the spheres, they are only duplicated if a
+     *  buffer that shares them is modified. Drawing a sphere buffer does not copy it.
+     *  But keep in mind that the buffer is not thread save. If you decide to stream
+     *  data into the buffer by a secondary thread, YOU have to make it multithreading-save!
+     */
+    class SphereBuffer : public GeometryBuffer
+    {
+    private:
+        // arrays and spheres that are shared between the copies of a buffer
+        struct storage_t
+        {
+            BufferLayout layout_info;
+            size_t capacity;            // number of elements of the arrays, multiple of the SIMD width
+            float* center_x;            // x-coordinates of the sphere centers
+            float* center_y;            // y-coordinates of the sphere centers
+            float* center_z;            // z-coordinates of the sphere centers
+            float* radius;              // radii of the spheres
+            std::vector<Sphere> prims;  // spheres that are reported to the shaders
+            uint64_t revision;          // changes with every modification, unique among all geometry buffers
+
+            storage_t(void) noexcept;
+            storage_t(const storage_t&) = delete;
+            storage_t& operator= (const storage_t&) = delete;
+            ~storage_t(void);
+
+            // allocates or reallocates the arrays
+            void allocate(void);
+        };
+
+        std::shared_ptr<storage_t> _storage;
+
+        // makes the storage unique to this buffer before it is modified and updates the revision
+        storage_t& modify(void);
+
+    public:
+        static constexpr size_t SIMD_WIDTH = 8;     // arrays are padded to a multiple of this width
+
+        /**
+         *  NOTE: By default the buffer info is set to its default values,
+         *  which means the buffer is empty.
+         */
+        SphereBuffer(void) noexcept;
+
+        /** @param[in] layout_info: Buffer-layout information. */
+        explicit SphereBuffer(const BufferLayout& layout_info);
+
+        SphereBuffer(const SphereBuffer& buff);
+        SphereBuffer& operator= (const SphereBuffer& buff);
+        SphereBuffer(SphereBuffer&& buff) noexcept;
+        SphereBuffer& operator= (SphereBuffer&& buff) noexcept;
+
+        virtual ~SphereBuffer(void);
+
+        /**
+         *  @brief Sets / updates the buffer layout info.
+         *  Spheres that would be out of bounds get removed.
+         *  @param[in] layout_info: Buffer-layout information.
+         */
+        void set_layout(const BufferLayout& layout_info);
+
+        /**
+         *  Loads one sphere into the buffer at position @param pos.
+         *  @param[in] pos: Position to put the sphere in.
+         *  @param[in] sphere: The sphere to load in.
+         *  @return Error if something went wrong.
+         */
+        BufferError data(size_t pos, const Sphere& sphere);
+
+        /**
+         *  @brief Loads an array of spheres into the buffer.
+         *  @param[in] begin: Offset to the first sphere.
+         *  @param[in] count: Number of spheres to copy into the buffer.
+         *  @param[in] spheres: The array of spheres.
+         *  @return Error if something went wrong.
+         */
+        BufferError data(size_t begin, size_t count, const Sphere* spheres);
+
+        /** @return The sphere at position @param pos. */
+        inline const Sphere& sphere(size_t pos) const noexcept
+        {return this->_storage->prims[pos];}
+
+        /** @return Buffer-layout information. */
+        const BufferLayout& layout(void) const noexcept;
+
+        /**
+         *  @return The revision of the spheres. The revision changes every time the buffer is modified.
+         *  Copies of a buffer have the same revision until one of them is modified.
+         *  A default constructed buffer has the revision 0.
+         */
+        virtual uint64_t revision(void) const noexcept
+        {return (this->_storage == nullptr) ? 0 : this->_storage->revision;}
+
+        /** @brief Removes every sphere from the buffer, the layout stays the same. */
+        void clear(void);
+
+        /**
+         *  @brief Intersection test for a ray with every sphere in the range [first, last) of the buffer-layout.
+         *  The front- and back-face culling and the hit information behave the same as for the rt::Sphere.
+         */
+        virtual float intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const;
+
+        /**
+         *  @brief Intersection test for a ray packet with every sphere in the range [first, last) of the buffer-layout.
+         *  Every sphere is tested against all rays of the packet at once.
+         */
+        virtual void intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const;
+
+        /** @brief Tests if a ray hits any sphere in the range [first, last) of the buffer-layout, stops at the first accepted hit. */
+        virtual bool occluded(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const;
+
+        /** @brief Distance from a point to the closest sphere in the range [first, last) of the buffer-layout. */
+        virtual float distance(const glm::vec3& p, float d_max, const Primitive** hit_prim) const;
+
+        /** @return A dynamic clone of the sphere buffer, the clone shares the spheres with this buffer. */
+        virtual GeometryBuffer* clone_dynamic(void) const
+        {return new SphereBuffer(*this);}
+    };
+}
@@ -0,0 +1,75 @@
+/**
+* @file     tile_scheduler.cpp
+* @brief    Implementation of the work stealing tile scheduler.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "tile_scheduler.h"
+#include <algorithm>
+
+using namespace rt;
+
+void TileScheduler::init(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t n_threads)
+{
+    if (tile_size == 0) tile_size = 1;
+    if (n_threads == 0) n_threads = 1;
+    this->_queues = std::vector<queue_t>(n_threads);
+
+    const uint32_t n_tiles_x = (width + tile_size - 1) / tile_size;
+    const uint32_t n_tiles_y = (height + tile_size - 1) / tile_size;
+    const uint32_t n_tiles = n_tiles_x * n_tiles_y;
+
+    // thread t gets the tiles [t * n / T, (t + 1) * n / T)
+    for (uint32_t i = 0; i < n_tiles; i++)
+    {
+        const uint32_t tx = i % n_tiles_x;
+        const uint32_t ty = i / n_tiles_x;
+
+        tile_t tile;
+        tile.x0 = tx * tile_size;
+        tile.y0 = ty * tile_size;
+        tile.x1 = std::min(tile.x0 + tile_size, width);
+        tile.y1 = std::min(tile.y0 + tile_size, height);
+
+        const uint32_t t = (uint32_t)((uint64_t)i * n_threads / n_tiles);
+        this->_queues[t].tiles.push_back(tile);
+    }
+}
+
+bool TileScheduler::next(uint32_t thread_id, tile_t& tile)
+{
+    const uint32_t n_queues = (uint32_t)this->_queues.size();
+    if (n_queues == 0) return false;
+    thread_id %= n_queues;
+
+    // take the next tile of the own queue...
+    {
+        queue_t& own = this->_queues[thread_id];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tiles.empty())
+        {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // ...or steal the tile of another queue that would have been rendered last
+    for (uint32_t i = 1; i < n_queues; i++)
+    {
+        queue_t& victim = this->_queues[(thread_id + i) % n_queues];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tiles.empty())
+        {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
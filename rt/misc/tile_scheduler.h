@@ -0,0 +1,94 @@
+/**
+* @file     tile_scheduler.h
+* @brief    Distributes the tiles of the framebuffer to the render threads with work stealing.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace rt
+{
+    struct tile_t
+    {
+        uint32_t x0, y0;    // first pixel of the tile
+        uint32_t x1, y1;    // last pixel (exclusive) of the tile
+    };
+
+    /**
+     *  This class splits the framebuffer into square tiles and spreads them accross
+     *  one queue per thread. Every thread takes the tiles from the front of its own
+     *  queue, if the queue is empty it steals tiles from the back of the other queues.
+     *  That way expensive parts of the image do not make a single thread the straggler.
+     */
+    class TileScheduler
+    {
+    private:
+        struct queue_t
+        {
+            std::deque<tile_t> tiles;
+            std::mutex mtx;
+        };
+
+        std::vector<queue_t> _queues;   // one queue per thread
+
+    public:
+        TileScheduler(void) = default;
+
+        TileScheduler(const TileScheduler&) = delete;
+        TileScheduler& operator= (const TileScheduler&) = delete;
+
+        virtual ~TileScheduler(void) = default;
+
+        /**
+         *  @brief Splits the image into tiles and distributes them to the queues.
+         *  Every thread gets a contiguous block of tiles.
+         *  @param[in] width: Width of the image.
+         *  @param[in] height: Height of the image.
+         *  @param[in] tile_size: Edge length of a tile in pixels.
+         *  @param[in] n_threads: Number of threads (queues).
+         */
+        void init(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t n_threads);
+
+        /**
+         *  @brief Gets the next tile to render. This method is thread save.
+         *  @param[in] thread_id: Index of the calling thread.
+         *  @param[out] tile: The next tile to render.
+         *  @return False if there are no more tiles left.
+         */
+        bool next(uint32_t thread_id, tile_t& tile);
+
+        /**
+         *  @brief Converts the index of a pixel within a tile, walked along the Morton-order (Z-curve),
+         *  to the pixel coordinate relative to the tile.
+         *  @param[in] code: Morton code
+         *  @param[out] x: X-coordinate relative to the tile.
+         *  @param[out] y: Y-coordinate relative to the tile.
+         */
+        static inline void morton_decode(uint32_t code, uint32_t& x, uint32_t& y) noexcept
+        {
+            x = compact_bits(code);
+            y = compact_bits(code >> 1);
+        }
+
+        /** @return Every second bit of @param v compacted into the lower 16 bits. */
+        static inline uint32_t compact_bits(uint32_t v) noexcept
+        {
+            v &= 0x55555555;
+            v = (v ^ (v >> 1)) & 0x33333333;
+            v = (v ^ (v >> 2)) & 0x0f0f0f0f;
+            v = (v ^ (v >> 4)) & 0x00ff00ff;
+            v = (v ^ (v >> 8)) & 0x0000ffff;
+            return v;
+        }
+    };
+}
@@ -0,0 +1,22 @@
+/**
+* @file     typed_buffer.cpp
+* @brief    Explicit instantiation of the typed buffer for the built-in primitives.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+
+#include "typed_buffer.h"
+#include "../primitive/sphere.h"
+#include "../primitive/infplane.h"
+#include "../primitive/distancesphere.h"
+
+namespace rt
+{
+    // the typed buffer of all built-in primitive types is compiled into the library
+    template class TypedBuffer<Sphere, InfPlane, DistanceSphere>;
+}
@@ -0,0 +1,255 @@
+/**
+* @file     typed_buffer.h
+* @brief    Buffer that stores primitives by value, grouped by their type.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#pragma once
+
+#include "geometry_buffer.h"
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace rt
+{
+    /**
+     *  This class stores the primitives of the types @param Ts by value. Every type has its own
+     *  contiguous array, e.g. TypedBuffer<Sphere, InfPlane, DistanceSphere> has an array of spheres,
+     *  an array of planes and an array of distance spheres.
+     *  The intersection loop is generated for every type at compile time and calls the intersection
+     *  test of the type directly (not through the vtable), so there is no pointer chasing and
+     *  no indirect branch per primitive. The intersection tests are defined in the source files
+     *  of the primitives, they can only be inlined into the loop with RT_ENABLE_LTO.
+     *  NOTE: The type of a primitive must match exactly, a DistanceSphere that is added as a Sphere
+     *  is stored as a Sphere.
+     *  Copies of a buffer share the primitives, they are only duplicated if a buffer that
+     *  shares them is modified. Drawing a typed buffer does not copy it.
+     *  But keep in mind that the buffer is not thread save. If you decide to stream
+     *  data into the buffer by a secondary thread, YOU have to make it multithreading-save!
+     */
+    template<typename... Ts>
+    class TypedBuffer : public GeometryBuffer
+    {
+        static_assert(sizeof...(Ts) > 0, "Ray-Tracing: TypedBuffer must store at least one primitive type.");
+
+    private:
+        // primitives that are shared between the copies of a buffer
+        struct storage_t
+        {
+            std::tuple<std::vector<Ts>...> prims;   // one array per primitive type
+            uint64_t revision;                      // changes with every modification, unique among all geometry buffers
+        };
+
+        std::shared_ptr<storage_t> _storage;
+
+        // makes the storage unique to this buffer before it is modified and updates the revision
+        storage_t& modify(void)
+        {
+            if (this->_storage == nullptr)
+                this->_storage = std::make_shared<storage_t>();
+            else if (this->_storage.use_count() > 1)
+                this->_storage = std::make_shared<storage_t>(*this->_storage);  // the primitives are shared, copy them before they are modified
+            this->_storage->revision = next_revision();
+            return *this->_storage;
+        }
+
+        // returns the array of the primitives of type T, an empty array if the buffer has no storage
+        template<typename T>
+        const std::vector<T>& array(void) const noexcept
+        {
+            static const std::vector<T> empty;
+            return (this->_storage == nullptr) ? empty : std::get<std::vector<T>>(this->_storage->prims);
+        }
+
+        // closest hit of the primitives of type T
+        template<typename T>
+        void intersect_type(const ray_t& ray, float& t, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const
+        {
+            static_assert(std::is_base_of<Primitive, T>::value, "Ray-Tracing: TypedBuffer can only store primitives.");
+
+            const std::vector<T>& prims = this->template array<T>();
+            for (size_t i = 0; i < prims.size(); i++)
+            {
+                RayHitInformation _hit_info;
+                const float t_cur = prims[i].T::intersect(ray, t, cull_mask, _hit_info);   // qualified call, no virtual dispatch
+                if (t_cur < t)
+                {
+                    t = t_cur;
+                    hit_info = _hit_info;
+                    if (hit_prim != nullptr) *hit_prim = &prims[i];
+                }
+            }
+        }
+
+        // closest hits of a ray packet with the primitives of type T
+        template<typename T>
+        void intersect_packet_type(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const
+        {
+            const std::vector<T>& prims = this->template array<T>();
+            for (size_t i = 0; i < prims.size(); i++)
+            {
+                const uint32_t hits = prims[i].T::intersect_packet(packet, mask, cull_mask, t, hit_info);
+                if (hits == 0 || hit_prim == nullptr) continue;
+                for (uint32_t j = 0; j < RT_RAY_PACKET_SIZE; j++)
+                {
+                    if (hits & (1 << j))
+                        hit_prim[j] = &prims[i];
+                }
+            }
+        }
+
+        // any accepted hit of the primitives of type T
+        template<typename T>
+        bool occluded_type(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const
+        {
+            const std::vector<T>& prims = this->template array<T>();
+            for (size_t i = 0; i < prims.size(); i++)
+            {
+                RayHitInformation hit_info;
+                const float t = prims[i].T::intersect(ray, t_max, cull_mask, hit_info);
+                if (t < t_max && (any_hit == nullptr || any_hit(user_data, ray, t, &prims[i], hit_info)))
+                    return true;
+            }
+            return false;
+        }
+
+        // closest primitive of type T to a point
+        template<typename T>
+        void distance_type(const glm::vec3& p, float& d, const Primitive** hit_prim) const
+        {
+            const std::vector<T>& prims = this->template array<T>();
+            for (size_t i = 0; i < prims.size(); i++)
+            {
+                const float d_cur = prims[i].T::distance(p);
+                if (d_cur < d)
+                {
+                    d = d_cur;
+                    if (hit_prim != nullptr) *hit_prim = &prims[i];
+                }
+            }
+        }
+
+    public:
+        TypedBuffer(void) = default;
+        TypedBuffer(const TypedBuffer&) = default;
+        TypedBuffer& operator= (const TypedBuffer&) = default;
+        TypedBuffer(TypedBuffer&&) = default;
+        TypedBuffer& operator= (TypedBuffer&&) = default;
+        virtual ~TypedBuffer(void) {}
+
+        /**
+         *  @brief Adds a primitive to the array of its type.
+         *  @param[in] prim: The primitive to add.
+         */
+        template<typename T>
+        void push_back(const T& prim)
+        {
+            std::get<std::vector<T>>(this->modify().prims).push_back(prim);
+        }
+
+        /**
+         *  @brief Adds an array of primitives to the array of their type.
+         *  @param[in] count: Number of primitives to add.
+         *  @param[in] prims: The array of primitives.
+         */
+        template<typename T>
+        void push_back(size_t count, const T* prims)
+        {
+            std::vector<T>& dst = std::get<std::vector<T>>(this->modify().prims);
+            dst.insert(dst.end(), prims, prims + count);
+        }
+
+        /**
+         *  @brief Reserves memory for the primitives of a type.
+         *  @param[in] count: Number of primitives of type T the buffer can hold without reallocation.
+         */
+        template<typename T>
+        void reserve(size_t count)
+        {
+            std::get<std::vector<T>>(this->modify().prims).reserve(count);
+        }
+
+        /** @return The array of the primitives of type T. */
+        template<typename T>
+        inline const std::vector<T>& primitives(void) const noexcept
+        {return this->template array<T>();}
+
+        /** @return The number of primitives of type T. */
+        template<typename T>
+        inline size_t count(void) const noexcept
+        {return this->template array<T>().size();}
+
+        /** @return The number of primitives of all types. */
+        size_t size(void) const noexcept
+        {
+            size_t n = 0;
+            const int expand[] = { 0, ((n += this->template array<Ts>().size()), 0)... };
+            (void)expand;
+            return n;
+        }
+
+        /**
+         *  @return The revision of the primitives. The revision changes every time the buffer is modified.
+         *  Copies of a buffer have the same revision until one of them is modified.
+         *  A default constructed buffer has the revision 0.
+         */
+        virtual uint64_t revision(void) const noexcept
+        {return (this->_storage == nullptr) ? 0 : this->_storage->revision;}
+
+        /** @brief Removes every primitive from the buffer. */
+        void clear(void)
+        {
+            if (this->_storage == nullptr) return;
+            this->_storage = std::make_shared<storage_t>();     // do not copy primitives that would be removed anyway
+            this->_storage->revision = next_revision();
+        }
+
+        /**
+         *  @brief Intersection test for a ray with every primitive of the buffer.
+         *  The types are tested in the order of the template parameters.
+         */
+        virtual float intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info, const Primitive** hit_prim) const
+        {
+            float t = t_max;
+            const int expand[] = { 0, (this->template intersect_type<Ts>(ray, t, cull_mask, hit_info, hit_prim), 0)... };
+            (void)expand;
+            return t;
+        }
+
+        /** @brief Intersection test for a ray packet with every primitive of the buffer. */
+        virtual void intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info, const Primitive** hit_prim) const
+        {
+            const int expand[] = { 0, (this->template intersect_packet_type<Ts>(packet, mask, cull_mask, t, hit_info, hit_prim), 0)... };
+            (void)expand;
+        }
+
+        /** @brief Tests if a ray hits any primitive of the buffer, stops at the first accepted hit. */
+        virtual bool occluded(const ray_t& ray, float t_max, RayCullMask cull_mask, AnyHitFunction any_hit, void* user_data) const
+        {
+            bool hit = false;
+            const int expand[] = { 0, (hit = hit || this->template occluded_type<Ts>(ray, t_max, cull_mask, any_hit, user_data), 0)... };
+            (void)expand;
+            return hit;
+        }
+
+        /** @brief Distance from a point to the closest primitive of the buffer. */
+        virtual float distance(const glm::vec3& p, float d_max, const Primitive** hit_prim) const
+        {
+            float d = d_max;
+            const int expand[] = { 0, (this->template distance_type<Ts>(p, d, hit_prim), 0)... };
+            (void)expand;
+            return d;
+        }
+
+        /** @return A dynamic clone of the typed buffer, the clone shares the primitives with this buffer. */
+        virtual GeometryBuffer* clone_dynamic(void) const
+        {return new TypedBuffer(*this);}
+    };
+}
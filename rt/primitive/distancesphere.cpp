@@ -26,9 +26,21 @@ DistanceSphere::DistanceSphere(const glm::vec3& center, float radius, const Prim
 DistanceSphere::DistanceSphere(const DistanceSphere& sphere) noexcept
 : Sphere(sphere) {}
 
+DistanceSphere& DistanceSphere::operator= (const DistanceSphere& sphere) noexcept
+{
+    Sphere::operator=(sphere);
+    return *this;
+}
+
 DistanceSphere::DistanceSphere(DistanceSphere&& sphere) noexcept
 : Sphere(sphere) {}
 
+DistanceSphere& DistanceSphere::operator= (DistanceSphere&& sphere) noexcept
+{
+    Sphere::operator=(std::move(sphere));
+    return *this;
+}
+
 float DistanceSphere::intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info) const
 {
     const float d = glm::length(this->_center - ray.origin) - this->_radius;
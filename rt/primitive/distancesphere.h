@@ -36,7 +36,9 @@ namespace rt
         DistanceSphere(const glm::vec3& center, float radius, const PrimitiveAttribute& attrib) noexcept;
 
         DistanceSphere(const DistanceSphere& sphere) noexcept;
+        DistanceSphere& operator= (const DistanceSphere& sphere) noexcept;
         DistanceSphere(DistanceSphere&& sphere) noexcept;
+        DistanceSphere& operator= (DistanceSphere&& sphere) noexcept;
         virtual ~DistanceSphere(void) noexcept {}
 
         /** @brief Intersection test for ray - sphere - intersection. */
@@ -46,6 +48,16 @@ namespace rt
         virtual Primitive* clone_dynamic(void)
         {return new DistanceSphere(*this);}
 
+        /** @return A clone of the distance sphere that is placed into an arena. */
+        virtual Primitive* clone_arena(Arena& arena) const
+        {
+            void* mem = arena.allocate(sizeof(DistanceSphere), alignof(DistanceSphere));
+            if (mem == nullptr) return nullptr;
+            DistanceSphere* prim = new(mem) DistanceSphere(this->_center, this->_radius);
+            prim->set_attribute(this->attribute(), arena);
+            return prim;
+        }
+
         /** @return Size of the current distance sphere. */
         virtual size_t get_sizeof(void)
         {return sizeof(DistanceSphere);}
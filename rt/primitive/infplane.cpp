@@ -13,6 +13,7 @@
 #include "infplane.h"
 
 #include <cmath>
+#include <limits>
 
 using namespace rt;
 
@@ -95,4 +96,10 @@ float InfPlane::intersect(const ray_t& ray, float t_max, RayCullMask cull_mask,
 float InfPlane::distance(const glm::vec3& p) const
 {
     return abs(glm::dot(this->_direction, p - this->_origin));
+}
+
+aabb_t InfPlane::bounds(void) const
+{
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    return { glm::vec3(-inf), glm::vec3(inf) };
 }
\ No newline at end of file
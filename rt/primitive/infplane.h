@@ -87,10 +87,23 @@ namespace rt
         /** @brief Distance from a 3D-point P to the closest point on the plane. */
         virtual float distance(const glm::vec3& p) const;
 
+        /** @return An unbounded box, as the plane expands infinitely wide. */
+        virtual aabb_t bounds(void) const;
+
         /** @return A dynamic clone of the infinite plane. */
         virtual Primitive* clone_dynamic(void)
         {return new InfPlane(*this);}
 
+        /** @return A clone of the infinite plane that is placed into an arena. */
+        virtual Primitive* clone_arena(Arena& arena) const
+        {
+            void* mem = arena.allocate(sizeof(InfPlane), alignof(InfPlane));
+            if (mem == nullptr) return nullptr;
+            InfPlane* prim = new(mem) InfPlane(this->_direction, this->_origin);
+            prim->set_attribute(this->attribute(), arena);
+            return prim;
+        }
+
         /** @return Size of the current infinite plane. */
         virtual size_t get_sizeof(void)
         {return sizeof(InfPlane);}
@@ -11,17 +11,19 @@
 
 #include "primitive.h"
 #include <iostream>
+#include <limits>
 
 using namespace rt;
 
 Primitive::Primitive(void) noexcept
 {
     this->attrib = nullptr;
+    this->attrib_owned = true;
 }
 
 Primitive::~Primitive(void)
 {
-    delete this->attrib;
+    this->free_attribute();
 }
 
 Primitive::Primitive(const PrimitiveAttribute& attrib) noexcept : Primitive()
@@ -29,14 +31,63 @@ Primitive::Primitive(const PrimitiveAttribute& attrib) noexcept : Primitive()
     this->set_attribute(attrib);
 }
 
+void Primitive::free_attribute(void) noexcept
+{
+    if (this->attrib == nullptr) return;
+    if (this->attrib_owned) delete this->attrib;
+    else                    this->attrib->~PrimitiveAttribute();  // memory belongs to the arena
+    this->attrib = nullptr;
+}
+
 void Primitive::set_attribute(const PrimitiveAttribute* attrib) noexcept
 {
     if (attrib == nullptr) return;
-    if(this->attrib != nullptr) delete this->attrib;    // delete old attribute
+    this->free_attribute();                             // delete old attribute
     this->attrib = attrib->clone_dynamic();             // allocate new one
+    this->attrib_owned = true;
 }
 
 void Primitive::set_attribute(const PrimitiveAttribute& attrib) noexcept
 {
     this->set_attribute(&attrib);
 }
+
+void Primitive::set_attribute(const PrimitiveAttribute* attrib, Arena& arena) noexcept
+{
+    if (attrib == nullptr) return;
+    this->free_attribute();
+    this->attrib = attrib->clone_arena(arena);
+    this->attrib_owned = (this->attrib == nullptr);
+    if (this->attrib_owned)                             // attribute does not support arenas
+        this->attrib = attrib->clone_dynamic();
+}
+
+void Primitive::set_attribute(const PrimitiveAttribute& attrib, Arena& arena) noexcept
+{
+    this->set_attribute(&attrib, arena);
+}
+
+uint32_t Primitive::intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info) const
+{
+    uint32_t hit_mask = 0;
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+
+        RayHitInformation _hit_info;
+        const float t_cur = this->intersect(packet.ray(i), t[i], cull_mask, _hit_info);
+        if (t_cur < t[i])
+        {
+            t[i] = t_cur;
+            hit_info[i] = _hit_info;
+            hit_mask |= (1 << i);
+        }
+    }
+    return hit_mask;
+}
+
+aabb_t Primitive::bounds(void) const
+{
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    return { glm::vec3(-inf), glm::vec3(inf) };
+}
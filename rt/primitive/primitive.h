@@ -13,6 +13,8 @@
 #pragma once
 
 #include "../misc/rt_types.h"
+#include "../misc/arena.h"
+#include <new>
 
 namespace rt
 {
@@ -20,6 +22,10 @@ namespace rt
     {
     private:
         PrimitiveAttribute* attrib;
+        bool attrib_owned;  // false if the attribute is placed in an arena
+
+        // destroys the attribute, frees it only if it is not placed in an arena
+        void free_attribute(void) noexcept;
 
     protected:
         /**
@@ -28,6 +34,13 @@ namespace rt
          */
         void set_attribute(const PrimitiveAttribute* attrib) noexcept;
 
+        /**
+         *  @brief Sets the primitive's material properties and places the copy into an arena.
+         *  @param[in] attrib: primitive attribute pointer
+         *  @param[in] arena: Arena where the attribute is placed in.
+         */
+        void set_attribute(const PrimitiveAttribute* attrib, Arena& arena) noexcept;
+
     public:
         Primitive(void) noexcept;
 
@@ -41,6 +54,19 @@ namespace rt
          */
         void set_attribute(const PrimitiveAttribute& attrib) noexcept;
 
+        /**
+         *  @brief Sets the primitive's material properties and places the copy into an arena.
+         *  If the attribute does not support arenas, it is allocated on the heap.
+         *  NOTE: The arena must outlive the primitive.
+         *  @param[in] attrib: primitive attribute
+         *  @param[in] arena: Arena where the attribute is placed in.
+         */
+        void set_attribute(const PrimitiveAttribute& attrib, Arena& arena) noexcept;
+
+        /** @brief Removes the primitive's material properties. */
+        inline void clear_attribute(void) noexcept
+        {this->free_attribute();}
+
         /** @return The primitive's material prperties */
         inline const PrimitiveAttribute* attribute(void) const noexcept
         {return this->attrib;}
@@ -56,6 +82,19 @@ namespace rt
          */
         virtual float intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info) const = 0;
 
+        /**
+         *  @brief Executes the intersection test for every active ray of a ray packet.
+         *  By default the rays are tested one after another, primitives can overwrite this
+         *  method to test the whole packet with SIMD instructions.
+         *  @param[in] packet: The rays that are tested if they intersect with the primitive.
+         *  @param[in] mask: Bit i is set if the ray i is active.
+         *  @param[in] cull_mask: Back- and / or front-side culling.
+         *  @param[in, out] t: The maximum length of every ray. Gets updated if a ray hits the primitive.
+         *  @param[out] hit_info: Hit information of every ray, only written if the ray hits the primitive.
+         *  @return A mask where bit i is set if the ray i hits the primitive closer than t[i].
+         */
+        virtual uint32_t intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info) const;
+
         /**
          *  @brief Calculates the distance from a 3D-point P to the current primitive.
          *  @param[in] p: Point from where the distance should be calculated.
@@ -64,6 +103,16 @@ namespace rt
          */
         virtual float distance(const glm::vec3& p) const = 0;
 
+        /**
+         *  @brief Calculates the axis aligned bounding box of the current primitive.
+         *  The bounding box is used to build the acceleration structure of the scene.
+         *  @return The bounding box of the primitive.
+         *  NOTE: By default the box is unbounded (infinite extent). Primitives with an
+         *  unbounded box are not inserted into the acceleration structure, instead
+         *  they are tested for every ray.
+         */
+        virtual aabb_t bounds(void) const;
+
         /** 
          *  @return A dynamic clone of the own instance.
          *  The memory does not free automantically.
@@ -72,7 +121,27 @@ namespace rt
          */
         virtual Primitive* clone_dynamic(void) = 0;
 
+        /**
+         *  @return A clone of the own instance (and its attribute) that is placed into the memory of an arena.
+         *  The memory is released together with the arena, but the destructor must be called by YOURSELF.
+         *  By default the primitive does not support arenas and nullptr is returned.
+         *  HINT: The primitive buffer places its primitives into its own arena.
+         */
+        virtual Primitive* clone_arena(Arena& arena) const
+        {return nullptr;}
+
         /** @return The size of the primitive. */
         virtual size_t get_sizeof(void) = 0;
     };
+
+    /**
+     *  Decides if a hit that was found by an occlusion query is accepted (any-hit).
+     *  @param[in] user_data: Pointer that is passed through by the occlusion query.
+     *  @param[in] ray: The ray that is tested for occlusion.
+     *  @param[in] t: The length from the ray-origin to the intersection point.
+     *  @param[in] hit_prim: The primitive that the ray intersected with.
+     *  @param[in] hit_info: Information about the ray-hit.
+     *  @return True if the hit is accepted, false if the hit is ignored (e.g. transparent parts).
+     */
+    using AnyHitFunction = bool(*)(void* user_data, const ray_t& ray, float t, const Primitive* hit_prim, RayHitInformation hit_info);
 }
\ No newline at end of file
@@ -145,7 +145,49 @@ float Sphere::intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, Ra
     return this->_intersect(ray, t_max, cull_mask, hit_info);
 }
 
+uint32_t Sphere::intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info) const
+{
+    // same test as Sphere::_intersect but with b = dot(D, OC): t0,1 = -b -+ sqrt(b^2 - c)
+    using namespace simd;
+    const vfloat zero = simd::zero();
+    const vfloat ocx = sub(load(packet.origin_x), set1(this->_center.x));
+    const vfloat ocy = sub(load(packet.origin_y), set1(this->_center.y));
+    const vfloat ocz = sub(load(packet.origin_z), set1(this->_center.z));
+
+    const vfloat b = fmadd(load(packet.direction_x), ocx, fmadd(load(packet.direction_y), ocy, mul(load(packet.direction_z), ocz)));
+    const vfloat c = sub(fmadd(ocx, ocx, fmadd(ocy, ocy, mul(ocz, ocz))), set1(this->_radius * this->_radius));
+    const vfloat delta = sub(mul(b, b), c);
+    const vfloat sq = simd::sqrt(max(delta, zero));
+    const vfloat t0 = sub(sub(zero, b), sq);
+    const vfloat t1 = sub(sq, b);
+
+    const vfloat valid = bit_and(cmp_ge(delta, zero), mask_from_bits(mask));
+    const vfloat front = (cull_mask & RT_CULL_MASK_FRONT_BIT) ? zero : bit_and(valid, cmp_ge(t0, zero));
+    const vfloat back = (cull_mask & RT_CULL_MASK_BACK_BIT) ? zero : bit_and(valid, bit_and(cmp_lt(t0, zero), cmp_ge(t1, zero)));
+    const vfloat t_cur = select(front, t0, t1);
+    const vfloat hit = bit_and(bit_or(front, back), cmp_lt(t_cur, loadu(t)));
+
+    const uint32_t hit_mask = movemask(hit);
+    const uint32_t front_mask = movemask(front);
+    if (hit_mask == 0) return 0;
+
+    alignas(32) float t_lanes[RT_RAY_PACKET_SIZE];
+    store(t_lanes, t_cur);
+    for (uint32_t i = 0; i < RT_RAY_PACKET_SIZE; i++)
+    {
+        if (!(hit_mask & (1 << i))) continue;
+        t[i] = t_lanes[i];
+        hit_info[i] = (front_mask & (1 << i)) ? RT_HIT_INFO_FRONT_BIT : RT_HIT_INFO_BACK_BIT;
+    }
+    return hit_mask;
+}
+
 float Sphere::distance(const glm::vec3& p) const
 {
     return glm::length(this->_center - p) - this->_radius;
+}
+
+aabb_t Sphere::bounds(void) const
+{
+    return { this->_center - glm::vec3(this->_radius), this->_center + glm::vec3(this->_radius) };
 }
\ No newline at end of file
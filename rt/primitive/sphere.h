@@ -84,13 +84,29 @@ namespace rt
         /** @brief Intersection test for ray - sphere - intersection. */
         virtual float intersect(const ray_t& ray, float t_max, RayCullMask cull_mask, RayHitInformation& hit_info) const;
 
+        /** @brief Intersection test for a ray packet with the sphere, all rays are tested at once with SIMD instructions. */
+        virtual uint32_t intersect_packet(const ray_packet_t& packet, uint32_t mask, RayCullMask cull_mask, float* t, RayHitInformation* hit_info) const;
+
         /** @brief Distance from a 3D-point P to the closest point on the sphere. */
         virtual float distance(const glm::vec3& p) const;
+
+        /** @return The bounding box of the sphere. */
+        virtual aabb_t bounds(void) const;
         
         /** @return A dynamic clone of the sphere. */
         virtual Primitive* clone_dynamic(void)
         {return new Sphere(*this);}
 
+        /** @return A clone of the sphere that is placed into an arena. */
+        virtual Primitive* clone_arena(Arena& arena) const
+        {
+            void* mem = arena.allocate(sizeof(Sphere), alignof(Sphere));
+            if (mem == nullptr) return nullptr;
+            Sphere* prim = new(mem) Sphere(this->_center, this->_radius);
+            prim->set_attribute(this->attribute(), arena);
+            return prim;
+        }
+
         /** @return -> Size of the current sphere. */
         virtual size_t get_sizeof(void)
         {return sizeof(Sphere);}
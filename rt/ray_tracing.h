@@ -13,8 +13,10 @@
 
 // include texture
 #include "image/texture.h"
+#include "image/texture_sampler.h"
 #include "image/spherical_map.h"
 #include "image/cubemap.h"
+#include "image/image_writer.h"
 
 // include primitive
 #include "primitive/sphere.h"
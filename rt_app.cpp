@@ -84,7 +84,7 @@ inline glm::vec3 offset_ray_origin(const glm::vec3& p, const glm::vec3& n, const
 }
 
 
-RT_Application::RT_Application(void)
+RT_Application::RT_Application(rt::RenderBackend backend)
 {
     this->light =
     {
@@ -92,19 +92,20 @@ RT_Application::RT_Application(void)
         {7.0f, 7.0f, 7.0f}
     };
 
+    // the small spheres are mirrors and trace their reflections, the ground is rough and uses the prefiltered environment
     rt::Sphere spheres[PRIM_COUNT] =
     {
         rt::Sphere
         (
             {0.0f, 5.0f, 10000.0f},
             1.0f,
-            Material(glm::vec3(0.0f, 0.0f, 1.0f), 0.5f, 0.8f, 1.0f)
+            Material(glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 0.8f, 1.0f)
         ),
         rt::Sphere
         (
             {3.0f, 0.0f, 3.0f},
             1.0f,
-            Material(glm::vec3(0.0f, 1.0f, 0.0f), 0.5f, 0.8f, 1.0f)
+            Material(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0.8f, 1.0f)
         ),
         rt::Sphere
         (
@@ -128,34 +129,17 @@ RT_Application::RT_Application(void)
         throw std::runtime_error("Failed to load skybox.");
 #endif
 
-    // load texture
-    int w, h;
-    uint8_t* data = stbi_load("../../../assets/textures/cobblestone.png", &w, &h, nullptr, 3);
-
-    rt::ImageCreateInfo image_ci = {};
-    image_ci.width = w;
-    image_ci.height = h;
-    image_ci.depth = 1;
-    image_ci.channels = 3;
-
+    // the texture, the spherical map and the cubemap are decoded at the same time, only the environment is waited for
     this->tex.set_address_mode(rt::RT_TEXTURE_ADDRESS_MODE_REPEAT, rt::RT_TEXTURE_ADDRESS_MODE_REPEAT, rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER);
     this->tex.set_filter(rt::RT_FILTER_NEAREST);
     this->tex.set_border_color(glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
-    rt::ImageError error = this->tex.load(image_ci, data);
-    if(error != rt::RT_IMAGE_ERROR_NONE)
-        throw std::runtime_error("Failed to load texture.");
-    std::cout << "texture loaded" << std::endl;
-    stbi_image_free(data);
+    this->tex_loaded = rt::TextureLoader::load_async(this->tex, "../../../assets/textures/cobblestone.png", 3);
 
-    // load spherical map
     this->spherical_env.set_address_mode(rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER, rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER, rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER);
     this->spherical_env.set_filter(rt::RT_FILTER_LINEAR);
-    error = rt::TextureLoader::loadf(this->spherical_env, "../../../assets/skyboxes/environment.hdr", 3);
-    if (error != rt::RT_IMAGE_ERROR_NONE)
-        throw std::runtime_error("Failed to load spherical map.");
-    std::cout << "spherical map loaded" << std::endl;
+    this->spherical_env.set_fast_math(true);                                    // polynomial atan2 and asin, the error is below a pixel
+    std::future<rt::ImageError> spherical_env_loaded = rt::TextureLoader::loadf_async(this->spherical_env, "../../../assets/skyboxes/environment.hdr", 3);
 
-    // load cubemap
     rt::CubemapCreateInfo cci = {};
     cci.right = "../../../assets/skyboxes/right.jpg";
     cci.left = "../../../assets/skyboxes/left.jpg";
@@ -163,15 +147,30 @@ RT_Application::RT_Application(void)
     cci.bottom = "../../../assets/skyboxes/bottom.jpg";
     cci.front  = "../../../assets/skyboxes/front.jpg";
     cci.back = "../../../assets/skyboxes/back.jpg";
+    this->cubemap_loaded = rt::TextureLoader::load_cube_async(this->cubemap, cci, 3);
+
+    // the renderer only needs the environment, it is converted while the other images are still decoded
+    if (spherical_env_loaded.get() != rt::RT_IMAGE_ERROR_NONE)
+        throw std::runtime_error("Failed to load spherical map.");
+    std::cout << "spherical map loaded" << std::endl;
+
+    // convert the spherical map into a cubemap, which needs no trigonometric functions to be sampled
+    this->env_cubemap.set_filter(rt::RT_FILTER_LINEAR);
+    rt::ImageError error = this->env_cubemap.load(this->spherical_env, this->spherical_env.width() / 4);
+    if (error != rt::RT_IMAGE_ERROR_NONE)
+        throw std::runtime_error("Failed to convert spherical map.");
+    std::cout << "spherical map converted" << std::endl;
 
-    error = rt::TextureLoader::load_cube(this->cubemap, cci, 3);
+    // precompute the diffuse and glossy lighting of the environment for the rough materials
+    error = this->env_cubemap.prefilter();
     if (error != rt::RT_IMAGE_ERROR_NONE)
-        throw std::runtime_error("Failed to load cubemap.");
-    std::cout << "cubemap loaded" << std::endl;
+        throw std::runtime_error("Failed to prefilter environment.");
+    std::cout << "environment prefiltered" << std::endl;
 
     rt::ImageCreateInfo fbo_ci = {};
     fbo_ci.width = SCR_WIDTH;
     fbo_ci.height = SCR_HEIGHT;
+    fbo_ci.format = rt::RT_FORMAT_R32G32B32A32_SFLOAT;                     // keep the HDR data, tonemapping is done afterwards
 
     rt::BufferLayout buffer_layout;
     buffer_layout.size = PRIM_COUNT;
@@ -182,6 +181,14 @@ RT_Application::RT_Application(void)
     buff.data(0, 3, spheres);
 
     this->set_num_threads(1);
+    this->set_backend(backend);                                               // the wavefront backend traces the reflections bounce by bounce
+
+    rt::WavefrontInfo wavefront_info;
+    wavefront_info.max_depth = RT_RECURSIONS;
+    wavefront_info.t_max = 100.0f;
+    wavefront_info.cull_mask = rt::RT_CULL_MASK_NONE;
+    wavefront_info.sort_rays = true;                                          // reflections are incoherent, sort them before tracing
+    this->set_wavefront_info(wavefront_info);
     this->set_framebuffer(fbo_ci);
     this->clear_color(0.0f, 0.0f, 0.0f);
     this->draw_buffer(buff);
@@ -192,31 +199,27 @@ RT_Application::~RT_Application(void)
     // not used dtor of the super class handles everything (in this application)
 }
 
-float RT_Application::sdf(const glm::vec3& p, float t_max, const rt::Primitive** hit_prim)
+void RT_Application::wait_for_assets(void)
 {
-    float d = t_max;                                        // Use maximum length of the ray if there is no object within that range.
-    const size_t n_buff = this->rt_geometry_buffer_count();
+    if (this->tex_loaded.valid())
+    {
+        if (this->tex_loaded.get() != rt::RT_IMAGE_ERROR_NONE)
+            throw std::runtime_error("Failed to load texture.");
+        std::cout << "texture loaded" << std::endl;
+    }
 
-    for(size_t b = 0; b < n_buff; b++)
+    if (this->cubemap_loaded.valid())
     {
-        const rt::Primitive * const * map = this->rt_geometry()[b].map_rdonly();
-        const size_t size = this->rt_geometry()[b].layout().size;
-
-        for(size_t i = 0; i < size; i++)                    // Iterate through the primitives and find the closest one.
-        {
-            if(map[i] != nullptr)
-            {
-                const float cur_d = map[i]->distance(p);
-                if(cur_d < d && cur_d < t_max)              // dont update if current distance exeeds the maximum length of the ray (outside the render distance)
-                {
-                    d = cur_d;                              // update the closest length if the current length is maller than the current closest length
-                    if(hit_prim != nullptr)                 // set the id of the closest sphere
-                        *hit_prim = map[i];
-                }
-            }
-        }
+        if (this->cubemap_loaded.get() != rt::RT_IMAGE_ERROR_NONE)
+            throw std::runtime_error("Failed to load cubemap.");
+        std::cout << "cubemap loaded" << std::endl;
     }
-    return d;
+}
+
+float RT_Application::sdf(const glm::vec3& p, float t_max, const rt::Primitive** hit_prim)
+{
+    // Use maximum length of the ray if there is no object within that range.
+    return this->scene_distance(p, t_max, hit_prim);
 }
 
 float RT_Application::shadow(const rt::ray_t& shadow_ray, float t_max, float softness)
@@ -244,7 +247,32 @@ float RT_Application::shadow(const rt::ray_t& shadow_ray, float t_max, float sof
     return res;
 }
 
-glm::vec3 RT_Application::ray_generation_shader(uint32_t x, uint32_t y)
+float RT_Application::hard_shadow(const rt::ray_t& shadow_ray, float t_max)
+{
+    // the query stops at the first opaque object, the closest one is not needed
+    return this->trace_occlusion(shadow_ray, t_max, rt::RT_CULL_MASK_NONE) ? 0.0f : 1.0f;
+}
+
+glm::vec3 RT_Application::shade_light(const Material& mtl, const glm::vec3& p, const glm::vec3& normal)
+{
+    // the light direction points towards the light, which is infinitely far away
+    const glm::vec3 l = glm::normalize(this->light.direction);
+    const float n_dot_l = glm::dot(normal, l);
+    if (n_dot_l <= 0.0f)
+        return glm::vec3(0.0f);
+
+    rt::ray_t shadow_ray;
+    shadow_ray.direction = l;
+    shadow_ray.origin = offset_ray_origin(p, normal, l);
+    const float visibility = this->hard_shadow(shadow_ray, 100.0f);
+    if (visibility == 0.0f)
+        return glm::vec3(0.0f);
+
+    // lambertian diffuse, metals have no diffuse reflection
+    return visibility * n_dot_l * (1.0f - mtl.metallic()) * mtl.albedo() * this->light.intensity / 3.14159265f;
+}
+
+rt::ray_t RT_Application::primary_ray(uint32_t x, uint32_t y)
 {
     float ndc_x = gl::convert::from_pixels_pos_x(x, this->rt_dimensions().x) * this->rt_ratio();
     float ndc_y = gl::convert::from_pixels_pos_y(y, this->rt_dimensions().y);
@@ -260,13 +288,33 @@ glm::vec3 RT_Application::ray_generation_shader(uint32_t x, uint32_t y)
     rt::ray_t ray;
     ray.origin = origin;
     ray.direction = glm::normalize(ndc_x * cam_x + ndc_y * cam_y + 1.5f * cam_z);                   // rotated intersection with the image plane
+    return ray;
+}
+
+glm::vec3 RT_Application::ray_generation_shader(uint32_t x, uint32_t y)
+{
+    rt::ray_t ray = this->primary_ray(x, y);
 
     // render the image in hdr
     glm::vec3 hdr_color(0.0f);
     trace_ray(ray, RT_RECURSIONS, 100.0f, rt::RT_CULL_MASK_NONE, &hdr_color);                                                  // begin ray-tracing process                              
-    glm::vec3 ldr_color = hdr_color / (hdr_color + glm::vec3(1.0f));                        // convert to ldr
 
-    return ldr_color;
+    return hdr_color;
+}
+
+void RT_Application::ray_generation_shader_packet(const uint32_t* x, const uint32_t* y, uint32_t mask, glm::vec3* colors)
+{
+    // neighbouring primary rays are coherent, trace them as one packet
+    rt::ray_packet_t packet;
+    void* payloads[rt::RT_RAY_PACKET_SIZE];
+    for (uint32_t i = 0; i < rt::RT_RAY_PACKET_SIZE; i++)
+    {
+        packet.set_ray(i, (mask & (1 << i)) ? this->primary_ray(x[i], y[i]) : rt::ray_t{ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) });
+        colors[i] = glm::vec3(0.0f);
+        payloads[i] = &colors[i];                                                           // render the image in hdr
+    }
+
+    this->trace_ray_packet(packet, mask, RT_RECURSIONS, 100.0f, rt::RT_CULL_MASK_NONE, payloads);
 }
 
 void RT_Application::closest_hit_shader(const rt::ray_t& ray, int recursion, float t, float t_max, const rt::Primitive* hit, rt::RayHitInformation hit_info, void* ray_payload)
@@ -294,15 +342,32 @@ void RT_Application::closest_hit_shader(const rt::ray_t& ray, int recursion, flo
         n = 1.5f;
     }
 
-    rt::ray_t _sample_ray;
-    _sample_ray.direction = glm::reflect(ray.direction, normal);
-    //_sample_ray.direction = glm::refract(ray.direction, refract_normal, n);
-    _sample_ray.origin = offset_ray_origin(intersection, normal, _sample_ray.direction);
-    //_sample_ray.origin = intersection;
-    this->trace_ray(_sample_ray, recursion-1, t_max, cull_mask, &color);
+    // the last recursion looks the reflection up instead of tracing it
+    const Material* mtl = (const Material*)hit->attribute();
+    glm::vec3 reflection_weight;
+    color = this->shade_environment((mtl != nullptr) ? *mtl : Material(), normal, view, recursion > 1, reflection_weight);
+    color += this->shade_light((mtl != nullptr) ? *mtl : Material(), intersection, normal);
+    if (reflection_weight != glm::vec3(0.0f))
+    {
+        glm::vec3 reflection(0.0f);
+        rt::ray_t _sample_ray;
+        _sample_ray.direction = glm::reflect(ray.direction, normal);
+        //_sample_ray.direction = glm::refract(ray.direction, refract_normal, n);
+        _sample_ray.origin = offset_ray_origin(intersection, normal, _sample_ray.direction);
+        //_sample_ray.origin = intersection;
+        this->trace_ray(_sample_ray, recursion-1, t_max, cull_mask, &reflection);
+        color += reflection_weight * reflection;
+    }
     *out_color = color;
 }
 
+bool RT_Application::any_hit_shader(const rt::ray_t& ray, float t, const rt::Primitive* hit, rt::RayHitInformation hit_info)
+{
+    // cut-out: objects that are mostly transparent do not cast a shadow
+    const Material* mtl = (const Material*)hit->attribute();
+    return mtl == nullptr || mtl->opacity() >= 0.5f;
+}
+
 void RT_Application::miss_shader(const rt::ray_t& ray, int recursuon, float t_max, void* ray_payload)
 {
     //glm::vec3 color = glm::vec3(this->cubemap.sample(ray.direction));
@@ -311,15 +376,98 @@ void RT_Application::miss_shader(const rt::ray_t& ray, int recursuon, float t_ma
     //color = (color * x) / (glm::vec3(1.0f) - color * x);
     //*((glm::vec3*)ray_payload) = color;
 
-    *((glm::vec3*)ray_payload) = this->spherical_env.sample(glm::vec4(ray.direction.x, ray.direction.y, ray.direction.z, 0.0f));
+    *((glm::vec3*)ray_payload) = this->env_cubemap.sample(ray.direction);
+}
+
+bool RT_Application::wavefront_ray_generation_shader(uint32_t x, uint32_t y, rt::ray_t& ray, glm::vec3& weight)
+{
+    ray = this->primary_ray(x, y);
+    return true;
+}
+
+bool RT_Application::wavefront_closest_hit_shader(const rt::ray_t& ray, uint32_t depth, float t, const rt::Primitive* hit, rt::RayHitInformation hit_info, glm::vec3& emitted, glm::vec3& attenuation, rt::ray_t& next_ray)
+{
+    // same as the closest hit shader, but the reflected ray is returned instead of traced
+    rt::Sphere* hit_sphere = (rt::Sphere*)hit;
+    const Material* mtl = (const Material*)hit->attribute();
+
+    glm::vec3 intersection = ray.origin + t * ray.direction;
+    const glm::vec3 normal = glm::normalize(intersection - hit_sphere->center());
+
+    emitted = this->shade_environment((mtl != nullptr) ? *mtl : Material(), normal, -ray.direction, depth + 1 < RT_RECURSIONS, attenuation);
+    emitted += this->shade_light((mtl != nullptr) ? *mtl : Material(), intersection, normal);
+    if (attenuation == glm::vec3(0.0f))
+        return false;
+
+    next_ray.direction = glm::reflect(ray.direction, normal);
+    next_ray.origin = offset_ray_origin(intersection, normal, next_ray.direction);
+    return true;
+}
+
+glm::vec3 RT_Application::shade_environment(const Material& mtl, const glm::vec3& normal, const glm::vec3& view, bool trace_reflection, glm::vec3& reflection_weight)
+{
+    // Fresnel-Schlick with the roughness, metals reflect with the color of their albedo
+    const float n_dot_v = glm::clamp(glm::dot(normal, view), 0.0f, 1.0f);
+    const glm::vec3 f0 = glm::mix(glm::vec3(0.04f), mtl.albedo(), mtl.metallic());
+    const glm::vec3 fresnel = f0 + (glm::max(glm::vec3(1.0f - mtl.roughness()), f0) - f0) * std::pow(1.0f - n_dot_v, 5.0f);
+
+    const glm::vec3 diffuse = (glm::vec3(1.0f) - fresnel) * (1.0f - mtl.metallic()) * mtl.albedo() * this->env_cubemap.sample_irradiance(normal);
+    if (trace_reflection && mtl.roughness() < MIRROR_ROUGHNESS)
+    {
+        reflection_weight = fresnel;
+        return diffuse;
+    }
+
+    reflection_weight = glm::vec3(0.0f);
+    const glm::vec3 reflected = glm::reflect(-view, normal);
+    return diffuse + fresnel * glm::vec3(this->env_cubemap.sample_prefiltered(reflected, mtl.roughness()));
+}
+
+glm::vec3 RT_Application::wavefront_miss_shader(const rt::ray_t& ray, uint32_t depth)
+{
+    return this->env_cubemap.sample(ray.direction);
+}
+
+void RT_Application::wavefront_miss_shader_n(const rt::ray_t* rays, size_t n, uint32_t depth, glm::vec3* radiance)
+{
+    // every render thread has its own memory for the directions and colors, which is reused for every bounce
+    thread_local std::vector<glm::vec3> directions;
+    thread_local std::vector<glm::vec4> colors;
+    directions.resize(n);
+    colors.resize(n);
+    for (size_t i = 0; i < n; i++)
+        directions[i] = rays[i].direction;
+
+    this->env_cubemap.sample_n(directions.data(), colors.data(), n);
+    for (size_t i = 0; i < n; i++)
+        radiance[i] = glm::vec3(colors[i]);
 }
 
 void RT_Application::app_run(void)
 {
+    this->reset_ray_sort_statistics();
     this->run();
+    this->wait_for_assets();                                                // the background loads overlapped with the rendering
+
+    const rt::RaySortStatistics& stats = this->get_ray_sort_statistics();
+    if (stats.packets > 0)
+    {
+        std::cout << "sorted " << stats.sorted_rays << " secondary rays, coherent packets: "
+                  << 100.0 * stats.coherent_before / stats.packets << "% -> "
+                  << 100.0 * stats.coherent_after / stats.packets << "%" << std::endl;
+    }
+}
+
+const uint8_t* RT_Application::fetch_pixels(float exposure)
+{
+    // tonemap the hdr framebuffer to ldr, the framebuffer itself keeps the hdr data
+    this->ldr_pixels.resize(3 * (size_t)SCR_WIDTH * SCR_HEIGHT);
+    if (rt::ImageWriter::tonemap(this->get_framebuffer(), exposure, this->ldr_pixels.data()) != rt::RT_IMAGE_ERROR_NONE)
+        return nullptr;
+    return this->ldr_pixels.data();
 }
 
-const uint8_t* RT_Application::fetch_pixels(void) noexcept
+const rt::Framebuffer& RT_Application::fetch_framebuffer(void) const noexcept
 {
-    return this->get_framebuffer().map_rdonly();
+    return this->get_framebuffer();
 }
\ No newline at end of file
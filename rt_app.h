@@ -13,6 +13,7 @@
 
 #include "rt/ray_tracing.h"
 #include <cmath>
+#include <future>
 
 class Material : public rt::PrimitiveAttribute
 {
@@ -48,6 +49,11 @@ public:
     virtual ~Material(void) {}
     virtual rt::PrimitiveAttribute* clone_dynamic(void) const
     { return new Material(this->_albedo, this->_roughness, this->_metallic, this->_opacity); }
+    virtual rt::PrimitiveAttribute* clone_arena(rt::Arena& arena) const
+    {
+        void* mem = arena.allocate(sizeof(Material), alignof(Material));
+        return (mem != nullptr) ? new(mem) Material(*this) : nullptr;
+    }
 
     glm::vec3&          albedo(void)    noexcept        { return this->_albedo; }
     const glm::vec3&    albedo(void)    const noexcept  { return this->_albedo; }
@@ -70,9 +76,19 @@ class RT_Application : protected rt::RayTracer
 {
 private:
     Light light;
-    rt::Texture2D<uint8_t, float> tex;
-    rt::SphericalMap<float, float> spherical_env;
-    rt::Cubemap<uint8_t, float> cubemap;
+    rt::Texture2D<uint8_t, float, uint8_t> tex;                 // 8-bit source, stored as UNORM8
+    rt::SphericalMap<float, float, rt::rgb9e5_t> spherical_env; // HDR source, stored as shared exponent RGB
+    rt::Cubemap<uint8_t, float, uint8_t> cubemap;
+    rt::Cubemap<float, float, rt::rgb9e5_t> env_cubemap;        // spherical map converted at load time, sampled by the miss shaders
+    std::future<rt::ImageError> tex_loaded;                     // the texture and the cubemap are not needed for rendering,
+    std::future<rt::ImageError> cubemap_loaded;                 // they are decoded while the image is rendered
+    std::vector<uint8_t> ldr_pixels;
+
+    /**
+     *  Waits until the images that are loaded in the background are decoded.
+     *  Throws an exception if an image could not be loaded.
+     */
+    void wait_for_assets(void);
 
     /**
      *  Calculates the distance to the closest sphere (primitive / object) from a given point P.
@@ -96,21 +112,69 @@ private:
      */
     float shadow(const rt::ray_t& shadow_ray, float t_max, float softness);
 
+    /**
+     *  Tests if a point is in the shadow with an occlusion query, the shadow has no penumbra.
+     *  @param shadow_ray -> The ray that is traced from a point in the space to the light source.
+     *  @param t_max -> The maximum length of the ray.
+     *  @return -> 0 if the point is in shadow, otherwise 1.
+     */
+    float hard_shadow(const rt::ray_t& shadow_ray, float t_max);
+
+    /**
+     *  Generates the primary ray of a pixel.
+     *  @param x -> X coordinate of the pixel.
+     *  @param y -> Y coordinate of the pixel.
+     *  @return -> The ray from the camera through the pixel.
+     */
+    rt::ray_t primary_ray(uint32_t x, uint32_t y);
+
+    /**
+     *  Shades a surface with the directional light, the shadow is tested with hard_shadow.
+     *  @param mtl -> Material of the surface.
+     *  @param p -> Point on the surface.
+     *  @param normal -> Normal of the surface.
+     *  @return -> Diffuse radiance the surface reflects from the light.
+     */
+    glm::vec3 shade_light(const Material& mtl, const glm::vec3& p, const glm::vec3& normal);
+
+    /**
+     *  Shades a surface with the prefiltered environment (image based lighting).
+     *  The diffuse light is the irradiance of the environment, the glossy reflection of rough surfaces
+     *  is a lookup in the prefiltered environment. Smooth surfaces reflect the scene with a traced ray.
+     *  @param mtl -> Material of the surface.
+     *  @param normal -> Normal of the surface.
+     *  @param view -> Direction from the surface to the viewer.
+     *  @param trace_reflection -> False if the reflection must not be traced, e.g. at the last bounce.
+     *  @return @param reflection_weight -> Weight of the reflected ray, 0 if the reflection was looked up.
+     *  @return -> Radiance the surface reflects from the environment, without the reflected ray.
+     */
+    glm::vec3 shade_environment(const Material& mtl, const glm::vec3& normal, const glm::vec3& view, bool trace_reflection, glm::vec3& reflection_weight);
+
 protected:
     glm::vec3 ray_generation_shader(uint32_t x, uint32_t y);
+    void ray_generation_shader_packet(const uint32_t* x, const uint32_t* y, uint32_t mask, glm::vec3* colors);
     void closest_hit_shader(const rt::ray_t& ray, int recursion, float t, float t_max, const rt::Primitive* hit, rt::RayHitInformation hit_info, void* ray_payload);
+    bool any_hit_shader(const rt::ray_t& ray, float t, const rt::Primitive* hit, rt::RayHitInformation hit_info);
     void miss_shader(const rt::ray_t& ray, int recursuon, float t_max, void* ray_payload);
 
+    bool wavefront_ray_generation_shader(uint32_t x, uint32_t y, rt::ray_t& ray, glm::vec3& weight);
+    bool wavefront_closest_hit_shader(const rt::ray_t& ray, uint32_t depth, float t, const rt::Primitive* hit, rt::RayHitInformation hit_info, glm::vec3& emitted, glm::vec3& attenuation, rt::ray_t& next_ray);
+    glm::vec3 wavefront_miss_shader(const rt::ray_t& ray, uint32_t depth);
+    void wavefront_miss_shader_n(const rt::ray_t* rays, size_t n, uint32_t depth, glm::vec3* radiance);
+
 public:
     // constants
     static constexpr int32_t SCR_WIDTH      = 960 * 2;
     static constexpr int32_t SCR_HEIGHT     = 540 * 2;
     static constexpr size_t PRIM_COUNT      = 3;
     static constexpr size_t RT_RECURSIONS   = 10;
+    static constexpr float MIRROR_ROUGHNESS = 0.05f;    // smoother surfaces trace their reflection
 
-    RT_Application(void);
+    /** @param[in] backend: How the rays are traced, see rt::RayTracer::set_backend(). */
+    explicit RT_Application(rt::RenderBackend backend = rt::RT_BACKEND_RECURSIVE);
     virtual ~RT_Application(void);
 
     void app_run(void);
-    const uint8_t* fetch_pixels(void) noexcept;
+    const uint8_t* fetch_pixels(float exposure = 1.0f);
+    const rt::Framebuffer& fetch_framebuffer(void) const noexcept;
 };
\ No newline at end of file
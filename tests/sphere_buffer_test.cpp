@@ -0,0 +1,54 @@
+/**
+* @file     sphere_buffer_test.cpp
+* @brief    Tests that the sphere buffer releases the attributes of overwritten and cleared spheres
+*           and that copies share the spheres until one of them is modified.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "../rt/misc/sphere_buffer.h"
+#include <cstdio>
+
+class TestAttribute : public rt::PrimitiveAttribute
+{
+public:
+    virtual rt::PrimitiveAttribute* clone_dynamic(void) const
+    { return new TestAttribute(); }
+};
+
+#define EXPECT(cond) if (!(cond)) { std::printf("%s:%d: expected %s\n", __FILE__, __LINE__, #cond); return 1; }
+
+int main()
+{
+    rt::BufferLayout layout;
+    layout.size = 2;
+    layout.first = 0;
+    layout.last = layout.size;
+
+    rt::SphereBuffer buff(layout);
+    buff.data(0, rt::Sphere({0.0f, 0.0f, 0.0f}, 1.0f, TestAttribute()));
+    buff.data(1, rt::Sphere({2.0f, 0.0f, 0.0f}, 1.0f, TestAttribute()));
+    EXPECT(buff.sphere(0).attribute() != nullptr);
+    EXPECT(buff.sphere(1).attribute() != nullptr);
+
+    // a sphere without an attribute must not keep the attribute of the overwritten one
+    buff.data(0, rt::Sphere({0.0f, 0.0f, 0.0f}, 1.0f));
+    EXPECT(buff.sphere(0).attribute() == nullptr);
+    EXPECT(buff.sphere(1).attribute() != nullptr);
+
+    // copies share the spheres, clearing the original must not clear the copy
+    const rt::SphereBuffer copy = buff;
+    EXPECT(&copy.sphere(1) == &buff.sphere(1));
+    EXPECT(copy.revision() == buff.revision());
+
+    buff.clear();
+    EXPECT(buff.sphere(0).attribute() == nullptr);
+    EXPECT(buff.sphere(1).attribute() == nullptr);
+    EXPECT(copy.sphere(1).attribute() != nullptr);
+    EXPECT(copy.revision() != buff.revision());
+    return 0;
+}
@@ -0,0 +1,72 @@
+/**
+* @file     texture_sampler_test.cpp
+* @brief    Tests that the texture sampler returns the same colors as the texture it samples
+*           and that an empty sampler returns 0.
+* @author   Michael Reim / Github: R-Michi
+* Copyright (c) 2021 by Michael Reim
+*
+* This code is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*/
+
+#include "../rt/image/texture_sampler.h"
+#include <cmath>
+#include <cstdio>
+
+#define EXPECT(cond) if (!(cond)) { std::printf("%s:%d: expected %s\n", __FILE__, __LINE__, #cond); return 1; }
+
+using Texture = rt::Texture2D<float, float>;
+using Sampler = rt::TextureSampler<Texture, rt::RT_FILTER_TRILINEAR, 2, rt::RT_TEXTURE_ADDRESS_MODE_REPEAT, rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER>;
+
+// the texture and the sampler may round the linear interpolation differently (e.g. fused multiply-add)
+static bool near(const glm::vec4& a, const glm::vec4& b)
+{
+    return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec4(1e-5f)));
+}
+
+int main()
+{
+    // an empty sampler must not read any mip level
+    const Sampler empty;
+    EXPECT(empty.mip_level_count() == 0);
+    EXPECT(empty.sample(glm::vec4(0.5f)) == glm::vec4(0.0f));
+    EXPECT(empty.sample(glm::vec4(0.5f), 1.0f) == glm::vec4(0.0f));
+
+    // 8x4 pixels with 2 channels, a size that is not a power of two in every dimmension
+    constexpr uint32_t width = 8, height = 4;
+    float pixels[width * height * 2];
+    for (uint32_t i = 0; i < width * height; i++)
+    {
+        pixels[2 * i + 0] = static_cast<float>(i) / (width * height);
+        pixels[2 * i + 1] = static_cast<float>(i % 3) / 3.0f;
+    }
+
+    rt::ImageCreateInfo ci = {};
+    ci.width = width;
+    ci.height = height;
+    ci.depth = 1;
+    ci.channels = 2;
+
+    Texture texture(rt::RT_FILTER_TRILINEAR, glm::vec4(0.25f, 0.75f, 0.0f, 0.0f));
+    texture.set_address_mode(rt::RT_TEXTURE_ADDRESS_MODE_REPEAT, rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER, rt::RT_TEXTURE_ADDRESS_MODE_CLAMP_TO_BORDER);
+    EXPECT(texture.load(ci, pixels) == rt::RT_IMAGE_ERROR_NONE);
+
+    Sampler sampler;
+    EXPECT(sampler.create(texture) == rt::RT_IMAGE_ERROR_NONE);
+    EXPECT(sampler.mip_level_count() == texture.mip_level_count());
+
+    // coordinates inside, outside (repeat in u, border in v) and at negative positions
+    const glm::vec4 coords[] =
+    {
+        {0.1f, 0.2f, 0.0f, 0.0f}, {0.55f, 0.8f, 0.0f, 0.0f}, {1.3f, 0.4f, 0.0f, 0.0f},
+        {-0.7f, 0.6f, 0.0f, 0.0f}, {0.3f, -0.1f, 0.0f, 0.0f}, {0.9f, 1.2f, 0.0f, 0.0f}
+    };
+    for (const glm::vec4& pos : coords)
+    {
+        EXPECT(near(sampler.sample(pos), texture.sample(pos)));
+        EXPECT(near(sampler.sample(pos, 0.6f), texture.sample(pos, 0.6f)));
+        EXPECT(near(sampler.sample(pos, 10.0f), texture.sample(pos, 10.0f)));
+    }
+    return 0;
+}